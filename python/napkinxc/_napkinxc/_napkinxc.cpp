@@ -28,8 +28,12 @@
 
 #include "args.h"
 #include "basic_types.h"
+#include "generate_data.h"
 #include "measure.h"
+#include "metrics.h"
 #include "model.h"
+#include "model_archive.h"
+#include "online_model.h"
 #include "plt.h"
 #include "read_data.h"
 #include "resources.h"
@@ -39,6 +43,10 @@
 #include <thread>
 #include <future>
 #include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <cmath>
+#include <cstdio>
 
 using namespace std::chrono_literals;
 namespace py = pybind11;
@@ -53,8 +61,15 @@ enum InputDataType {
 typedef std::tuple<py::array_t<Real>, py::array_t<int>, py::array_t<int>> ScipyCSRMatrixData;
 
 
-template<typename F> void runAsInterruptable(F func) {
+// Runs native code with the GIL released, so other Python threads can progress in the meantime.
+// The function must not touch any Python objects.
+template<typename F> void runWithoutGIL(F func) {
+    py::gil_scoped_release release;
     func();
+}
+
+template<typename F> void runAsInterruptable(F func) {
+    runWithoutGIL(func);
 
     // Interruption without correct exception handling
     /*
@@ -100,17 +115,22 @@ template<typename T> std::vector<T> pyListToVector(py::list const &pyList){
     return vector;
 }
 
+// Passes the data to numpy without copying, the array takes ownership of it
 template<typename T> py::array_t<T> dataToPyArray(T* ptr, std::vector<py::ssize_t> dims){
-    std::vector<py::ssize_t> strides(dims);
-    for(auto& s : strides) s = sizeof(T);
-    return py::array(py::buffer_info(
-        (void*)ptr,         // Pointer to data (nullptr -> ask NumPy to allocate!)
-        sizeof(T),          // Size of one item
-        py::format_descriptor<T>::value, // Buffer format
-        dims.size(),        // How many dimensions?
-        dims,               // Number of elements for each dimension */
-        strides             // Strides for each dimension */
-        ));
+    std::vector<py::ssize_t> strides(dims.size());
+    py::ssize_t stride = sizeof(T);
+    for(int i = dims.size() - 1; i >= 0; --i){
+        strides[i] = stride;
+        stride *= dims[i];
+    }
+    py::capsule owner(ptr, [](void* p) { delete[] reinterpret_cast<T*>(p); });
+    return py::array_t<T>(dims, strides, ptr, owner);
+}
+
+template<typename T> py::array_t<T> vectorToPyArray(std::vector<T>&& vec){
+    auto ptr = new std::vector<T>(std::move(vec));
+    py::capsule owner(ptr, [](void* p) { delete reinterpret_cast<std::vector<T>*>(p); });
+    return py::array_t<T>(ptr->size(), ptr->data(), owner);
 }
 
 ScipyCSRMatrixData SRMatrixToScipyCSRMatrix(SRMatrix& matrix, bool sortIndices){
@@ -141,14 +161,42 @@ ScipyCSRMatrixData SRMatrixToScipyCSRMatrix(SRMatrix& matrix, bool sortIndices){
     return std::make_tuple(pyData, pyIndices, pyIndptr);
 }
 
+ScipyCSRMatrixData IRMatrixToScipyCSRMatrix(IRMatrix& matrix, bool sortIndices){
+    int rows = matrix.rows();
+    int cells = matrix.cells();
+
+    Real* data = new Real[cells];
+    int* indices = new int[cells];
+    int* indptr = new int[rows + 1];
+
+    int i = 0;
+    for(auto r = 0; r < matrix.rows(); ++r){
+        indptr[r] = i;
+        if (sortIndices && !std::is_sorted(matrix[r].begin(), matrix[r].end()))
+            std::sort(matrix[r].begin(), matrix[r].end());
+        for(auto &l : matrix[r]){
+            indices[i] = l.index;
+            data[i] = 1;
+            ++i;
+        }
+    }
+    indptr[rows] = cells;
+
+    auto pyData = dataToPyArray(data, {cells});
+    auto pyIndices = dataToPyArray(indices, {cells});
+    auto pyIndptr = dataToPyArray(indptr, {rows + 1});
+
+    return std::make_tuple(pyData, pyIndices, pyIndptr);
+}
+
 std::tuple<std::vector<std::vector<int>>, ScipyCSRMatrixData> loadLibSvmFileLabelsList(std::string path, bool sortIndices){
-    SRMatrix labels;
+    IRMatrix labels;
     SRMatrix features;
 
     Args args;
     args.input = path;
     args.processData = false;
-    readData(labels, features, args);
+    runWithoutGIL([&] { readData(labels, features, args); });
 
     // Labels
     int rows = labels.rows();
@@ -166,15 +214,15 @@ std::tuple<std::vector<std::vector<int>>, ScipyCSRMatrixData> loadLibSvmFileLabe
 }
 
 std::tuple<ScipyCSRMatrixData, ScipyCSRMatrixData> loadLibSvmFileLabelsCSRMatrix(std::string path, bool sortIndices) {
-    SRMatrix labels;
+    IRMatrix labels;
     SRMatrix features;
 
     Args args;
     args.input = path;
     args.processData = false;
-    readData(labels, features, args);
+    runWithoutGIL([&] { readData(labels, features, args); });
 
-    auto pyLabels = SRMatrixToScipyCSRMatrix(labels, sortIndices);
+    auto pyLabels = IRMatrixToScipyCSRMatrix(labels, sortIndices);
     auto pyFeatures = SRMatrixToScipyCSRMatrix(features, sortIndices);
 
     return std::make_tuple(pyLabels, pyFeatures);
@@ -186,13 +234,18 @@ public:
     CPPModel(){};
 
     void setArgs(const std::vector<std::string>& arg){
-        args.parseArgs(arg);
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            args.parseArgs(arg);
+        });
     }
 
     void fitOnFile(std::string path){
         runAsInterruptable([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
             args.input = path;
-            SRMatrix labels;
+            args.featuresMap = nullptr; // Features map of the previously trained model does not apply to the new data
+            IRMatrix labels;
             SRMatrix features;
             readData(labels, features, args);
             fitHelper(labels, features);
@@ -200,92 +253,247 @@ public:
     }
 
     void fit(py::object inputFeatures, py::object inputLabels, int featuresDataType, int labelsDataType){
+        Args dataArgs = getArgs();
+        dataArgs.featuresMap = nullptr; // Features map of the previously trained model does not apply to the new data
+        IRMatrix labels;
+        SRMatrix features;
+        readSRMatrix(features, inputFeatures, (InputDataType) featuresDataType, dataArgs, true);
+        readSRMatrix(labels, inputLabels, (InputDataType) labelsDataType, dataArgs);
+
         runAsInterruptable([&] {
-            SRMatrix labels;
-            SRMatrix features;
-            readSRMatrix(features, inputFeatures, (InputDataType) featuresDataType, true);
-            readSRMatrix(labels, inputLabels, (InputDataType) labelsDataType);
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
             fitHelper(labels, features);
         });
     }
 
+    // Streamed training, online models are updated with every batch,
+    // other models spool batches to the binary cache file and are trained on it at the end
+    void fitStreamBegin(){
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            if(streamRows >= 0) throw std::runtime_error("Streamed training has already started");
+            // OPLT builds other trees from the whole data, streamed data can be only used to grow an online tree
+            if(args.modelType == oplt && args.treeType != onlineRandom && args.treeType != onlineBestScore)
+                throw std::invalid_argument("Streamed training of OPLT requires online tree type: onlineRandom or onlineBestScore");
+            checkOutput();
+            args.featuresMap = nullptr; // Batches are read without the features map of the previously trained model
+
+            args.printArgs("train");
+            makeDir(args.output);
+            args.saveToFile(joinPath(args.output, "args.bin"));
+
+            if(model == nullptr) model = Model::factory(args);
+            auto onlineModel = std::dynamic_pointer_cast<OnlineModel>(model);
+            if(onlineModel != nullptr){
+                Log(CERR) << "Preparing online model ...\n";
+                if(args.resume) onlineModel->load(args, args.output);
+                else onlineModel->init(args);
+            } else {
+                streamCache.open(streamCachePath(), std::ios::out | std::ios::binary);
+                if(!streamCache.good()) throw std::runtime_error("Cannot open cache file: " + streamCachePath());
+                writeBinaryDataHeader(streamCache, 0, 0, 0);
+            }
+            streamRows = 0;
+            streamFeatures = 0;
+            streamLabels = 0;
+        });
+    }
+
+    void fitStreamUpdate(py::object inputFeatures, py::object inputLabels, int featuresDataType, int labelsDataType){
+        Args dataArgs = getArgs();
+        IRMatrix labels;
+        SRMatrix features;
+        readSRMatrix(features, inputFeatures, (InputDataType) featuresDataType, dataArgs, true);
+        readSRMatrix(labels, inputLabels, (InputDataType) labelsDataType, dataArgs);
+        if(features.rows() != labels.rows()) throw py::value_error("Numbers of rows in the features and labels batches do not match.");
+
+        runAsInterruptable([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            if(streamRows < 0) throw std::runtime_error("Streamed training has not been started");
+
+            auto onlineModel = std::dynamic_pointer_cast<OnlineModel>(model);
+            if(onlineModel != nullptr){
+                onlineModel->updateBatch(labels, features, args);
+                args.featuresSize = std::max(args.featuresSize, features.cols());
+            } else saveCacheRows(labels, features);
+            streamRows += features.rows();
+        });
+    }
+
+    void fitStreamEnd(){
+        runAsInterruptable([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            if(streamRows < 0) throw std::runtime_error("Streamed training has not been started");
+
+            auto onlineModel = std::dynamic_pointer_cast<OnlineModel>(model);
+            if(onlineModel != nullptr){
+                args.saveToFile(joinPath(args.output, "args.bin"));
+                onlineModel->save(args, args.output);
+            } else {
+                streamCache.seekp(0);
+                writeBinaryDataHeader(streamCache, streamRows, streamFeatures, streamLabels);
+                streamCache.close();
+
+                // Rows in the cache are already processed
+                Args cacheArgs = args;
+                cacheArgs.input = streamCachePath();
+                cacheArgs.processData = false;
+                IRMatrix labels;
+                SRMatrix features;
+                readData(labels, features, cacheArgs);
+                std::remove(streamCachePath().c_str());
+
+                if(args.reindexFeatures) reindexFeatures(features, args);
+                args.featuresSize = features.cols();
+                args.saveToFile(joinPath(args.output, "args.bin"));
+                model->train(labels, features, args, args.output);
+            }
+            streamRows = -1;
+        });
+    }
+
+    void fitStreamCancel(){
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            if(streamCache.is_open()) streamCache.close();
+            std::remove(streamCachePath().c_str()); // It is also left if fitStreamEnd fails after closing it
+            model = nullptr;
+            streamRows = -1;
+        });
+    }
+
     void preload(){
-        if(model == nullptr){
-            args.loadFromFile(joinPath(args.output, "args.bin"));
-            model = Model::factory(args);
-        }
-        if(!model->isPreloaded()) model->preload(args, args.output);
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            preloadModel();
+        });
     }
 
     void load(){
-        if(model == nullptr){
-            args.loadFromFile(joinPath(args.output, "args.bin"));
-            model = Model::factory(args);
-        }
-        if(!model->isLoaded()) model->load(args, args.output);
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            loadModel();
+        });
+    }
+
+    // Uses the buffer of the Python object without copying, it is kept alive as long as the model uses it
+    void loadFromBytes(py::buffer data){
+        auto buffer = std::make_unique<py::buffer_info>(data.request());
+        std::unique_ptr<ModelArchive> newArchive;
+        runWithoutGIL([&] {
+            newArchive = std::make_unique<ModelArchive>((const char*)buffer->ptr, buffer->size * buffer->itemsize);
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            model = nullptr;
+            args.output = newArchive->getDir();
+            std::swap(archive, newArchive);
+        });
+        std::swap(archiveBuffer, buffer); // The old buffer is released after the old archive, with the GIL held
+    }
+
+    py::bytes toBytes(){
+        std::string data;
+        runWithoutGIL([&] {
+            std::shared_lock<std::shared_timed_mutex> lock(modelMtx);
+            if(archive != nullptr && args.output == archive->getDir()) data.assign(archive->data(), archive->size());
+            else data = ModelArchive::pack(args.output);
+        });
+        return py::bytes(data);
     }
 
     void unload(){
-        if(model != nullptr && model->isLoaded()) model->unload();
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            if(model != nullptr && model->isLoaded()) model->unload();
+        });
     }
 
     void setThresholds(std::vector<Real> thresholds){
-        load();
-        model->setThresholds(thresholds);
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            loadModel();
+            model->setThresholds(thresholds);
+        });
     }
 
     void setLabelsWeights(std::vector<Real> weights){
-        load();
-        model->setLabelsWeights(weights);
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            loadModel();
+            model->setLabelsWeights(weights);
+        });
     }
 
-    std::vector<std::vector<int>> predict(py::object inputFeatures, int featuresDataType, int topK, Real threshold){
-        auto predWithProba = predictProba(inputFeatures, featuresDataType, topK, threshold);
+    // Thresholds and labels weights given to the prediction functions are used only by that call,
+    // empty vectors keep the ones set on the model
+    std::vector<std::vector<int>> predict(py::object inputFeatures, int featuresDataType, int topK, Real threshold,
+                                          std::vector<Real> thresholds, std::vector<Real> labelsWeights){
+        auto predWithProba = predictProba(inputFeatures, featuresDataType, topK, threshold, thresholds, labelsWeights);
         return dropProbaHelper(predWithProba);
     }
 
-    std::vector<std::vector<std::pair<int, Real>>> predictProba(py::object inputFeatures, int featuresDataType, int topK, Real threshold){
+    std::vector<std::vector<std::pair<int, Real>>> predictProba(py::object inputFeatures, int featuresDataType, int topK, Real threshold,
+                                                                std::vector<Real> thresholds, std::vector<Real> labelsWeights){
+        // Load the model first, it also loads the data processing args required to read the features
+        load();
+        Args predArgs = getArgs();
         std::vector<std::vector<std::pair<int, Real>>> pred;
+
+        // Dense arrays are passed to the model as they are, without conversion to the sparse rows
+        std::vector<Real> x;
+        int rows, dims;
+        if((InputDataType)featuresDataType == ndarray && readDenseArray(x, rows, dims, inputFeatures, predArgs)){
+            runAsInterruptable([&] {
+                runWithPredictionLock(predArgs, thresholds, labelsWeights, [&] { pred = predictDenseHelper(x, rows, dims, predArgs, topK, threshold); });
+            });
+            return pred;
+        }
+
+        SRMatrix features;
+        readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, predArgs, true);
         runAsInterruptable([&] {
-            load();
-            SRMatrix features;
-            readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
-            pred = predictHelper(features, topK, threshold);
+            runWithPredictionLock(predArgs, thresholds, labelsWeights, [&] { pred = predictHelper(features, predArgs, topK, threshold); });
         });
 
         return pred;
     }
 
     std::vector<Real> ofo(py::object inputFeatures, py::object inputLabels, int featuresDataType, int labelsDataType) {
+        load();
+        Args ofoArgs = getArgs();
+        IRMatrix labels;
+        SRMatrix features;
+        readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, ofoArgs, true);
+        readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType, ofoArgs);
+
+        // OFO updates thresholds of the model, so it requires exclusive access to it
         std::vector<Real> thresholds;
         runAsInterruptable([&] {
-            load();
-            SRMatrix labels;
-            SRMatrix features;
-            readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
-            readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
-            args.printArgs("ofo");
-            thresholds = model->ofo(features, labels, args);
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            ofoArgs.printArgs("ofo");
+            thresholds = model->ofo(features, labels, ofoArgs);
         });
 
         return thresholds;
     }
 
-    std::vector<std::vector<int>> predictForFile(std::string path, int topK, Real threshold) {
-        auto predWithProba = predictProbaForFile(path, topK, threshold);
+    std::vector<std::vector<int>> predictForFile(std::string path, int topK, Real threshold,
+                                                 std::vector<Real> thresholds, std::vector<Real> labelsWeights) {
+        auto predWithProba = predictProbaForFile(path, topK, threshold, thresholds, labelsWeights);
         return dropProbaHelper(predWithProba);
     }
 
-    std::vector<std::vector<std::pair<int, Real>>> predictProbaForFile(std::string path, int topK, Real threshold) {
+    std::vector<std::vector<std::pair<int, Real>>> predictProbaForFile(std::string path, int topK, Real threshold,
+                                                                       std::vector<Real> thresholds, std::vector<Real> labelsWeights) {
+        load();
+        Args predArgs = getArgs();
+        predArgs.input = path;
+
         std::vector<std::vector<std::pair<int, Real>>> pred;
         runAsInterruptable([&] {
-            load();
-            args.input = path;
-
-            SRMatrix labels;
+            IRMatrix labels;
             SRMatrix features;
-            readData(labels, features, args);
-            pred = predictHelper(features, topK, threshold);
+            readData(labels, features, predArgs);
+            runWithPredictionLock(predArgs, thresholds, labelsWeights, [&] { pred = predictHelper(features, predArgs, topK, threshold); });
         });
 
         return pred;
@@ -293,45 +501,51 @@ public:
 
     std::vector<std::pair<std::string, Real>> test(py::object inputFeatures, py::object inputLabels, int featuresDataType, int labelsDataType,
                                                      int topK, Real threshold, std::string measuresStr){
+        load();
+        Args testArgs = getArgs();
+        IRMatrix labels;
+        SRMatrix features;
+        readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, testArgs, true);
+        readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType, testArgs);
+
         std::vector<std::pair<std::string, Real>> results;
         runAsInterruptable([&] {
-            load();
-            SRMatrix labels;
-            SRMatrix features;
-            readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
-            readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
-            results = testHelper(labels, features, topK, threshold, measuresStr);
+            runWithPredictionLock(testArgs, [&] { results = testHelper(labels, features, testArgs, topK, threshold, measuresStr); });
         });
 
         return results;
     }
 
     std::vector<std::pair<std::string, Real>> testOnFile(std::string path, int topK, Real threshold, std::string measuresStr){
+        load();
+        Args testArgs = getArgs();
+        testArgs.input = path;
+
         std::vector<std::pair<std::string, Real>> results;
         runAsInterruptable([&] {
-            load();
-            args.input = path;
-
-            SRMatrix labels;
+            IRMatrix labels;
             SRMatrix features;
-            readData(labels, features, args);
-            results = testHelper(labels, features, topK, threshold, measuresStr);
+            readData(labels, features, testArgs);
+            runWithPredictionLock(testArgs, [&] { results = testHelper(labels, features, testArgs, topK, threshold, measuresStr); });
         });
 
         return results;
     }
 
     void buildTree(py::object inputFeatures, py::object inputLabels, int featuresDataType, int labelsDataType){
-        if(args.modelType == plt || args.modelType == hsm) {
+        Args treeArgs = getArgs();
+        if(treeArgs.modelType == plt || treeArgs.modelType == hsm) {
+            IRMatrix labels;
+            SRMatrix features;
+            readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, treeArgs, true);
+            readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType, treeArgs);
+
             runAsInterruptable([&] {
+                std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
                 if(model == nullptr) model = Model::factory(args);
                 auto treeModel = std::dynamic_pointer_cast<PLT>(model);
 
-                SRMatrix labels;
-                SRMatrix features;
-                readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
-                readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
-
+                checkOutput();
                 makeDir(args.output);
                 args.saveToFile(joinPath(args.output, "args.bin"));
                 treeModel->buildTree(labels, features, args, args.output);
@@ -341,80 +555,241 @@ public:
 
     std::vector<std::vector<std::pair<int, Real>>> getNodesToUpdate(py::object inputLabels, int labelsDataType){
         std::vector<std::vector<std::pair<int, Real>>> nodesToUpdate;
-        if(args.modelType == plt || args.modelType == hsm) {
-            SRMatrix labels;
-            readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
+        Args treeArgs = getArgs();
+        if(treeArgs.modelType == plt || treeArgs.modelType == hsm) {
+            IRMatrix labels;
+            readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType, treeArgs);
 
             preload();
-            auto treeModel = std::dynamic_pointer_cast<PLT>(model);
-            nodesToUpdate = treeModel->getNodesToUpdate(labels);
+            runWithoutGIL([&] {
+                std::shared_lock<std::shared_timed_mutex> lock(modelMtx);
+                auto treeModel = std::dynamic_pointer_cast<PLT>(model);
+                nodesToUpdate = treeModel->getNodesToUpdate(labels);
+            });
         }
         return nodesToUpdate;
     }
 
     std::vector<std::vector<std::pair<int, Real>>> getNodesUpdates(py::object inputLabels, int labelsDataType){
         std::vector<std::vector<std::pair<int, Real>>> nodesUpdates;
-        if(args.modelType == plt || args.modelType == hsm) {
-            SRMatrix labels;
-            readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
+        Args treeArgs = getArgs();
+        if(treeArgs.modelType == plt || treeArgs.modelType == hsm) {
+            IRMatrix labels;
+            readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType, treeArgs);
 
             preload();
-            auto treeModel = std::dynamic_pointer_cast<PLT>(model);
-            nodesUpdates = treeModel->getNodesUpdates(labels);
+            runWithoutGIL([&] {
+                std::shared_lock<std::shared_timed_mutex> lock(modelMtx);
+                auto treeModel = std::dynamic_pointer_cast<PLT>(model);
+                nodesUpdates = treeModel->getNodesUpdates(labels);
+            });
         }
         return nodesUpdates;
     }
 
     std::vector<std::tuple<int, int, int>> getTreeStructure(){
         std::vector<std::tuple<int, int, int>> treeStructure;
-        if(args.modelType == plt || args.modelType == hsm) {
-            preload();
-            auto treeModel = std::dynamic_pointer_cast<PLT>(model);
-            treeStructure = treeModel->getTreeStructure();
-        }
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            if(args.modelType == plt || args.modelType == hsm) {
+                preloadModel();
+                auto treeModel = std::dynamic_pointer_cast<PLT>(model);
+                treeStructure = treeModel->getTreeStructure();
+            }
+        });
         return treeStructure;
     }
 
     void setTreeStructure(std::vector<std::tuple<int, int, int>> treeStructure){
-        if(args.modelType == plt || args.modelType == hsm) {
-            if(model == nullptr) model = Model::factory(args);
-            auto treeModel = std::dynamic_pointer_cast<PLT>(model);
-            makeDir(args.output);
-            args.saveToFile(joinPath(args.output, "args.bin"));
-            treeModel->setTreeStructure(treeStructure, args.output);
-        }
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            if(args.modelType == plt || args.modelType == hsm) {
+                if(model == nullptr) model = Model::factory(args);
+                auto treeModel = std::dynamic_pointer_cast<PLT>(model);
+                checkOutput();
+                makeDir(args.output);
+                args.saveToFile(joinPath(args.output, "args.bin"));
+                treeModel->setTreeStructure(treeStructure, args.output);
+            }
+        });
     }
 
-//    ScipyCSRMatrixData getWeights() {
-//        int cells = 0;
-//        int rows = 0;
-//
-//        Real* data = new Real[cells];
-//        int* indices = new int[cells];
-//        int* indptr = new int[rows + 1];
-//
-//        //TODO
-//
-//        auto pyData = dataToPyArray(data, {cells});
-//        auto pyIndices = dataToPyArray(indices, {cells});
-//        auto pyIndptr = dataToPyArray(indptr, {rows + 1});
-//
-//        return std::make_tuple(pyData, pyIndices, pyIndptr);
-//    }
-//
-//    void setWeights(py::object input, InputDataType dataTyp){
-//        //TODO
-//    }
+    // Returns weights of the base classifiers as CSR matrix (bases x (features + 1)) data, indices, indptr and shape,
+    // feature j is in column j and the bias is in the last column, arrays are passed to numpy without copying.
+    // The number of features is the size of the features space of the model (training data or hash size),
+    // so the layout does not depend on the values of the weights
+    std::tuple<py::array_t<Real>, py::array_t<int>, py::array_t<int>, std::pair<int, int>> getWeights(){
+        load();
+        std::vector<Real> data;
+        std::vector<int> indices;
+        std::vector<int> indptr;
+        int cols = 0;
+        runWithoutGIL([&] {
+            std::shared_lock<std::shared_timed_mutex> lock(modelMtx);
+            auto& bases = model->getBases();
+            cols = weightsCols(bases);
+
+            indptr.reserve(bases.size() + 1);
+            for(auto& b : bases){
+                size_t start = indices.size();
+                indptr.push_back(start);
+                b->getWeights(indices, data);
+
+                // Drop the weights outside of the features space, e.g. the unused last slot of LIBLINEAR weights
+                size_t end = start;
+                for(size_t k = start; k < indices.size(); ++k)
+                    if(indices[k] <= cols){
+                        indices[end] = indices[k];
+                        data[end++] = data[k];
+                    }
+                indices.resize(end);
+                data.resize(end);
+            }
+            indptr.push_back(indices.size());
+
+            // Shift features indices back and move the bias to the last column
+            for(auto& i : indices) i = (i == 1) ? cols - 1 : i - 2;
+        });
+
+        int rows = static_cast<int>(indptr.size()) - 1;
+        return std::make_tuple(vectorToPyArray(std::move(data)), vectorToPyArray(std::move(indices)),
+                               vectorToPyArray(std::move(indptr)), std::make_pair(rows, cols));
+    }
+
+    // Sets weights of the base classifiers from CSR matrix (bases x features) arrays, in the layout returned by getWeights,
+    // and saves them with the model
+    void setWeights(py::array_t<Real, py::array::c_style | py::array::forcecast> data,
+                    py::array_t<int, py::array::c_style | py::array::forcecast> indices,
+                    py::array_t<int, py::array::c_style | py::array::forcecast> indptr, int cols){
+        load();
+        const Real* dataPtr = data.data();
+        const int* indicesPtr = indices.data();
+        const int* indptrPtr = indptr.data();
+        int rows = indptr.size() - 1;
+
+        runWithoutGIL([&] {
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            checkOutput();
+            auto& bases = model->getBases();
+            if(rows != bases.size())
+                throw std::invalid_argument("Number of rows (" + std::to_string(rows) + ") does not match number of base classifiers ("
+                                            + std::to_string(bases.size()) + ")");
+
+            int modelCols = weightsCols(bases);
+            if(cols != modelCols)
+                throw std::invalid_argument("Number of columns (" + std::to_string(cols) + ") does not match number of features + 1 ("
+                                            + std::to_string(modelCols) + ")");
+
+            std::vector<int> rIndices; // Reused for all the rows
+            for(int r = 0; r < rows; ++r){
+                rIndices.clear();
+                for(int i = indptrPtr[r]; i < indptrPtr[r + 1]; ++i){
+                    if(indicesPtr[i] < 0 || indicesPtr[i] >= cols)
+                        throw std::invalid_argument("Column index " + std::to_string(indicesPtr[i]) + " is out of range");
+                    rIndices.push_back((indicesPtr[i] == cols - 1) ? 1 : indicesPtr[i] + 2);
+                }
+                bases[r]->setWeights(rIndices.data(), dataPtr + indptrPtr[r], rIndices.size(), args.loadAs);
+                if(bases[r]->getW() != nullptr) bases[r]->getW()->resize(cols + 1); // Keep the size of the features space
+            }
+            model->updateUsedFeatures(args);
+
+            // Other files of the model loaded from bytes are written to the new output directory first
+            if(archive != nullptr){
+                makeDir(args.output);
+                archive->unpack(args.output);
+            }
+            Model::saveBases(joinPath(args.output, "weights.bin"), bases);
+        });
+    }
 
 private:
     Args args;
     std::shared_ptr<Model> model;
+
+    // Guards args and model, shared for prediction, exclusive for everything that changes the state of the model.
+    // It is only acquired with the GIL released and the GIL is never acquired while holding it.
+    std::shared_timed_mutex modelMtx;
+
+    // Archive and the buffer of the model loaded from bytes
+    std::unique_ptr<py::buffer_info> archiveBuffer;
+    std::unique_ptr<ModelArchive> archive;
+
+    // State of the streamed training, number of rows is -1 if there is no streamed training in progress,
+    // numbers of features and labels bound the sizes of the rows in the header of the cache
+    int streamRows = -1;
+    int streamFeatures = 0;
+    int streamLabels = 0;
+    std::ofstream streamCache;
+
+    std::string streamCachePath(){
+        return joinPath(args.output, "stream_cache.bin");
+    }
+
+    // Rows are stored in the cache in the binary data format, its header is written with the final sizes at the end
+    void saveCacheRows(IRMatrix& labels, SRMatrix& features){
+        std::vector<IRVPair> lLabels;
+        std::vector<IRVPair> lFeatures;
+        for(int r = 0; r < features.rows(); ++r){
+            lLabels.clear();
+            for(auto &l : labels[r]) lLabels.emplace_back(l.index, 1);
+            lFeatures.assign(features[r].data(), features[r].data() + features[r].nonZero());
+            writeBinaryDataRow(streamCache, lLabels, lFeatures);
+            streamLabels = std::max(streamLabels, static_cast<int>(lLabels.size()));
+            streamFeatures = std::max(streamFeatures, static_cast<int>(lFeatures.size()));
+        }
+        streamLabels = std::max(streamLabels, labels.cols());
+        streamFeatures = std::max(streamFeatures, features.cols());
+    }
+
+    // Returns a copy of the current args, that can be safely used without holding the lock
+    Args getArgs(){
+        Args argsCopy;
+        runWithoutGIL([&] {
+            std::shared_lock<std::shared_timed_mutex> lock(modelMtx);
+            argsCopy = args;
+        });
+        return argsCopy;
+    }
+
+    // Number of columns of the weights matrix: features space of the model without the reserved index 0,
+    // bias (index 1) is moved to the last column
+    // models saved without the size of the features space fall back to the largest size of the base classifiers
+    int weightsCols(std::vector<Base*>& bases){
+        if(args.featuresSize > 0) return args.featuresSize - 1;
+        size_t size = 2;
+        for(auto& b : bases)
+            if(b->getW() != nullptr) size = std::max(size, b->getW()->size());
+        return static_cast<int>(size) - 1;
+    }
+
+    // Model loaded from bytes has no directory, its files can be written only after the output directory is set explicitly
+    void checkOutput(){
+        if(archive != nullptr && args.output == archive->getDir())
+            throw std::invalid_argument("Model loaded from bytes cannot be saved to its directory, set the output parameter first");
+    }
+
+    // Require modelMtx to be locked exclusively
+    void preloadModel(){
+        if(model == nullptr){
+            args.loadFromFile(joinPath(args.output, "args.bin"));
+            model = Model::factory(args);
+        }
+        if(!model->isPreloaded()) model->preload(args, args.output);
+    }
+
+    void loadModel(){
+        if(model == nullptr){
+            args.loadFromFile(joinPath(args.output, "args.bin"));
+            model = Model::factory(args);
+        }
+        if(!model->isLoaded()) model->load(args, args.output);
+    }
 	
 	template<typename T> bool isArrayType(py::array& pyArray){
 		return py::isinstance<py::array_t<T>>(pyArray);
 	}
 	
-    template<typename T> void readPyArray(SRMatrix& output, py::array& pyArray, bool process = false){
+    template<typename T, typename M> void readPyArray(M& output, py::array& pyArray, Args& args, bool process = false){
         std::vector<IRVPair> rVec;
         if (pyArray.ndim() == 1){ // 1d multiclass data
             auto pyData = pyArray.unchecked<T, 1>();
@@ -438,14 +813,48 @@ private:
                     if (v != 0) rVec.emplace_back(f, v);
                 }
 
-                if (process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold);
+                if (process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold, args.featuresMap.get());
                 output.appendRow(rVec);
             }
         }
         else throw py::value_error("Data must be a 1d or 2d array.");
     }
 
-    template<typename T, typename U> void readCSRMatrix(SRMatrix& output, py::object& input, bool process = false){
+    // Reads 2d array as dense rows processed like by processFeaturesVector: with the bias and the features shifted by 2,
+    // returns false if the model does not use dense features or they are hashed, thresholded or renumbered
+    bool readDenseArray(std::vector<Real>& x, int& rows, int& dims, py::object& input, Args& args){
+        if(args.denseFeatures <= 0 || args.hash || args.featuresThreshold > 0 || args.featuresMap) return false;
+
+        py::array pyArray(input);
+        if(pyArray.ndim() != 2) return false;
+        if(isArrayType<float>(pyArray)) readDenseRows<float>(x, rows, dims, pyArray, args);
+        else if(isArrayType<double>(pyArray)) readDenseRows<double>(x, rows, dims, pyArray, args);
+        else return false;
+        return true;
+    }
+
+    template<typename T> void readDenseRows(std::vector<Real>& x, int& rows, int& dims, py::array& pyArray, Args& args){
+        auto pyData = pyArray.unchecked<T, 2>();
+        rows = pyData.shape(0);
+        dims = pyData.shape(1) + 2;
+        x.assign(static_cast<size_t>(rows) * dims, 0);
+
+        for (int r = 0; r < rows; ++r) {
+            Real* xr = x.data() + static_cast<size_t>(r) * dims;
+            xr[1] = args.bias;
+            Real norm = 0;
+            for (int f = 2; f < dims; ++f) {
+                xr[f] = pyData(r, f - 2);
+                norm += xr[f] * xr[f];
+            }
+            if (args.norm && norm > 0) { // Unit norm without the bias
+                norm = std::sqrt(norm);
+                for (int f = 2; f < dims; ++f) xr[f] /= norm;
+            }
+        }
+    }
+
+    template<typename T, typename U, typename M> void readCSRMatrix(M& output, py::object& input, Args& args, bool process = false){
         std::vector<IRVPair> rVec;
 
         // Try to interpret input data as a csr_matrix CSR matrix
@@ -461,7 +870,7 @@ private:
             for (int i = indptr.at(rId); i < indptr.at(rId + 1); ++i)
                 rVec.emplace_back(indices.at(i), data.at(i));
 
-            if(process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold);
+            if(process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold, args.featuresMap.get());
             output.appendRow(rVec);
         }
     }
@@ -469,7 +878,7 @@ private:
     // Reads multiple items from a python object and inserts onto a SRMatrix
     //SRMatrix readSRMatrix(py::object input, InputDataType dataType) {
     //SRMatrix output;
-    void readSRMatrix(SRMatrix& output, py::object& input, InputDataType dataType, bool process = false) {
+    template<typename M> void readSRMatrix(M& output, py::object& input, InputDataType dataType, Args& args, bool process = false) {
         // TODO: Check memory consumption of this function
 
         if (dataType == list) {
@@ -493,17 +902,17 @@ private:
                     rVec.emplace_back(py::cast<int>(pyList[i]), 1);
                 else throw py::value_error("Unsupported row data type, can be list or tuple of ints or typles of int and floats.");
 
-                if(process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold);
+                if(process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold, args.featuresMap.get());
 
                 output.appendRow(rVec);
             }
         } else if (dataType == ndarray) { // Numpy and other data in array format
             py::array pyArray(input);
 
-            if(isArrayType<float>(pyArray)) readPyArray<float>(output, pyArray, process);
-            else if(isArrayType<double>(pyArray)) readPyArray<double>(output, pyArray, process);
-            else if(isArrayType<std::int32_t>(pyArray)) readPyArray<std::int32_t>(output, pyArray, process);
-            else if(isArrayType<std::int64_t>(pyArray)) readPyArray<std::int64_t>(output, pyArray, process);
+            if(isArrayType<float>(pyArray)) readPyArray<float>(output, pyArray, args, process);
+            else if(isArrayType<double>(pyArray)) readPyArray<double>(output, pyArray, args, process);
+            else if(isArrayType<std::int32_t>(pyArray)) readPyArray<std::int32_t>(output, pyArray, args, process);
+            else if(isArrayType<std::int64_t>(pyArray)) readPyArray<std::int64_t>(output, pyArray, args, process);
             //TODO
             //else throw py::value_error("Unsupported " + std::to_string(dtype) + " type of array."));
             else throw py::value_error("Unsupported type of the array.");
@@ -517,10 +926,10 @@ private:
             py::array indices(input.attr("indices"));
             py::array data(input.attr("data"));
 
-            if(isArrayType<std::int32_t>(indptr) && isArrayType<std::int32_t>(indices) && isArrayType<float>(data)) readCSRMatrix<std::int32_t, float>(output, input, process);
-            else if(isArrayType<std::int32_t>(indptr) && isArrayType<std::int32_t>(indices) && isArrayType<double>(data)) readCSRMatrix<std::int32_t, double>(output, input, process);
-            else if(isArrayType<std::int64_t>(indptr) && isArrayType<std::int64_t>(indices) && isArrayType<float>(data)) readCSRMatrix<std::int64_t, float>(output, input, process);
-            else if(isArrayType<std::int64_t>(indptr) && isArrayType<std::int64_t>(indices) && isArrayType<double>(data)) readCSRMatrix<std::int64_t, double>(output, input, process);
+            if(isArrayType<std::int32_t>(indptr) && isArrayType<std::int32_t>(indices) && isArrayType<float>(data)) readCSRMatrix<std::int32_t, float>(output, input, args, process);
+            else if(isArrayType<std::int32_t>(indptr) && isArrayType<std::int32_t>(indices) && isArrayType<double>(data)) readCSRMatrix<std::int32_t, double>(output, input, args, process);
+            else if(isArrayType<std::int64_t>(indptr) && isArrayType<std::int64_t>(indices) && isArrayType<float>(data)) readCSRMatrix<std::int64_t, float>(output, input, args, process);
+            else if(isArrayType<std::int64_t>(indptr) && isArrayType<std::int64_t>(indices) && isArrayType<double>(data)) readCSRMatrix<std::int64_t, double>(output, input, args, process);
             //TODO: print types names
 //            else throw py::value_error("Unsupported data[" + py::str(dtype) +
 //                "], indices[" + py::str(itype) + "], indptr[" + py::str(ptype) + "], type of array."));
@@ -529,10 +938,14 @@ private:
             throw py::value_error("Unsupported data type.");
     }
 
-    inline void fitHelper(SRMatrix& labels, SRMatrix& features){
+    inline void fitHelper(IRMatrix& labels, SRMatrix& features){
         // Save args to file
+        checkOutput();
+        args.featuresMap = nullptr;
         args.printArgs("train");
         makeDir(args.output);
+        if(args.reindexFeatures) reindexFeatures(features, args);
+        args.featuresSize = features.cols();
         args.saveToFile(joinPath(args.output, "args.bin"));
 
         // Create and train model (train function also saves model)
@@ -540,27 +953,78 @@ private:
         model->train(labels, features, args, args.output);
     }
 
-    inline std::vector<std::vector<std::pair<int, Real>>> predictHelper(SRMatrix& features, int topK, Real threshold){
-        args.printArgs("predict");
+    // Runs prediction holding the lock shared, so multiple threads can use the model concurrently
+    template<typename F> void runWithPredictionLock(Args& predArgs, F func){
+        // Beam search temporarily unpacks sparse weights of the bases, so it requires exclusive access to the model
+        if(predArgs.treeSearchType == beam && predArgs.beamSearchUnpack){
+            std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+            func();
+        } else {
+            std::shared_lock<std::shared_timed_mutex> lock(modelMtx);
+            func();
+        }
+    }
+
+    // Per-call thresholds and labels weights are set on the model and restored after the prediction,
+    // so the lock is held exclusively for the whole call and other calls never see them
+    template<typename F> void runWithPredictionLock(Args& predArgs, const std::vector<Real>& thresholds,
+                                                    const std::vector<Real>& labelsWeights, F func){
+        if(thresholds.empty() && labelsWeights.empty()){
+            runWithPredictionLock(predArgs, func);
+            return;
+        }
+
+        std::unique_lock<std::shared_timed_mutex> lock(modelMtx);
+        auto modelThresholds = model->getThresholds();
+        auto modelLabelsWeights = model->getLabelsWeights();
+        auto restore = [&] {
+            if(!thresholds.empty()) model->setThresholds(modelThresholds);
+            if(!labelsWeights.empty()) model->setLabelsWeights(modelLabelsWeights);
+        };
+
+        try {
+            if(!thresholds.empty()) model->setThresholds(thresholds);
+            if(!labelsWeights.empty()) model->setLabelsWeights(labelsWeights);
+            func();
+        } catch (...) {
+            restore();
+            throw;
+        }
+        restore();
+    }
+
+    inline std::vector<std::vector<std::pair<int, Real>>> predictHelper(SRMatrix& features, Args& predArgs, int topK, Real threshold){
+        predArgs.printArgs("predict");
 
-        // TODO: refactor this
-        args.topK = topK;
-        args.threshold = threshold;
-        auto predictions = model->predictBatch(features, args);
+        predArgs.topK = topK;
+        predArgs.threshold = threshold;
+        auto predictions = model->predictBatch(features, predArgs);
 
         // This is only safe because it's struct with two fields casted to pair, don't do this with tuples!
         return reinterpret_cast<std::vector<std::vector<std::pair<int, Real>>>&>(predictions);
     }
 
-    inline std::vector<std::pair<std::string, Real>> testHelper(SRMatrix& labels, SRMatrix& features, int topK, Real threshold, std::string measuresStr){
-        args.printArgs("test");
+    inline std::vector<std::vector<std::pair<int, Real>>> predictDenseHelper(std::vector<Real>& x, int rows, int dims, Args& predArgs,
+                                                                             int topK, Real threshold){
+        predArgs.printArgs("predict");
+
+        predArgs.topK = topK;
+        predArgs.threshold = threshold;
+        auto predictions = model->predictDenseBatch(x.data(), rows, dims, predArgs);
+
+        return reinterpret_cast<std::vector<std::vector<std::pair<int, Real>>>&>(predictions);
+    }
+
+    inline std::vector<std::pair<std::string, Real>> testHelper(IRMatrix& labels, SRMatrix& features, Args& testArgs,
+                                                                int topK, Real threshold, std::string measuresStr){
+        testArgs.printArgs("test");
 
-        args.topK = topK;
-        args.threshold = threshold;
-        auto predictions = model->predictBatch(features, args);
+        testArgs.topK = topK;
+        testArgs.threshold = threshold;
+        auto predictions = model->predictBatch(features, testArgs);
 
-        args.measures = measuresStr;
-        auto measures = Measure::factory(args, model->outputSize());
+        testArgs.measures = measuresStr;
+        auto measures = Measure::factory(testArgs, model->outputSize());
         for (auto& m : measures) m->accumulate(labels, predictions);
 
         std::vector<std::pair<std::string, Real>> results;
@@ -590,6 +1054,27 @@ PYBIND11_MODULE(_napkinxc, n) {
     n.def("_load_libsvm_file_labels_list", &loadLibSvmFileLabelsList);
     n.def("_load_libsvm_file_labels_csr_matrix", &loadLibSvmFileLabelsCSRMatrix);
 
+    n.def("_generate_dataset", [](std::vector<std::string> arg) {
+        Args args;
+        args.parseArgs(arg, false);
+        runWithoutGIL([&] { generateData(args); });
+    });
+
+    n.def("_set_worker_pool_size", [](int size) {
+        if (size < 0) throw std::invalid_argument("Size of the worker pool must be non-negative");
+        WorkerPool::getInstance().setMaxSize(size);
+    });
+    n.def("_worker_pool_size", []() { return WorkerPool::getInstance().getMaxSize(); });
+
+    n.def("_set_metrics_enabled", [](bool enabled) { Metrics::enabled = enabled; });
+    n.def("_metrics_enabled", []() { return Metrics::enabled; });
+    n.def("_reset_metrics", &Metrics::reset);
+    n.def("_get_metrics", [](std::string format) {
+        if (format == "json") return Metrics::toJson();
+        else if (format == "prometheus") return Metrics::toPrometheus();
+        else throw std::invalid_argument("Unknown metrics format: " + format);
+    });
+
     py::enum_<InputDataType>(n, "InputDataType")
     .value("list", list)
     .value("ndarray", ndarray)
@@ -600,8 +1085,14 @@ PYBIND11_MODULE(_napkinxc, n) {
     .def("set_args", &CPPModel::setArgs)
     .def("fit", &CPPModel::fit)
     .def("fit_on_file", &CPPModel::fitOnFile)
+    .def("fit_stream_begin", &CPPModel::fitStreamBegin)
+    .def("fit_stream_update", &CPPModel::fitStreamUpdate)
+    .def("fit_stream_end", &CPPModel::fitStreamEnd)
+    .def("fit_stream_cancel", &CPPModel::fitStreamCancel)
     .def("load", &CPPModel::load)
     .def("unload", &CPPModel::unload)
+    .def("load_from_bytes", &CPPModel::loadFromBytes)
+    .def("to_bytes", &CPPModel::toBytes)
     .def("set_thresholds", &CPPModel::setThresholds)
     .def("set_labels_weights", &CPPModel::setLabelsWeights)
     .def("predict", &CPPModel::predict)
@@ -615,7 +1106,7 @@ PYBIND11_MODULE(_napkinxc, n) {
     .def("get_nodes_to_update", &CPPModel::getNodesToUpdate)
     .def("get_nodes_updates", &CPPModel::getNodesUpdates)
     .def("get_tree_structure", &CPPModel::getTreeStructure)
-    .def("set_tree_structure", &CPPModel::setTreeStructure);
-//    .def("get_weights", &CPPModel::getWeights)
-//    .def("set_weights", &CPPModel::setWeights);
+    .def("set_tree_structure", &CPPModel::setTreeStructure)
+    .def("get_weights", &CPPModel::getWeights)
+    .def("set_weights", &CPPModel::setWeights);
 }
@@ -31,7 +31,7 @@ import numpy as np
 from scipy.sparse import csr_matrix
 
 try:
-    from ._napkinxc import _load_libsvm_file_labels_list, _load_libsvm_file_labels_csr_matrix
+    from ._napkinxc import _load_libsvm_file_labels_list, _load_libsvm_file_labels_csr_matrix, _generate_dataset
 except ImportError:
     warnings.warn("Couldn't import napkinXC cpp module, some functions may fail.")
 
@@ -503,6 +503,66 @@ def save_libsvm_file(file, X, Y, sort_indices=False):
         pass
 
 
+def generate_dataset(file, test_file=None, rows=10000, test_rows=0, features=100000, labels=10000, labels_per_row=3,
+                     features_per_row=50, labels_power_law=1.0, latent_clusters=0, features_noise=0.1,
+                     binary=False, seed=0, verbose=False):
+    """
+    Generate synthetic extreme classification dataset and save it to the file in the libsvm or binary format.
+    Labels frequencies follow the power law and labels are grouped into latent clusters,
+    features of the data points are drawn from the vocabularies of their labels and clusters,
+    so the trees and models behave like on the real data. The same seed always gives the same dataset.
+    Both formats can be loaded with :func:`load_libsvm_file` and used as the input of the models.
+
+    :param file: Path to the output file
+    :type file: str
+    :param test_file: Path to the output file for the test data points, defaults to None
+    :type test_file: str, optional
+    :param rows: Number of data points, defaults to 10000
+    :type rows: int, optional
+    :param test_rows: Number of test data points, generated from the same clusters and vocabularies, defaults to 0
+    :type test_rows: int, optional
+    :param features: Number of features, defaults to 100000
+    :type features: int, optional
+    :param labels: Number of labels, defaults to 10000
+    :type labels: int, optional
+    :param labels_per_row: Mean number of labels per data point, defaults to 3
+    :type labels_per_row: float, optional
+    :param features_per_row: Mean number of non-zero features per data point, defaults to 50
+    :type features_per_row: int, optional
+    :param labels_power_law: Exponent of the power law of labels frequencies, defaults to 1.0
+    :type labels_power_law: float, optional
+    :param latent_clusters: Number of latent clusters of labels, 0 for square root of the number of labels, defaults to 0
+    :type latent_clusters: int, optional
+    :param features_noise: Fraction of features unrelated to the labels, defaults to 0.1
+    :type features_noise: float, optional
+    :param binary: If True, save in the binary format that is faster to load, defaults to False
+    :type binary: bool, optional
+    :param seed: Seed, defaults to 0
+    :type seed: int, optional
+    :param verbose: If True print generation progress, defaults to False
+    :type verbose: bool, optional
+    """
+    args = {
+        "output": file,
+        "rows": rows,
+        "features": features,
+        "labels": labels,
+        "labelsPerRow": labels_per_row,
+        "featuresPerRow": features_per_row,
+        "labelsPowerLaw": labels_power_law,
+        "latentClusters": latent_clusters,
+        "featuresNoise": features_noise,
+        "binary": int(binary),
+        "seed": seed,
+        "verbose": 2 if verbose else 0,
+    }
+    if test_file is not None:
+        args["testOutput"] = test_file
+        args["testRows"] = test_rows
+
+    _generate_dataset([str(v) for k, a in args.items() for v in ("--" + k, a)])
+
+
 def load_json_lines_file(file, features_fields=['title', 'content'], labels_field='target_ind', gzip_file=None):
     """
     Load data in the JSON lines format into list of features and list of labels.
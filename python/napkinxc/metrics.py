@@ -0,0 +1,66 @@
+# Copyright (c) 2020-2022 by Marek Wydmuch
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+import json
+from ._napkinxc import _set_metrics_enabled, _metrics_enabled, _reset_metrics, _get_metrics
+
+
+def enable_metrics(enabled=True):
+    """
+    Enable (or disable) collection of counters and latency histograms of training and prediction stages.
+    Metrics are collected for all the models in the process.
+
+    :param enabled: If True, collect metrics, defaults to True
+    :type enabled: bool
+    """
+    _set_metrics_enabled(enabled)
+
+
+def metrics_enabled():
+    """
+    Check if metrics are collected.
+
+    :return: True if metrics are collected
+    :rtype: bool
+    """
+    return _metrics_enabled()
+
+
+def reset_metrics():
+    """
+    Reset all the collected metrics.
+    """
+    _reset_metrics()
+
+
+def get_metrics(format="dict"):
+    """
+    Get collected metrics: counters of evaluated nodes, heap operations, predicted queries and trained estimators,
+    and latency histograms of prediction of a query, level of the beam search, data points assignment,
+    and training, saving and loading of base estimators.
+
+    :param format: Format of returned metrics (``'dict'``, ``'json'`` or ``'prometheus'``), defaults to ``'dict'``
+    :type format: str
+    :return: Metrics as a dict with ``'counters'`` and ``'timers'`` keys or as a JSON or Prometheus text string
+    :rtype: dict, str
+    """
+    if format == "dict":
+        return json.loads(_get_metrics("json"))
+    return _get_metrics(format)
@@ -19,9 +19,61 @@
 # SOFTWARE.
 
 import re
-from numpy import ndarray
+import threading
+from concurrent.futures import ThreadPoolExecutor
+from numpy import ndarray, float32, int32
 from scipy.sparse import csr_matrix
-from ._napkinxc import CPPModel, InputDataType
+from ._napkinxc import CPPModel, InputDataType, _set_worker_pool_size, _worker_pool_size
+
+
+_executor = None
+_executor_lock = threading.Lock()
+
+
+def _get_executor():
+    """
+    Return the lazily created thread pool executor used by ``*_async`` methods of the models.
+    The native code releases the GIL, so the calls running in the executor do not block other Python threads.
+    """
+    global _executor
+    with _executor_lock:
+        if _executor is None:
+            _executor = ThreadPoolExecutor(thread_name_prefix="napkinxc")
+        return _executor
+
+
+def set_async_executor(executor):
+    """
+    Set the executor used to run ``*_async`` methods of the models, e.g. to limit the number of concurrent calls.
+
+    :param executor: Executor instance, if None the default one will be created on the next async call
+    :type executor: concurrent.futures.Executor, None
+    """
+    global _executor
+    with _executor_lock:
+        _executor = executor
+
+
+def set_worker_pool_size(size):
+    """
+    Set the maximum number of workers of the native thread pool shared by all the models in the process.
+    Parallel parts of training and prediction that use more threads run their tasks one after another above this limit.
+    The pool does not shrink, so it should be set before the first parallel call.
+
+    :param size: Maximum number of workers, 0 for no limit
+    :type size: int
+    """
+    _set_worker_pool_size(size)
+
+
+def get_worker_pool_size():
+    """
+    Get the maximum number of workers of the native thread pool.
+
+    :return: Maximum number of workers, 0 if there is no limit
+    :rtype: int
+    """
+    return _worker_pool_size()
 
 
 class Model():
@@ -54,6 +106,28 @@ class Model():
         """
         self._model.fit_on_file(path)
 
+    def fit_stream(self, batches):
+        """
+        Fit the model to the training data provided as an iterable of batches,
+        so the whole training set never has to be kept in memory by Python (e.g. when reading it from Parquet files or database cursors).
+        Online models (OPLT) are updated with every batch, the other models spool the batches
+        to the binary cache file in the model directory and are trained on it after the last batch.
+        OPLT requires an online tree type (``tree_type='onlineRandom'`` or ``'onlineBestScore'``),
+        as the other trees are built from the whole data.
+        If reading the batches or training fails, the cache file is removed and the model is reset.
+
+        :param batches: Iterable of tuples (X, Y) with batches of the training data in the same formats as accepted by :meth:`fit`.
+        :type batches: iterable[tuple]
+        """
+        self._model.fit_stream_begin()
+        try:
+            for X, Y in batches:
+                self._model.fit_stream_update(X, Y, Model._check_data_type(X), Model._check_data_type(Y))
+            self._model.fit_stream_end()
+        except BaseException:
+            self._model.fit_stream_cancel()
+            raise
+
     def load(self):
         """
         Load the model to RAM.
@@ -66,6 +140,32 @@ class Model():
         """
         self._model.unload()
 
+    def to_bytes(self):
+        """
+        Return the whole model (all the files from the model directory) packed into a single buffer.
+
+        :return: Packed model.
+        :rtype: bytes
+        """
+        return self._model.to_bytes()
+
+    @classmethod
+    def from_bytes(cls, data):
+        """
+        Create the model from the buffer returned by :meth:`to_bytes`, without writing it to the disk.
+        The buffer is used without copying, so it can be e.g. memory-mapped file, it should not be modified while the model is in use.
+        The model has no directory, ``output`` parameter has to be set with :meth:`set_params` before the model is changed or saved.
+
+        :param data: Packed model.
+        :type data: bytes, bytearray, memoryview, mmap.mmap
+        :return: Model loaded from the buffer.
+        :rtype: Model
+        """
+        model = cls.__new__(cls)
+        Model.__init__(model)
+        model._model.load_from_bytes(data)
+        return model
+
     def predict(self, X, top_k=0, threshold=0, labels_weights=None):
         """
         Predict labels for data points in X.
@@ -84,8 +184,8 @@ class Model():
         :return: List of lists with predicted labels.
         :rtype: list[list[int]]
         """
-        threshold = self._prepare_pred(top_k, threshold, labels_weights)
-        return self._model.predict(X, Model._check_data_type(X), top_k, threshold)
+        threshold, thresholds, labels_weights = self._prepare_pred(top_k, threshold, labels_weights)
+        return self._model.predict(X, Model._check_data_type(X), top_k, threshold, thresholds, labels_weights)
 
     def predict_proba(self, X, top_k=0, threshold=0, labels_weights=None):
         """
@@ -105,8 +205,8 @@ class Model():
         :return: List of list of tuples (label id, probability) with predicted labels
         :rtype: list[list[tuple[int, float]]
         """
-        threshold = self._prepare_pred(top_k, threshold, labels_weights)
-        return self._model.predict_proba(X, Model._check_data_type(X), top_k, threshold)
+        threshold, thresholds, labels_weights = self._prepare_pred(top_k, threshold, labels_weights)
+        return self._model.predict_proba(X, Model._check_data_type(X), top_k, threshold, thresholds, labels_weights)
 
     def predict_for_file(self, path, top_k=0, threshold=0, labels_weights=None):
         """
@@ -126,8 +226,8 @@ class Model():
         :return: List of lists with predicted labels.
         :rtype: list[list[int]]
         """
-        threshold = self._prepare_pred(top_k, threshold, labels_weights)
-        return self._model.predict_for_file(path, top_k, threshold)
+        threshold, thresholds, labels_weights = self._prepare_pred(top_k, threshold, labels_weights)
+        return self._model.predict_for_file(path, top_k, threshold, thresholds, labels_weights)
 
     def predict_proba_for_file(self, path, top_k=0, threshold=0, labels_weights=None):
         """
@@ -147,8 +247,8 @@ class Model():
         :return: List of list of tuples (label id, probability) with predicted labels
         :rtype: list[list[tuple[int, float]]
         """
-        threshold = self._prepare_pred(top_k, threshold, labels_weights)
-        return self._model.predict_proba_for_file(path, top_k, threshold)
+        threshold, thresholds, labels_weights = self._prepare_pred(top_k, threshold, labels_weights)
+        return self._model.predict_proba_for_file(path, top_k, threshold, thresholds, labels_weights)
 
     def ofo(self, X, Y, type='micro', a=10, b=20, epochs=1):
         """
@@ -175,6 +275,45 @@ class Model():
             thr = thr[0]
         return thr
 
+    def fit_async(self, X, Y):
+        """
+        Asynchronous version of :meth:`fit`, the training runs in a background thread.
+        The returned future can be awaited in asyncio code with ``asyncio.wrap_future``.
+
+        :return: Future that completes when the training is finished.
+        :rtype: concurrent.futures.Future
+        """
+        return _get_executor().submit(self.fit, X, Y)
+
+    def predict_async(self, X, top_k=0, threshold=0, labels_weights=None):
+        """
+        Asynchronous version of :meth:`predict`, the prediction runs in a background thread.
+        The model can be safely used by many threads at the same time.
+
+        :return: Future with list of lists with predicted labels.
+        :rtype: concurrent.futures.Future
+        """
+        return _get_executor().submit(self.predict, X, top_k, threshold, labels_weights)
+
+    def predict_proba_async(self, X, top_k=0, threshold=0, labels_weights=None):
+        """
+        Asynchronous version of :meth:`predict_proba`, the prediction runs in a background thread.
+        The model can be safely used by many threads at the same time.
+
+        :return: Future with list of list of tuples (label id, probability) with predicted labels.
+        :rtype: concurrent.futures.Future
+        """
+        return _get_executor().submit(self.predict_proba, X, top_k, threshold, labels_weights)
+
+    def ofo_async(self, X, Y, type='micro', a=10, b=20, epochs=1):
+        """
+        Asynchronous version of :meth:`ofo`, the optimization runs in a background thread.
+
+        :return: Future with single threshold in case of ``type='micro'`` and list of thresholds in case of ``type='macro'``
+        :rtype: concurrent.futures.Future
+        """
+        return _get_executor().submit(self.ofo, X, Y, type, a, b, epochs)
+
     def get_params(self, deep=False): # deep argument for Scikit-learn compatibility
         """
         Get parameters of this model.
@@ -218,24 +357,31 @@ class Model():
 
         return self
 
-    # def get_weights(self):
-    #     """
-    #     Returns weights of binary classifiers used in the model.
-    #
-    #     :return: Sparse matrix with weights.
-    #     :rtype: csr_matrix
-    #     """
-    #     weights = self._model.get_weights()
-    #     return csr_matrix(weights)
-    #
-    # def set_weights(self, W):
-    #     """
-    #     Set weights of binary classifiers used in the model.
-    #
-    #     :param W: Matrix with weights.
-    #     :type W: csr_matrix|ndarray
-    #     """
-    #     self._model.set_weights(W, Model._check_data_type(W))
+    def get_weights(self):
+        """
+        Return weights of the base classifiers used in the model.
+        Rows of the matrix correspond to the base classifiers (e.g. tree nodes), columns to the features.
+        The matrix has number of features + 1 columns, where the number of features is the size of the features space of the model
+        (the number of columns of the training data, or ``hash`` if it is set), so it is the same for all models trained on the same data
+        and does not change after pruning. Column ``j`` contains weights of feature ``j`` and the last column contains weights of the bias feature.
+        The matrix shares the memory with the arrays created by the native code, so no additional copy is made.
+
+        :return: Sparse matrix with weights.
+        :rtype: csr_matrix
+        """
+        data, indices, indptr, shape = self._model.get_weights()
+        return csr_matrix((data, indices, indptr), shape=shape, copy=False)
+
+    def set_weights(self, W):
+        """
+        Set weights of the base classifiers used in the model and save them to the model directory.
+        The matrix should have the same shape and layout as the one returned by :meth:`get_weights`, the bias in the last column.
+
+        :param W: Matrix with weights.
+        :type W: csr_matrix, ndarray
+        """
+        W = csr_matrix(W, dtype=float32)
+        self._model.set_weights(W.data, W.indices.astype(int32, copy=False), W.indptr.astype(int32, copy=False), W.shape[1])
 
     @staticmethod
     def _get_init_params(locals):
@@ -261,24 +407,27 @@ class Model():
             return -1
 
     def _prepare_pred(self, top_k, threshold, labels_weights):
+        # Thresholds for each label and labels weights are passed with the prediction call,
+        # so concurrent calls with different values do not affect each other
         if top_k == 0 and threshold == 0:
             print("Warning: both top_k and threshold arguments set to 0, this will predict all labels")
 
         if not isinstance(top_k, int):
             raise TypeError("Unsupported top_k type, should be int")
 
+        thresholds = []
         if isinstance(threshold, (list, ndarray)):
-            self._model.set_thresholds(threshold)
+            thresholds = threshold
             threshold = 0
         elif not isinstance(threshold, (float, int)):
             raise TypeError("Unsupported threshold type, should be float, or list of floats, or Numpy vector (1d array)")
 
-        if isinstance(labels_weights, (list, ndarray)):
-            self._model.set_labels_weights(labels_weights)
-        elif labels_weights is not None:
+        if labels_weights is None:
+            labels_weights = []
+        elif not isinstance(labels_weights, (list, ndarray)):
             raise TypeError("Unsupported labels_weights type, should be list of floats, or Numpy vector (1d array)")
 
-        return threshold
+        return threshold, thresholds, labels_weights
 
 
 class LabelTreeModel(Model):
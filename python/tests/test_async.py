@@ -0,0 +1,94 @@
+import shutil
+from concurrent.futures import ThreadPoolExecutor
+from napkinxc.datasets import load_dataset
+from napkinxc.models import PLT, set_worker_pool_size, get_worker_pool_size
+
+from conf import *
+MODEL_PATH = get_model_path(__file__)
+
+
+def test_concurrent_prediction():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    plt = PLT(MODEL_PATH, seed=TEST_SEED)
+    plt.fit_async(X_train, Y_train).result()
+    Y_pred = plt.predict_proba(X_test, top_k=3)
+
+    # Predictions from many threads should be the same as the sequential ones
+    with ThreadPoolExecutor(4) as executor:
+        futures = [executor.submit(plt.predict_proba, X_test, top_k=3) for _ in range(4)]
+        futures.extend([plt.predict_proba_async(X_test, top_k=3) for _ in range(4)])
+        for f in futures:
+            assert f.result() == Y_pred
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_concurrent_prediction_with_different_thresholds_and_weights():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+    labels = max(l for y in Y_train for l in y) + 1
+
+    plt = PLT(MODEL_PATH, seed=TEST_SEED)
+    plt.fit(X_train, Y_train)
+
+    # Each call uses its own thresholds or labels weights
+    configs = [
+        {"top_k": 3},
+        {"threshold": [0.2] * labels},
+        {"threshold": [0.6] * labels},
+        {"top_k": 3, "labels_weights": [1.0 / (l + 1) for l in range(labels)]},
+        {"top_k": 3, "labels_weights": [float(l + 1) for l in range(labels)]},
+    ]
+    expected = [plt.predict_proba(X_test, **c) for c in configs]
+    assert expected[1] != expected[2] and expected[3] != expected[4]
+
+    with ThreadPoolExecutor(8) as executor:
+        futures = [(i, executor.submit(plt.predict_proba, X_test, **configs[i])) for i in list(range(len(configs))) * 4]
+        futures.extend([(i, plt.predict_proba_async(X_test, **configs[i])) for i in range(len(configs))])
+        for i, f in futures:
+            assert f.result() == expected[i]
+
+    # Settings of the previous calls are not kept by the model
+    assert plt.predict_proba(X_test, top_k=3) == expected[0]
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_concurrent_beam_search():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    # Sparse weights are unpacked by beam search, like for the single queries of the tune command
+    plt = PLT(MODEL_PATH, seed=TEST_SEED, load_as="sparse", tree_search_type="beam", beam_search_width=10)
+    plt.fit(X_train, Y_train)
+    Y_pred = plt.predict_proba(X_test, top_k=3)
+
+    queries = [X_test[i:i + 1] for i in range(100)]
+    with ThreadPoolExecutor(4) as executor:
+        futures = [executor.submit(plt.predict_proba, q, top_k=3) for q in queries]
+        futures.extend([executor.submit(plt.predict_proba, X_test, top_k=3) for _ in range(4)])
+        for i, f in enumerate(futures):
+            assert f.result() == (Y_pred[i:i + 1] if i < len(queries) else Y_pred)
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_worker_pool_size():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    plt = PLT(MODEL_PATH, seed=TEST_SEED, threads=1)
+    plt.fit(X_train, Y_train)
+    Y_pred = plt.predict_proba(X_test, top_k=3)
+
+    # Tasks above the size of the pool should still be run, with the same results
+    set_worker_pool_size(2)
+    assert get_worker_pool_size() == 2
+    plt.set_params(threads=4)
+    plt.fit(X_train, Y_train)
+    assert plt.predict_proba(X_test, top_k=3) == Y_pred
+    set_worker_pool_size(0)
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
@@ -0,0 +1,56 @@
+import shutil
+import pytest
+from napkinxc.datasets import load_dataset
+from napkinxc.models import PLT
+
+from conf import *
+MODEL_PATH = get_model_path(__file__)
+
+
+def test_to_from_bytes():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    plt = PLT(MODEL_PATH, seed=TEST_SEED)
+    plt.fit(X_train, Y_train)
+    Y_pred = plt.predict_proba(X_test, top_k=3)
+    data = plt.to_bytes()
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+    # Model loaded from the buffer should give the same predictions and pack to the same buffer
+    plt_from_bytes = PLT.from_bytes(data)
+    assert plt_from_bytes.predict_proba(X_test, top_k=3) == Y_pred
+    assert plt_from_bytes.to_bytes() == data
+
+    # Model loaded from the buffer can be saved only to explicitly set output directory
+    W = plt_from_bytes.get_weights()
+    with pytest.raises(ValueError):
+        plt_from_bytes.set_weights(W)
+    plt_from_bytes.set_params(output=MODEL_PATH)
+    plt_from_bytes.set_weights(W)
+    plt_from_bytes.unload()
+    assert plt_from_bytes.predict_proba(X_test, top_k=3) == Y_pred
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_from_corrupted_bytes():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+
+    plt = PLT(MODEL_PATH, seed=TEST_SEED)
+    plt.fit(X_train, Y_train)
+    data = plt.to_bytes()
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+    # Truncated buffers
+    for size in [0, 6, 16, len(data) // 2, len(data) - 1]:
+        with pytest.raises(ValueError):
+            PLT.from_bytes(data[:size])
+
+    # Huge sizes of the name and the content of the first file (after magic number and files count)
+    name_size = int.from_bytes(data[8:16], "little")
+    for offset in [8, 16 + name_size]:
+        corrupted = bytearray(data)
+        corrupted[offset:offset + 8] = (2 ** 64 - 16).to_bytes(8, "little")
+        with pytest.raises(ValueError):
+            PLT.from_bytes(corrupted)
@@ -0,0 +1,44 @@
+import shutil
+import numpy as np
+from scipy.sparse import vstack
+from napkinxc.datasets import load_dataset
+from napkinxc.models import BR
+
+from conf import *
+MODEL_PATH = get_model_path(__file__)
+
+
+def _duplicated_dataset():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+
+    # All rows are duplicated with the same labels, and some of them once more with different labels
+    X = vstack([X_train, X_train, X_train[:300]]).tocsr()
+    Y = list(Y_train) + list(Y_train) + [[0, 13]] * 300
+    return X, Y
+
+
+def _weights_with_and_without_deduplication(X, Y, model_config):
+    W = []
+    for deduplicate in [False, True]:
+        model = BR(MODEL_PATH, seed=TEST_SEED, threads=1, weights_threshold=0, deduplicate=deduplicate, **model_config)
+        model.fit(X, Y)
+        W.append(model.get_weights())
+        shutil.rmtree(MODEL_PATH, ignore_errors=True)
+    return W
+
+
+def test_deduplicate():
+    X, Y = _duplicated_dataset()
+
+    # Merged examples have the same objective, with the tight tolerance solvers converge to the same weights
+    W = _weights_with_and_without_deduplication(X, Y, {"liblinear_eps": 0.0001})
+    assert W[0].shape == W[1].shape
+    assert np.abs(W[0] - W[1]).max() < 0.01
+
+
+def test_deduplicate_with_shared_columns():
+    X, Y = _duplicated_dataset()
+
+    W = _weights_with_and_without_deduplication(X, Y, {"liblinear_eps": 0.000001, "liblinear_solver": "L1R_LR", "shared_columns": True})
+    assert W[0].shape == W[1].shape
+    assert np.abs(W[0] - W[1]).max() < 0.01
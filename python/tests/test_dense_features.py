@@ -0,0 +1,33 @@
+import shutil
+import numpy as np
+from napkinxc.datasets import load_dataset
+from napkinxc.models import PLT, BR
+
+from conf import *
+MODEL_PATH = get_model_path(__file__)
+
+
+def _assert_same_predictions(Y_pred, Y_pred_dense):
+    assert [[l for l, _ in p] for p in Y_pred] == [[l for l, _ in p] for p in Y_pred_dense]
+    assert np.allclose([p for _, p in sum(Y_pred, [])], [p for _, p in sum(Y_pred_dense, [])], atol=1e-5)
+
+
+def test_dense_features():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+    X_test_dense = X_test.toarray()
+
+    for model_class in [PLT, BR]:
+        for load_as in ["dense", "sparse"]:
+            model = model_class(MODEL_PATH, seed=TEST_SEED, load_as=load_as)
+            model.fit(X_train, Y_train)
+            Y_pred = model.predict_proba(X_test, top_k=3)
+
+            # All features dense and dense features followed by the sparse ones, from the sparse and dense inputs
+            for dense_features in [X_test.shape[1], X_test.shape[1] // 2]:
+                model.set_params(dense_features=dense_features)
+                _assert_same_predictions(Y_pred, model.predict_proba(X_test, top_k=3))
+                _assert_same_predictions(Y_pred, model.predict_proba(X_test_dense, top_k=3))
+                _assert_same_predictions(Y_pred, model.predict_proba(X_test_dense.astype(np.float64), top_k=3))
+
+            shutil.rmtree(MODEL_PATH, ignore_errors=True)
@@ -0,0 +1,78 @@
+import os
+import shutil
+import pytest
+from napkinxc.datasets import load_dataset
+from napkinxc.models import Model, PLT, BR
+
+from conf import *
+MODEL_PATH = get_model_path(__file__)
+
+
+def _batches(X, Y, batch_size=100):
+    for i in range(0, X.shape[0], batch_size):
+        yield X[i:i + batch_size], Y[i:i + batch_size]
+
+
+def _failing_batches(X, Y, batch_size=100):
+    yield X[:batch_size], Y[:batch_size]
+    raise RuntimeError("Reading batches failed")
+
+
+def test_fit_stream():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    for model_class in [PLT, BR]:
+        model = model_class(MODEL_PATH, seed=TEST_SEED)
+        model.fit(X_train, Y_train)
+        Y_pred = model.predict(X_test, top_k=3)
+        shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+        # Batch models trained on the streamed data should be the same as the ones trained on the whole data
+        model = model_class(MODEL_PATH, seed=TEST_SEED)
+        model.fit_stream(_batches(X_train, Y_train))
+        assert model.predict(X_test, top_k=3) == Y_pred
+        shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_fit_stream_online():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    # OPLT is updated with every batch, in a single thread it sees the rows in the same order as in fit
+    params = {"output": MODEL_PATH, "model": "oplt", "tree_type": "onlineBestScore", "seed": TEST_SEED, "threads": 1}
+    model = Model(**params)
+    model.fit(X_train, Y_train)
+    Y_pred = model.predict(X_test, top_k=3)
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+    model = Model(**params)
+    model.fit_stream(_batches(X_train, Y_train))
+    assert model.predict(X_test, top_k=3) == Y_pred
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+    # Other trees are built from the whole data
+    model = Model(output=MODEL_PATH, model="oplt", tree_type="hierarchicalKmeans")
+    with pytest.raises(ValueError):
+        model.fit_stream(_batches(X_train, Y_train))
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_fit_stream_failure():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    model = PLT(MODEL_PATH, seed=TEST_SEED)
+    model.fit(X_train, Y_train)
+    Y_pred = model.predict(X_test, top_k=3)
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+    # Failed streamed training removes the cache and the model can be trained again
+    model = PLT(MODEL_PATH, seed=TEST_SEED)
+    with pytest.raises(RuntimeError):
+        model.fit_stream(_failing_batches(X_train, Y_train))
+    assert not os.path.exists(os.path.join(MODEL_PATH, "stream_cache.bin"))
+
+    model.fit_stream(_batches(X_train, Y_train))
+    assert model.predict(X_test, top_k=3) == Y_pred
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
@@ -0,0 +1,30 @@
+import os
+import shutil
+from napkinxc.datasets import generate_dataset, load_libsvm_file
+from napkinxc.models import PLT
+from napkinxc.measures import precision_at_k
+
+from conf import *
+MODEL_PATH = get_model_path(__file__)
+
+
+def test_generate_dataset():
+    os.makedirs(MODEL_PATH, exist_ok=True)
+    config = {"rows": 5000, "test_rows": 1000, "features": 10000, "labels": 500, "seed": TEST_SEED}
+    generate_dataset(os.path.join(MODEL_PATH, "train.txt"), os.path.join(MODEL_PATH, "test.txt"), **config)
+    generate_dataset(os.path.join(MODEL_PATH, "train.bin"), os.path.join(MODEL_PATH, "test.bin"), binary=True, **config)
+
+    # Both formats contain the same data
+    X_train, Y_train = load_libsvm_file(os.path.join(MODEL_PATH, "train.txt"))
+    X_train_bin, Y_train_bin = load_libsvm_file(os.path.join(MODEL_PATH, "train.bin"))
+    assert X_train.shape[0] == 5000
+    assert Y_train == Y_train_bin
+    assert (X_train != X_train_bin).nnz == 0
+
+    # Test data points come from the same latent structure, so they are predictable
+    X_test, Y_test = load_libsvm_file(os.path.join(MODEL_PATH, "test.bin"))
+    plt = PLT(os.path.join(MODEL_PATH, "model"), seed=TEST_SEED)
+    plt.fit(X_train_bin, Y_train_bin)
+    assert precision_at_k(Y_test, plt.predict(X_test, top_k=1), k=1) > 0.3
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
@@ -0,0 +1,27 @@
+import shutil
+from napkinxc.datasets import load_dataset
+from napkinxc.metrics import enable_metrics, reset_metrics, get_metrics
+from napkinxc.models import PLT
+
+from conf import *
+MODEL_PATH = get_model_path(__file__)
+
+
+def test_metrics():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    enable_metrics()
+    reset_metrics()
+    plt = PLT(MODEL_PATH, seed=TEST_SEED)
+    plt.fit(X_train, Y_train)
+    plt.predict(X_test, top_k=1)
+    metrics = get_metrics()
+    enable_metrics(False)
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+    assert metrics["counters"]["trained_bases"] > 0
+    assert metrics["counters"]["predicted_queries"] == X_test.shape[0]
+    assert metrics["counters"]["evaluated_nodes"] >= X_test.shape[0]
+    assert metrics["timers"]["predict"]["count"] == X_test.shape[0]
+    assert "napkinxc_predict_seconds_count" in get_metrics("prometheus")
@@ -0,0 +1,29 @@
+import shutil
+from napkinxc.datasets import load_dataset
+from napkinxc.models import BR
+
+from conf import *
+MODEL_PATH = get_model_path(__file__)
+
+
+def test_refit_with_reindex_features():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    model = BR(MODEL_PATH, seed=TEST_SEED, threads=1, reindex_features=True)
+    model.fit(X_train, Y_train)
+    Y_pred = model.predict_proba(X_test, top_k=3)
+
+    # Every training reads the data without the features map of the previous model
+    model.fit(X_train, Y_train)
+    assert model.predict_proba(X_test, top_k=3) == Y_pred
+
+    model.fit_stream([(X_train[:500], Y_train[:500]), (X_train[500:], Y_train[500:])])
+    assert model.predict_proba(X_test, top_k=3) == Y_pred
+
+    model.fit_on_file(TEST_TRAIN_DATA_PATH)
+    Y_pred_file = model.predict_proba(X_test, top_k=3)
+    model.fit_on_file(TEST_TRAIN_DATA_PATH)
+    assert model.predict_proba(X_test, top_k=3) == Y_pred_file
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
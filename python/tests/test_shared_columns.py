@@ -0,0 +1,26 @@
+import shutil
+from napkinxc.datasets import load_dataset
+from napkinxc.models import OVR
+
+from conf import *
+MODEL_PATH = get_model_path(__file__)
+
+
+def test_shared_columns_with_duplicated_rows():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    # With pick one label weighting, the same row is used once for each of its labels,
+    # so the problems with shared columns contain duplicated rows
+    W = []
+    Y_pred = []
+    for shared_columns in [False, True]:
+        model = OVR(MODEL_PATH, seed=TEST_SEED, threads=1, pick_one_label_weighting=True,
+                    liblinear_solver="L1R_LR", shared_columns=shared_columns)
+        model.fit(X_train, Y_train)
+        W.append(model.get_weights())
+        Y_pred.append(model.predict_proba(X_test, top_k=3))
+        shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+    assert (W[0] != W[1]).nnz == 0
+    assert Y_pred[0] == Y_pred[1]
@@ -0,0 +1,45 @@
+import shutil
+import numpy as np
+import pytest
+from scipy.sparse import csr_matrix, hstack
+from napkinxc.datasets import load_dataset
+from napkinxc.models import PLT, BR
+
+from conf import *
+MODEL_PATH = get_model_path(__file__)
+
+
+def test_get_set_weights():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    for model_class in [PLT, BR]:
+        model = model_class(MODEL_PATH, seed=TEST_SEED)
+        model.fit(X_train, Y_train)
+        Y_pred = model.predict_proba(X_test, top_k=3)
+
+        # Features and the bias in the last column
+        W = model.get_weights()
+        assert W.shape[1] == X_train.shape[1] + 1
+
+        # Setting the same weights should not change the predictions, also after reloading the model
+        model.set_weights(W)
+        assert np.allclose([p for _, p in sum(model.predict_proba(X_test, top_k=3), [])], [p for _, p in sum(Y_pred, [])])
+        model.unload()
+        assert (model.get_weights() != W).nnz == 0
+
+        # The layout does not depend on the values of the weights
+        W_bias = csr_matrix(hstack([csr_matrix((W.shape[0], W.shape[1] - 1), dtype=W.dtype), W[:, -1:]]))
+        model.set_weights(W_bias)
+        assert model.get_weights().shape == W.shape
+        assert (model.get_weights()[:, -1] != W[:, -1]).nnz == 0
+
+        with pytest.raises(ValueError):
+            model.set_weights(W[:, :-1])
+
+        # Features of the new weights are not pruned from the queries of the model loaded with the bias only
+        model.unload()
+        model.set_weights(W)
+        assert np.allclose([p for _, p in sum(model.predict_proba(X_test, top_k=3), [])], [p for _, p in sum(Y_pred, [])])
+
+        shutil.rmtree(MODEL_PATH, ignore_errors=True)
@@ -41,6 +41,7 @@ Args::Args() {
     rngSeeder.seed(seed);
     threads = getCpuCount();
     memLimit = getSystemMemory();
+    poolSize = 0;
     saveGrads = false;
     resume = false;
     loadAs = map;
@@ -49,6 +50,8 @@ Args::Args() {
     input = "";
     output = ".";
     prediction = "";
+    metrics = "";
+    profile = false;
     modelName = "plt";
     modelType = plt;
     hash = 0;
@@ -56,11 +59,22 @@ Args::Args() {
     bias = 1.0;
     norm = true;
     featuresThreshold = 0.0;
+    reindexFeatures = false;
+    featuresSize = 0;
+    pruneQueryFeatures = true;
+    denseFeatures = 0;
 
     // Training options
     eps = 0.1;
     cost = 10.0;
     maxIter = 100;
+    sharedColumns = false;
+    deduplicate = false;
+    warmStart = "";
+    hybrid = false;
+    hybridMinRows = 100;
+    hybridEpochs = 3;
+    hybridIterRows = 100000;
     autoCLin = false;
     autoCLog = false;
 
@@ -133,9 +147,51 @@ Args::Args() {
     psA = 0.55;
     psB = 1.5;
 
+    // Args for generate command
+    generateRows = 10000;
+    testRows = 0;
+    testOutput = "";
+    generateFeatures = 100000;
+    generateLabels = 10000;
+    labelsPerRow = 3;
+    featuresPerRow = 50;
+    labelsPowerLaw = 1.0;
+    latentClusters = 0;
+    featuresNoise = 0.1;
+    binaryData = false;
+
+    // Args for plan command
+    scanRows = 0;
+
+    // Args for tune command
+    validation = "";
+    tuneArity = "";
+    tuneMaxLeaves = "";
+    tuneWeightsThreshold = "0.1,0.2,0.3,0.5";
+    tuneLoadAs = "map,sparse,dense";
+    tuneBeamSearchWidth = "0,10,20";
+    latencyLimit = 0;
+    tunedArgs = "";
+
+    // Args for convert command
+    convertOutput = "";
+    pruneThreshold = 0;
+    saveAs = "auto";
+    quantize = 0;
+    compress = false;
+    reindexModel = false;
+    archive = false;
+    verifyRows = 1000;
+    tolerance = 0.01;
+
     // Args for testPredictionTime command
     batchSizes = "100,1000,10000";
     batches = 10;
+    benchmarkThreads = "1";
+    benchmarkQueries = 0;
+    warmupQueries = 100;
+    arrivalRate = 0;
+    report = "";
 }
 
 // Parse args
@@ -163,6 +219,9 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                     threads = getCpuCount();
                 else if (threads == -1)
                     threads = getCpuCount() - 1;
+            } else if (args[ai] == "--poolSize") {
+                poolSize = std::stoi(args.at(ai + 1));
+                if (poolSize < 0) throw std::invalid_argument("--poolSize must be non-negative");
             } else if (args[ai] == "--memLimit") {
                 memLimit = static_cast<unsigned long long>(std::stof(args.at(ai + 1)) * 1024 * 1024 * 1024);
                 if (memLimit == 0) memLimit = getSystemMemory();
@@ -187,6 +246,10 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                 output = std::string(args.at(ai + 1));
             else if (args[ai] == "--prediction")
                 prediction = std::string(args.at(ai + 1));
+            else if (args[ai] == "--metrics")
+                metrics = std::string(args.at(ai + 1));
+            else if (args[ai] == "--profile")
+                profile = std::stoi(args.at(ai + 1)) != 0;
             else if (args[ai] == "--ensemble")
                 ensemble = std::stoi(args.at(ai + 1));
             else if (args[ai] == "--ensOnTheTrot")
@@ -217,6 +280,12 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                 hash = std::stoi(args.at(ai + 1));
             else if (args[ai] == "--featuresThreshold")
                 featuresThreshold = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--reindexFeatures")
+                reindexFeatures = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--pruneQueryFeatures")
+                pruneQueryFeatures = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--denseFeatures")
+                denseFeatures = std::stoi(args.at(ai + 1));
             else if (args[ai] == "--weightsThreshold")
                 weightsThreshold = std::stof(args.at(ai + 1));
 
@@ -227,6 +296,20 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                 cost = std::stof(args.at(ai + 1));
             else if (args[ai] == "--maxIter" || args[ai] == "--liblinearMaxIter")
                 maxIter = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--sharedColumns" || args[ai] == "--liblinearSharedColumns")
+                sharedColumns = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--deduplicate")
+                deduplicate = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--warmStart")
+                warmStart = std::string(args.at(ai + 1));
+            else if (args[ai] == "--hybrid")
+                hybrid = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--hybridMinRows")
+                hybridMinRows = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--hybridEpochs")
+                hybridEpochs = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--hybridIterRows")
+                hybridIterRows = std::stoi(args.at(ai + 1));
             else if (args[ai] == "--inbalanceLabelsWeighting")
                 inbalanceLabelsWeighting = std::stoi(args.at(ai + 1)) != 0;
             else if (args[ai] == "--pickOneLabelWeighting")
@@ -375,10 +458,80 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                 beamSearchWidth = std::stoi(args.at(ai + 1));
             else if (args[ai] == "--beamSearchUnpack")
                 beamSearchUnpack = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--rows")
+                generateRows = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--testRows")
+                testRows = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--testOutput")
+                testOutput = args.at(ai + 1);
+            else if (args[ai] == "--features")
+                generateFeatures = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--labels")
+                generateLabels = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--labelsPerRow")
+                labelsPerRow = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--featuresPerRow")
+                featuresPerRow = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--labelsPowerLaw")
+                labelsPowerLaw = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--latentClusters")
+                latentClusters = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--featuresNoise")
+                featuresNoise = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--binary")
+                binaryData = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--scanRows")
+                scanRows = std::stoll(args.at(ai + 1));
+            else if (args[ai] == "--validation")
+                validation = std::string(args.at(ai + 1));
+            else if (args[ai] == "--tuneArity")
+                tuneArity = args.at(ai + 1);
+            else if (args[ai] == "--tuneMaxLeaves")
+                tuneMaxLeaves = args.at(ai + 1);
+            else if (args[ai] == "--tuneWeightsThreshold")
+                tuneWeightsThreshold = args.at(ai + 1);
+            else if (args[ai] == "--tuneLoadAs")
+                tuneLoadAs = args.at(ai + 1);
+            else if (args[ai] == "--tuneBeamSearchWidth")
+                tuneBeamSearchWidth = args.at(ai + 1);
+            else if (args[ai] == "--latencyLimit")
+                latencyLimit = std::stod(args.at(ai + 1));
+            else if (args[ai] == "--convertOutput")
+                convertOutput = std::string(args.at(ai + 1));
+            else if (args[ai] == "--pruneThreshold")
+                pruneThreshold = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--saveAs") {
+                saveAs = args.at(ai + 1);
+                if (saveAs != "auto" && saveAs != "dense" && saveAs != "sparse")
+                    throw std::invalid_argument("Unknown on-disk representation type: " + saveAs);
+            } else if (args[ai] == "--quantize") {
+                quantize = std::stoi(args.at(ai + 1));
+                if (quantize != 0 && quantize != 8 && quantize != 16)
+                    throw std::invalid_argument("Unsupported number of quantization bits: " + args.at(ai + 1));
+            } else if (args[ai] == "--compress")
+                compress = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--reindexModel")
+                reindexModel = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--archive")
+                archive = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--verifyRows")
+                verifyRows = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--tolerance")
+                tolerance = std::stof(args.at(ai + 1));
             else if (args[ai] == "--batchSizes")
                 batchSizes = args.at(ai + 1);
             else if (args[ai] == "--batches")
                 batches = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--benchmarkThreads")
+                benchmarkThreads = args.at(ai + 1);
+            else if (args[ai] == "--benchmarkQueries")
+                benchmarkQueries = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--warmupQueries")
+                warmupQueries = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--arrivalRate")
+                arrivalRate = std::stod(args.at(ai + 1));
+            else if (args[ai] == "--report")
+                report = args.at(ai + 1);
 
             else if (args[ai] == "--measures")
                 measures = std::string(args.at(ai + 1));
@@ -454,7 +607,8 @@ void Args::printArgs(std::string command) {
     Log(CERR) << "napkinXC " << VERSION << " - " << command;
     if (!input.empty())
         Log(CERR) << "\n  Input: " << input << "\n    Bias: " << bias << ", norm: " << norm
-        << ", hash size: " << hash << ", features threshold: " << featuresThreshold;
+        << ", hash size: " << hash << ", features threshold: " << featuresThreshold
+        << ", reindex features: " << reindexFeatures;
     Log(CERR) << "\n  Model: " << output << "\n    Type: " << modelName;
     if (ensemble > 1){
         Log(CERR) << ", ensemble: " << ensemble;
@@ -465,9 +619,12 @@ void Args::printArgs(std::string command) {
     if (command == "train") {
         // Base binary models related
         Log(CERR) << "\n  Base models optimizer: " << optimizerName;
-        if (optimizerType == liblinear)
+        if (optimizerType == liblinear) {
             Log(CERR) << "\n    Solver: " << solverName << ", eps: " << eps << ", cost: " << cost << ", max iter: " << maxIter;
-        else
+            if (hybrid)
+                Log(CERR) << "\n    Hybrid: AdaGrad below " << hybridMinRows << " rows for " << hybridEpochs
+                          << " epochs, max iter scaled above " << hybridIterRows << " rows";
+        } else
             Log(CERR) << "\n    Loss: " << lossName << ", eta: " << eta << ", epochs: " << epochs;
         if (optimizerType == adagrad) Log(CERR) << ", AdaGrad eps " << adagradEps;
         Log(CERR) << ", weights threshold: " << weightsThreshold;
@@ -508,7 +665,9 @@ void Args::printArgs(std::string command) {
     if (command == "ofo")
         Log(CERR) << "\n  Epochs: " << epochs << ", initial a: " << ofoA << ", initial b: " << ofoB;
 
-    Log(CERR) << "\n  Threads: " << threads << ", memory limit: " << formatMem(memLimit)
+    Log(CERR) << "\n  Threads: " << threads;
+    if (poolSize) Log(CERR) << ", pool size: " << poolSize;
+    Log(CERR) << ", memory limit: " << formatMem(memLimit)
     << "\n  Seed: " << seed << "\n";
 }
 
@@ -523,7 +682,7 @@ int Args::countArgs(const std::vector<std::string>& args, std::vector<std::strin
     return count;
 }
 
-void Args::save(std::ofstream& out) {
+void Args::save(std::ostream& out) {
     std::string version = VERSION;
     saveVar(out, version);
 
@@ -537,9 +696,19 @@ void Args::save(std::ofstream& out) {
     saveVar(out, modelType);
     saveVar(out, modelName);
     saveVar(out, ensemble);
+
+    // Features reindexing, saved last, so files without it can still be loaded
+    saveVar(out, reindexFeatures);
+    if (reindexFeatures) {
+        size_t size = featuresMap ? featuresMap->size() : 0;
+        saveVar(out, size);
+        if (size) out.write((char*)featuresMap->data(), size * sizeof(int));
+    }
+    saveVar(out, featuresSize);
+    saveVar(out, tunedArgs);
 }
 
-void Args::load(std::ifstream& in) {
+void Args::load(std::istream& in) {
     std::string version;
     loadVar(in, version);
     if(version != VERSION)
@@ -556,5 +725,20 @@ void Args::load(std::ifstream& in) {
     loadVar(in, modelName);
     loadVar(in, ensemble);
 
+    reindexFeatures = false;
+    featuresMap = nullptr;
+    if (in.peek() != EOF) loadVar(in, reindexFeatures);
+    if (reindexFeatures) {
+        size_t size;
+        loadVar(in, size);
+        featuresMap = std::make_shared<std::vector<int>>(size);
+        in.read((char*)featuresMap->data(), size * sizeof(int));
+    }
+    featuresSize = 0;
+    if (in.peek() != EOF) loadVar(in, featuresSize);
+    tunedArgs = "";
+    if (in.peek() != EOF) loadVar(in, tunedArgs);
+
+    if (!tunedArgs.empty()) parseArgs(split(tunedArgs, ' '), false);
     parseArgs(parsedArgs, false);
 }
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <memory>
 #include <random>
 #include <string>
 
@@ -38,12 +39,13 @@ public:
     void printArgs(std::string command = "");
     int countArg(const std::vector<std::string>& args, std::string to_count);
     int countArgs(const std::vector<std::string>& args, std::vector<std::string> to_count);
-    void save(std::ofstream& out) override;
-    void load(std::ifstream& in) override;
+    void save(std::ostream& out) override;
+    void load(std::istream& in) override;
 
     // Threading, memory and seed options
     int seed;
     int threads;
+    int poolSize;
     unsigned long long memLimit; // TODO: Implement this for some models
     bool saveGrads;
     bool resume;
@@ -53,11 +55,18 @@ public:
     std::string input;
     std::string output;
     std::string prediction;
+    std::string metrics;
+    bool profile;
     ModelType modelType;
     bool processData;
     Real bias;
     bool norm;
     int hash;
+    bool reindexFeatures;
+    bool pruneQueryFeatures;
+    int denseFeatures;
+    std::shared_ptr<std::vector<int>> featuresMap; // new index of each feature, -1 for the features not seen in training
+    int featuresSize; // size of the features space of the training data (features.cols()), 0 if unknown
     Real featuresThreshold;
 
     // Training options
@@ -67,6 +76,13 @@ public:
     Real eps;
     Real cost;
     int maxIter;
+    bool sharedColumns;
+    bool deduplicate;
+    std::string warmStart;
+    bool hybrid;
+    int hybridMinRows;
+    int hybridEpochs;
+    int hybridIterRows;
     Real weightsThreshold;
     bool inbalanceLabelsWeighting;
     bool pickOneLabelWeighting;
@@ -131,9 +147,51 @@ public:
     Real psA;
     double psB;
 
+    // Args for generate command
+    int generateRows;
+    int testRows;
+    std::string testOutput;
+    int generateFeatures;
+    int generateLabels;
+    Real labelsPerRow;
+    int featuresPerRow;
+    Real labelsPowerLaw;
+    int latentClusters;
+    Real featuresNoise;
+    bool binaryData;
+
+    // Args for plan command
+    long long scanRows;
+
+    // Args for tune command
+    std::string validation;
+    std::string tuneArity;
+    std::string tuneMaxLeaves;
+    std::string tuneWeightsThreshold;
+    std::string tuneLoadAs;
+    std::string tuneBeamSearchWidth;
+    double latencyLimit;
+    std::string tunedArgs; // Args chosen by tune, saved with the model and applied on load before the given ones
+
+    // Args for convert command
+    std::string convertOutput;
+    Real pruneThreshold;
+    std::string saveAs;
+    int quantize;
+    bool compress;
+    bool reindexModel;
+    bool archive;
+    int verifyRows;
+    Real tolerance;
+
     // Args for testPredictionTime command
     std::string batchSizes;
     int batches;
+    std::string benchmarkThreads;
+    int benchmarkQueries;
+    int warmupQueries;
+    double arrivalRate;
+    std::string report;
 
 private:
     std::default_random_engine rngSeeder;
@@ -20,6 +20,7 @@
  SOFTWARE.
  */
 
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <random>
@@ -98,6 +99,59 @@ void Base::trainLiblinear(ProblemData& problemData, Args& args) {
                  /*.bias =*/ -1,
                  /*.W =*/ problemData.instancesWeights.data()};
 
+    // Examples with identical features and label are merged into one with the sum of their weights,
+    // the objective stays the same
+    std::vector<Real> dedupLabels;
+    std::vector<Feature*> dedupFeatures;
+    std::vector<Real> dedupWeights;
+    if (problemData.duplicateRows != nullptr) {
+        UnorderedMap<Feature*, int> positions[2];
+        for (int r = 0; r < P.l; ++r) {
+            Feature* row = problemData.binFeatures[r];
+            auto d = problemData.duplicateRows->find(row);
+            if (d != problemData.duplicateRows->end()) row = d->second;
+
+            int label = problemData.binLabels[r] == 1;
+            auto p = positions[label].find(row);
+            if (p == positions[label].end()) {
+                positions[label].emplace(row, dedupLabels.size());
+                dedupLabels.push_back(problemData.binLabels[r]);
+                dedupFeatures.push_back(row);
+                dedupWeights.push_back(problemData.instancesWeights[r]);
+            } else dedupWeights[p->second] += problemData.instancesWeights[r];
+        }
+
+        if (dedupLabels.size() < P.l) {
+            P.l = static_cast<int>(dedupLabels.size());
+            P.y = dedupLabels.data();
+            P.x = reinterpret_cast<feature_node**>(dedupFeatures.data());
+            P.W = dedupWeights.data();
+        }
+    }
+
+    // Start from the previous weights, oriented towards the class that liblinear takes as the first one
+    std::vector<float> initSol;
+    if (problemData.initBase != nullptr) {
+        std::vector<int> indices;
+        std::vector<Real> values;
+        problemData.initBase->getWeights(indices, values);
+
+        int first = 0;
+        while (first < P.l && P.W[first] <= 0) ++first;
+        Real sign = (first < P.l && P.y[first] == 1) ? 1 : -1;
+
+        if (!values.empty()) {
+            initSol.resize(problemData.n, 0);
+            for (int i = 0; i < indices.size(); ++i)
+                if (indices[i] > 0 && indices[i] <= problemData.n) initSol[indices[i] - 1] = sign * values[i];
+        }
+    }
+
+    // In hybrid mode large problems get fewer iterations
+    int maxIter = args.maxIter;
+    if (args.hybrid && P.l > args.hybridIterRows)
+        maxIter = std::max(10, static_cast<int>(static_cast<double>(args.maxIter) * args.hybridIterRows / P.l));
+
     parameter C = {/*.solver_type =*/ args.solverType,
                    /*.eps =*/ args.eps,
                    /*.C =*/ cost,
@@ -105,8 +159,11 @@ void Base::trainLiblinear(ProblemData& problemData, Args& args) {
                    /*.weight_label =*/ problemData.labels,
                    /*.weight =*/ problemData.labelsWeights,
                    /*.p =*/ 0,
-                   /*.init_sol =*/ NULL,
-                   /*.max_iter =*/ args.maxIter};
+                   /*.init_sol =*/ initSol.empty() ? NULL : initSol.data(),
+                   /*.max_iter =*/ maxIter,
+                   /*.nr_thread =*/ problemData.threads,
+                   /*.ws =*/ problemData.ws,
+                   /*.shared_cols =*/ problemData.sharedColumns};
 
     auto output = check_parameter(&P, &C);
     assert(output == NULL);
@@ -133,7 +190,7 @@ void Base::trainLiblinear(ProblemData& problemData, Args& args) {
     free(M);
 }
 
-void Base::trainOnline(ProblemData& problemData, Args& args) {
+void Base::trainOnline(ProblemData& problemData, Args& args, OptimizerType optimizerType, int epochs) {
     classCount = 2;
     firstClass = 1;
     t = 0;
@@ -143,10 +200,10 @@ void Base::trainOnline(ProblemData& problemData, Args& args) {
 
     // Set update function
     void (*updateFunc)(Vector&, Vector&, Feature*, Real, int, Args&);
-    if(args.optimizerType == sgd) {
+    if(optimizerType == sgd) {
         updateFunc = &updateSGD;
     }
-    else if (args.optimizerType == adagrad){
+    else if (optimizerType == adagrad){
         updateFunc = &updateAdaGrad;
         newG = new Vector(problemData.n);
     }
@@ -154,7 +211,7 @@ void Base::trainOnline(ProblemData& problemData, Args& args) {
         throw std::invalid_argument("Unknown online update function type");
 
     const int examples = problemData.binFeatures.size();
-    for (int e = 0; e < args.epochs; ++e)
+    for (int e = 0; e < epochs; ++e)
         for (int r = 0; r < examples; ++r) {
             Real label = problemData.binLabels[r];
             Feature* features = problemData.binFeatures[r];
@@ -174,6 +231,10 @@ void Base::trainOnline(ProblemData& problemData, Args& args) {
     G = newG;
 }
 
+static const char* optimizerName(OptimizerType optimizer) {
+    return optimizer == liblinear ? "liblinear" : optimizer == sgd ? "sgd" : "adagrad";
+}
+
 void Base::train(ProblemData& problemData, Args& args) {
     // Delete previous weights
     delete W;
@@ -182,6 +243,11 @@ void Base::train(ProblemData& problemData, Args& args) {
     // Set loss function
     setLoss(args.lossType);
 
+    // In hybrid mode small problems are trained with a few AdaGrad epochs, liblinear's setup is too costly for them
+    problemData.optimizer = args.optimizerType;
+    if (args.optimizerType == liblinear && args.hybrid && problemData.binLabels.size() < args.hybridMinRows)
+        problemData.optimizer = adagrad;
+
     if (problemData.binLabels.empty()) {
         firstClass = 0;
         classCount = 0;
@@ -216,8 +282,17 @@ void Base::train(ProblemData& problemData, Args& args) {
         }
     }
 
-    if (args.optimizerType == liblinear) trainLiblinear(problemData, args);
-    else trainOnline(problemData, args);
+    auto startTime = std::chrono::steady_clock::now();
+    if (problemData.optimizer == liblinear) trainLiblinear(problemData, args);
+    else if (problemData.optimizer == args.optimizerType) trainOnline(problemData, args, args.optimizerType, args.epochs);
+    else {
+        trainOnline(problemData, args, problemData.optimizer, args.hybridEpochs);
+        delete G; // Not needed by the model trained with liblinear
+        G = nullptr;
+    }
+    problemData.trainTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    Metrics::record(baseTrainTime, problemData.trainTime, {static_cast<int>(problemData.binLabels.size()), optimizerName(problemData.optimizer)});
+    Metrics::count(trainedBases);
 
     // Calculate final train loss
     if(args.reportLoss) {
@@ -282,8 +357,62 @@ Real Base::predictValue(SparseVector& features) {
     return val;
 }
 
+Real Base::predictValue(SparseVector& features, AbstractVector& unpackedW) {
+    if (classCount < 2 || !W) return static_cast<Real>((1 - 2 * firstClass) * -10);
+    Real val = unpackedW.dot(features);
+    if (firstClass == 0) val *= -1;
+
+    return val;
+}
+
+void Base::predictValues(Real* values, const Real* x, int dims, Feature* const* tails, int count) {
+    if (classCount < 2 || !W) {
+        std::fill(values, values + count, static_cast<Real>((1 - 2 * firstClass) * -10));
+        return;
+    }
+
+    if (W->type() == dense) {
+        // Dense block is multiplied by the weights row, which stays in cache for all the queries of the block
+        const Real* w = static_cast<Vector*>(W)->data();
+        const int n = std::min(dims, static_cast<int>(W->size()));
+        for (int q = 0; q < count; ++q) {
+            const Real* xq = x + static_cast<size_t>(q) * dims;
+            Real s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            int i = 0;
+            for (; i + 4 <= n; i += 4) {
+                s0 += w[i] * xq[i];
+                s1 += w[i + 1] * xq[i + 1];
+                s2 += w[i + 2] * xq[i + 2];
+                s3 += w[i + 3] * xq[i + 3];
+            }
+            for (; i < n; ++i) s0 += w[i] * xq[i];
+            for (auto f = tails[q]; f->index != -1; ++f)
+                if (f->index < W->size()) s0 += f->value * w[f->index];
+            values[q] = (s0 + s1) + (s2 + s3);
+        }
+    } else {
+        std::fill(values, values + count, 0);
+        W->forEachIV([&](const int& i, Real& v) {
+            if (i < dims)
+                for (int q = 0; q < count; ++q) values[q] += v * x[static_cast<size_t>(q) * dims + i];
+        });
+        for (int q = 0; q < count; ++q)
+            if (tails[q]->index != -1) values[q] += W->dot(tails[q]);
+    }
+
+    if (firstClass == 0)
+        for (int q = 0; q < count; ++q) values[q] *= -1;
+}
+
 Real Base::predictProbability(SparseVector& features) {
-    Real val = predictValue(features);
+    return probability(predictValue(features));
+}
+
+Real Base::predictProbability(SparseVector& features, AbstractVector& unpackedW) {
+    return probability(predictValue(features, unpackedW));
+}
+
+Real Base::probability(Real val) {
     if (lossType == squaredHinge)
         //val = 1.0 / (1.0 + std::exp(-2 * val)); // Probability for squared Hinge loss solver
         val = std::exp(-std::pow(std::max(0.0, 1.0 - val), 2));
@@ -303,6 +432,41 @@ void Base::clear() {
     G = nullptr;
 }
 
+void Base::getWeights(std::vector<int>& indices, std::vector<Real>& values) {
+    if (classCount < 2 || W == nullptr) return;
+    Real sign = (firstClass == 0) ? -1 : 1;
+    W->forEachIV([&](const int& i, Real& v) {
+        if(v != 0) {
+            indices.push_back(i);
+            values.push_back(sign * v);
+        }
+    });
+}
+
+void Base::setWeights(const int* indices, const Real* values, int n0, RepresentationType type) {
+    if (n0 == 0 && isDummy()) return; // Dummy bases have no weights, keep their constant prediction
+
+    // Reuse already allocated weights vector if possible
+    if(W == nullptr || W->type() != type){
+        delete W;
+        if(type == dense) W = new Vector();
+        else if(type == sparse) W = new SparseVector();
+        else W = new MapVector();
+    } else W->initD();
+
+    if(type == dense){
+        int maxIndex = 0;
+        for(int i = 0; i < n0; ++i) maxIndex = std::max(maxIndex, indices[i]);
+        W->resize(maxIndex + 1);
+    } else W->reserve(n0);
+
+    for(int i = 0; i < n0; ++i) W->insertD(indices[i], values[i]);
+    if(type == sparse) static_cast<SparseVector*>(W)->sort();
+
+    classCount = 2;
+    firstClass = 1;
+}
+
 void Base::pruneWeights(Real threshold) {
     if(W != nullptr) {
         Real bias = W->at(1); // Do not prune bias feature
@@ -311,7 +475,25 @@ void Base::pruneWeights(Real threshold) {
     }
 }
 
-void Base::save(std::ofstream& out, bool saveGrads) {
+void Base::reindexWeights(const std::vector<int>& featuresMap, size_t newSize) {
+    auto reindexVec = [&](AbstractVector*& vec) {
+        if (vec == nullptr) return;
+        auto type = vec->type();
+        auto newVec = new SparseVector(newSize, vec->nonZero() + 1);
+        vec->forEachIV([&](const int& i, Real& v) {
+            if (v != 0 && i < featuresMap.size() && featuresMap[i] > 0) newVec->insertD(featuresMap[i], v);
+        });
+        newVec->sort();
+        delete vec;
+        vec = vecTo(newVec, type);
+        if (vec != newVec) delete newVec;
+    };
+    reindexVec(W);
+    reindexVec(G);
+}
+
+void Base::save(std::ostream& out, bool saveGrads, const VectorCoding& coding) {
+    MetricScope scope(baseSaveTime);
     saveVar(out, classCount);
     saveVar(out, firstClass);
     saveVar(out, lossType);
@@ -323,14 +505,15 @@ void Base::save(std::ofstream& out, bool saveGrads) {
         saveVar(out, s);
         saveVar(out, n0);
 
-        W->save(out);
+        W->save(out, coding);
         bool grads = (saveGrads && G != nullptr);
         saveVar(out, grads);
         if (grads) G->save(out);
     }
 }
 
-void Base::load(std::ifstream& in, bool loadGrads, RepresentationType loadAs) {
+void Base::load(std::istream& in, bool loadGrads, RepresentationType loadAs) {
+    MetricScope scope(baseLoadTime);
     clear();
     loadVar(in, classCount);
     loadVar(in, firstClass);
@@ -426,13 +609,14 @@ Base* Base::copyInverted() {
 }
 
 void Base::to(RepresentationType type) {
+    // vecTo returns the same vector if it already has the type
     auto newW = vecTo(W, type);
-    if(newW != nullptr){
+    if(newW != W){
         delete W;
         W = newW;
     }
     auto newG = vecTo(G, type);
-    if(newG != nullptr){
+    if(newG != G){
         delete G;
         G = newG;
     }
@@ -31,9 +31,14 @@
 #include <mutex>
 
 #include "args.h"
+#include "metrics.h"
 #include "vector.h"
 
 
+struct workspace;
+struct col_problem;
+class Base;
+
 struct ProblemData {
     std::vector<Real>& binLabels;
     std::vector<Feature*>& binFeatures;
@@ -46,6 +51,13 @@ struct ProblemData {
     Real invPs; // inverse propensity
     int r; // number of all examples
     Real loss;
+    int threads; // threads available for training this problem
+    workspace* ws; // liblinear's memory reused between problems trained in the same thread
+    col_problem* sharedColumns; // transposed rows of all problems in the batch used by L1 solvers
+    Base* initBase; // previously trained base, its weights are the initial solution
+    const UnorderedMap<Feature*, Feature*>* duplicateRows; // maps duplicated rows to one row with the same features
+    OptimizerType optimizer; // optimizer that trained the problem
+    double trainTime; // in seconds
 
     ProblemData(std::vector<Real>& binLabels, std::vector<Feature*>& binFeatures, int n, std::vector<Real>& instancesWeights):
                 binLabels(binLabels), binFeatures(binFeatures), n(n), instancesWeights(instancesWeights) {
@@ -54,6 +66,14 @@ struct ProblemData {
         labelsWeights = NULL;
         invPs = 1.0;
         r = 0;
+        loss = 0;
+        threads = 1;
+        ws = NULL;
+        sharedColumns = NULL;
+        initBase = NULL;
+        duplicateRows = NULL;
+        optimizer = liblinear;
+        trainTime = 0;
     }
 };
 
@@ -68,7 +88,7 @@ public:
     void unsafeUpdate(Real label, Feature* feature, Args& args);
     void train(ProblemData& problemData, Args& args);
     void trainLiblinear(ProblemData& problemData, Args& args);
-    void trainOnline(ProblemData& problemData, Args& args);
+    void trainOnline(ProblemData& problemData, Args& args, OptimizerType optimizerType, int epochs);
 
     // For online training
     void setupOnlineTraining(Args& args, int n = 0, bool startWithDenseW = false);
@@ -76,6 +96,14 @@ public:
 
     Real predictValue(SparseVector& features);
     Real predictProbability(SparseVector& features);
+    // Same as above, but with W unpacked by the caller to the given vector, the base itself is not modified
+    Real predictValue(SparseVector& features, AbstractVector& unpackedW);
+    Real predictProbability(SparseVector& features, AbstractVector& unpackedW);
+    Real probability(Real value);
+
+    // Values for a block of count queries, their features with indices < dims are given as dense rows of x,
+    // the remaining ones as sparse lists in tails
+    void predictValues(Real* values, const Real* x, int dims, Feature* const* tails, int count);
 
     inline AbstractVector* getW() { return W; };
     inline AbstractVector* getG() { return G; };
@@ -83,6 +111,10 @@ public:
     inline void setW(AbstractVector* vec) { W = vec; };
     inline void setG(AbstractVector* vec) { G = vec; };
 
+    // Weights in the form used for prediction (predictValue(x) = w^T x)
+    void getWeights(std::vector<int>& indices, std::vector<Real>& values); // Appends non-zero weights
+    void setWeights(const int* indices, const Real* values, int n0, RepresentationType type=map);
+
     unsigned long long mem();
     inline int getFirstClass() { return firstClass; }
     void clear();
@@ -90,11 +122,13 @@ public:
     void to(RepresentationType type); // Change representation type of base classifier
     RepresentationType getType();
     void pruneWeights(Real threshold);
+    // Renumbers features of the weights to featuresMap[index], features mapped to index <= 0 are dropped
+    void reindexWeights(const std::vector<int>& featuresMap, size_t newSize);
     void setFirstClass(int first);
     void setLoss(LossType);
 
-    void save(std::ofstream& out, bool saveGrads=false);
-    void load(std::ifstream& in, bool loadGrads=false, RepresentationType loadAs=map);
+    void save(std::ostream& out, bool saveGrads=false, const VectorCoding& coding=VectorCoding());
+    void load(std::istream& in, bool loadGrads=false, RepresentationType loadAs=map);
 
     Base* copy();
     Base* copyInverted();
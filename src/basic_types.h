@@ -59,6 +59,13 @@ typedef IVPair<int> IIVPair;
 
 typedef IRVPair Feature;
 
+// Non-zero element of a binary vector, its value is always 1
+struct IndexEntry{
+    int index;
+
+    bool operator<(const IndexEntry& r) const { return index < r.index; };
+};
+
 // TODO: Replace prediction with IRVPair
 //typedef IRVPair Prediction;
 
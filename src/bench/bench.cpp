@@ -0,0 +1,390 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+// Microbenchmarks of napkinXC hot paths, results are printed as JSON.
+// Usage: nxc_bench [--filter <substring>] [--minTime <seconds>] [--output <file>] [--compare <baseline.json>]
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "args.h"
+#include "base.h"
+#include "basic_types.h"
+#include "generate_data.h"
+#include "kmeans.h"
+#include "label_tree.h"
+#include "log.h"
+#include "matrix.h"
+#include "plt.h"
+#include "read_data.h"
+#include "vector.h"
+#include "version.h"
+
+
+struct BenchResult {
+    std::string name;
+    long long iterations; // Per repetition
+    double nsPerOp; // Median of the repetitions
+    double minNsPerOp;
+    double maxNsPerOp;
+};
+
+// Prevents the compiler from removing the benchmarked code
+static volatile Real sink;
+
+class Bench {
+public:
+    std::string filter;
+    double minTime = 0.2;
+    int repetitions = 5;
+    std::vector<BenchResult> results;
+
+    // Runs op with doubled number of iterations until it takes minTime, then measures the repetitions
+    void run(const std::string& name, const std::function<void(long long)>& op, long long opsPerIteration = 1) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+        long long iterations = 1;
+        while (time(op, iterations) < minTime && iterations < (1LL << 40)) iterations *= 2;
+
+        std::vector<double> ns;
+        for (int i = 0; i < repetitions; ++i)
+            ns.push_back(time(op, iterations) * 1e9 / (iterations * opsPerIteration));
+        std::sort(ns.begin(), ns.end());
+
+        results.push_back({name, iterations, ns[ns.size() / 2], ns.front(), ns.back()});
+        std::cerr << std::left << std::setw(40) << name << std::right << std::setw(14) << std::fixed
+                  << std::setprecision(1) << ns[ns.size() / 2] << " ns/op\n";
+    }
+
+private:
+    static double time(const std::function<void(long long)>& op, long long iterations) {
+        auto start = std::chrono::steady_clock::now();
+        op(iterations);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+void saveJson(std::ostream& out, std::vector<BenchResult>& results) {
+    // One benchmark per line, so results files are easy to diff and to read back with --compare
+    out << "{\n  \"version\": \"" << VERSION << "\",\n  \"benchmarks\": [\n" << std::setprecision(6);
+    for (int i = 0; i < results.size(); ++i) {
+        auto& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << r.nsPerOp
+            << ", \"min_ns_per_op\": " << r.minNsPerOp << ", \"max_ns_per_op\": " << r.maxNsPerOp << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void compare(std::string infile, std::vector<BenchResult>& results) {
+    std::ifstream in(infile);
+    if (!in.good()) throw std::invalid_argument("Cannot open baseline file " + infile);
+
+    std::unordered_map<std::string, double> baseline;
+    std::regex entry("\"name\": \"([^\"]+)\".*\"ns_per_op\": ([0-9.e+-]+)");
+    std::string line;
+    std::smatch m;
+    while (std::getline(in, line))
+        if (std::regex_search(line, m, entry)) baseline[m[1]] = std::stod(m[2]);
+
+    std::cerr << "\nComparison with " << infile << " (time ratio, > 1 is slower):\n";
+    for (auto& r : results) {
+        auto b = baseline.find(r.name);
+        if (b == baseline.end()) continue;
+        std::cerr << std::left << std::setw(40) << r.name << std::right << std::setw(14) << std::fixed
+                  << std::setprecision(3) << r.nsPerOp / b->second << "\n";
+    }
+}
+
+// Synthetic data
+
+SparseVector randomSparseVector(std::mt19937& rng, int size, int nonZero) {
+    std::uniform_int_distribution<int> index(2, size - 1);
+    std::normal_distribution<Real> value(0, 1);
+    UnorderedMap<int, Real> values;
+    while (values.size() < nonZero) values[index(rng)] = value(rng);
+
+    std::vector<IRVPair> vec;
+    for (auto& v : values) vec.emplace_back(v.first, v.second);
+    std::sort(vec.begin(), vec.end(), IRVPairIndexComp());
+    return SparseVector(vec);
+}
+
+AbstractVector* randomWeights(std::mt19937& rng, RepresentationType type, int size, int nonZero) {
+    AbstractVector* W;
+    if (type == dense) W = new Vector(size);
+    else if (type == sparse) W = new SparseVector();
+    else W = new MapVector(size, nonZero);
+
+    SparseVector values = randomSparseVector(rng, size, nonZero);
+    if (type != dense) W->reserve(nonZero);
+    for (auto& f : values) W->insertD(f.index, f.value);
+    if (type == sparse) static_cast<SparseVector*>(W)->sort();
+    return W;
+}
+
+std::string randomLibSvmLine(std::mt19937& rng, int labels, int features, int nonZero) {
+    std::uniform_int_distribution<int> label(0, labels - 1);
+    std::ostringstream line;
+    line << label(rng) << "," << label(rng) << "," << label(rng);
+    for (auto& f : randomSparseVector(rng, features, nonZero)) line << " " << f.index << ":" << std::abs(f.value);
+    return line.str();
+}
+
+// Benchmarks
+
+void benchDot(Bench& bench, std::mt19937& rng) {
+    const int size = 100000;
+    const std::vector<std::pair<RepresentationType, std::string>> types = {{dense, "dense"}, {map, "map"}, {sparse, "sparse"}};
+    SparseVector query = randomSparseVector(rng, size, 100);
+
+    for (auto& t : types) {
+        AbstractVector* W = randomWeights(rng, t.first, size, size / 10);
+        bench.run("dot/" + t.second, [&](long long n) {
+            Real val = 0;
+            for (long long i = 0; i < n; ++i) val += W->dot(query);
+            sink = val;
+        });
+        delete W;
+    }
+}
+
+void benchReadLine(Bench& bench, std::mt19937& rng) {
+    std::vector<std::string> lines;
+    for (int i = 0; i < 100; ++i) lines.push_back(randomLibSvmLine(rng, 10000, 100000, 100));
+
+    std::vector<IRVPair> lLabels;
+    std::vector<IRVPair> lFeatures;
+    bench.run("readLine/100_features", [&](long long n) {
+        for (long long i = 0; i < n; ++i) {
+            lLabels.clear();
+            lFeatures.clear();
+            readLine(lines[i % lines.size()], lLabels, lFeatures);
+        }
+        sink = lFeatures.size();
+    });
+}
+
+void benchReadData(Bench& bench) {
+    // Same synthetic dataset in both formats
+    Args args;
+    args.seed = 0;
+    args.generateRows = 2000;
+    for (bool binary : {false, true}) {
+        std::string format = binary ? "binary" : "libsvm";
+        args.output = "nxc_bench_data." + format;
+        args.binaryData = binary;
+        generateData(args);
+
+        Args readArgs;
+        readArgs.input = args.output;
+        bench.run("readData/2000_rows/" + format, [&](long long n) {
+            for (long long i = 0; i < n; ++i) {
+                IRMatrix labels;
+                SRMatrix features;
+                readData(labels, features, readArgs);
+                sink = features.rows();
+            }
+        }, args.generateRows);
+        std::remove(args.output.c_str());
+    }
+}
+
+void benchTopKQueue(Bench& bench, std::mt19937& rng) {
+    const int values = 1000;
+    // Same values as in the PLT prediction
+    std::vector<TreeNodeValue> nodeValues;
+    std::uniform_real_distribution<Real> value(0, 1);
+    for (int i = 0; i < values; ++i) nodeValues.emplace_back(nullptr, value(rng));
+
+    for (int k : {0, 5}) {
+        bench.run("TopKQueue/push_pop_1000/k=" + std::to_string(k), [&](long long n) {
+            Real val = 0;
+            for (long long i = 0; i < n; ++i) {
+                TopKQueue<TreeNodeValue> queue(k);
+                for (int j = 0; j < values; ++j) queue.push(nodeValues[j], j % 2);
+                while (!queue.empty()) {
+                    val += queue.top().value;
+                    queue.pop();
+                }
+            }
+            sink = val;
+        }, values);
+    }
+}
+
+void benchKmeans(Bench& bench, std::mt19937& rng) {
+    SRMatrix points;
+    for (int i = 0; i < 2000; ++i) {
+        SparseVector point = randomSparseVector(rng, 10000, 50);
+        std::vector<IRVPair> vec(point.begin(), point.end());
+        unitNorm(vec.begin(), vec.end());
+        points.appendRow(vec);
+    }
+
+    std::vector<Assignation> partition(points.rows());
+    for (int i = 0; i < points.rows(); ++i) partition[i].index = i;
+
+    for (int centroids : {2, 16}) {
+        bench.run("kmeans/2000_points/centroids=" + std::to_string(centroids), [&](long long n) {
+            for (long long i = 0; i < n; ++i) kmeans(&partition, points, centroids, 0.0001, true, 0);
+            sink = partition[0].value;
+        });
+    }
+}
+
+void benchSaveLoad(Bench& bench, std::mt19937& rng) {
+    const int size = 100000;
+    const std::vector<std::pair<RepresentationType, std::string>> types = {{dense, "dense"}, {sparse, "sparse"}};
+
+    for (auto& t : types) {
+        Base base;
+        SparseVector weights = randomSparseVector(rng, size, t.first == dense ? size / 2 : size / 100);
+        std::vector<int> indices;
+        std::vector<Real> values;
+        for (auto& f : weights) {
+            indices.push_back(f.index);
+            values.push_back(f.value);
+        }
+        base.setWeights(indices.data(), values.data(), indices.size(), t.first);
+
+        bench.run("Base::save/" + t.second, [&](long long n) {
+            for (long long i = 0; i < n; ++i) {
+                std::ostringstream out;
+                base.save(out);
+                sink = out.tellp();
+            }
+        });
+
+        std::ostringstream out;
+        base.save(out);
+        std::string saved = out.str();
+        bench.run("Base::load/" + t.second, [&](long long n) {
+            for (long long i = 0; i < n; ++i) {
+                std::istringstream in(saved);
+                Base loaded;
+                loaded.load(in, false, t.first);
+                sink = loaded.mem();
+            }
+        });
+    }
+}
+
+void benchPLTPredict(Bench& bench, std::mt19937& rng) {
+    const int features = 100000;
+
+    for (int labels : {1000, 100000}) {
+        Args args;
+        args.arity = 2;
+        args.topK = 5;
+        args.seed = 0;
+
+        // Complete binary tree with random sparse weights in the nodes, random biases make some paths
+        // much more probable than the others as in a trained model
+        std::normal_distribution<Real> bias(0, 2);
+        BatchPLT plt;
+        auto tree = new LabelTree();
+        tree->buildCompleteTree(labels, true, args);
+        plt.setTree(tree);
+        auto& bases = plt.getBases();
+        for (int i = 0; i < tree->nodes.size(); ++i) {
+            auto base = new Base();
+            SparseVector weights = randomSparseVector(rng, features, 100);
+            std::vector<int> indices = {1};
+            std::vector<Real> values = {bias(rng)};
+            for (auto& f : weights) {
+                indices.push_back(f.index);
+                values.push_back(f.value);
+            }
+            base->setWeights(indices.data(), values.data(), indices.size(), sparse);
+            bases.push_back(base);
+        }
+
+        std::vector<SparseVector> queries;
+        for (int i = 0; i < 100; ++i) {
+            SparseVector query = randomSparseVector(rng, features, 100);
+            std::vector<IRVPair> vec(query.begin(), query.end());
+            vec.insert(vec.begin(), IRVPair(1, 1.0)); // Bias feature
+            queries.emplace_back(vec);
+        }
+
+        std::vector<Prediction> prediction;
+        bench.run("PLT::predict/labels=" + std::to_string(labels) + "/top5", [&](long long n) {
+            for (long long i = 0; i < n; ++i) {
+                prediction.clear();
+                plt.predict(prediction, queries[i % queries.size()], args);
+            }
+            sink = prediction.size();
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    logLevel = NONE;
+
+    Bench bench;
+    std::string output;
+    std::string baseline;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+        if (arg == "--filter") bench.filter = argv[++i];
+        else if (arg == "--minTime") bench.minTime = std::stod(argv[++i]);
+        else if (arg == "--output") output = argv[++i];
+        else if (arg == "--compare") baseline = argv[++i];
+        else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::mt19937 rng(0);
+    benchDot(bench, rng);
+    benchReadLine(bench, rng);
+    benchReadData(bench);
+    benchTopKQueue(bench, rng);
+    benchKmeans(bench, rng);
+    benchSaveLoad(bench, rng);
+    benchPLTPredict(bench, rng);
+
+    if (output.empty()) saveJson(std::cout, bench.results);
+    else {
+        std::ofstream out(output);
+        saveJson(out, bench.results);
+    }
+    if (!baseline.empty()) compare(baseline, bench.results);
+
+    return EXIT_SUCCESS;
+}
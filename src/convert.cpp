@@ -0,0 +1,208 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+#include "convert.h"
+#include "log.h"
+#include "misc.h"
+#include "model.h"
+#include "model_archive.h"
+#include "read_data.h"
+
+// Renumbers features by the number of bases that use them, the bias feature keeps its index
+// and the features not used by any base are dropped, returns the new index of each current feature
+static std::vector<int> reindexModelFeatures(std::vector<Base*>& bases, size_t& newSize) {
+    size_t size = 2;
+    for (auto b : bases)
+        if (b->getW() != nullptr) size = std::max(size, b->getW()->size());
+
+    std::vector<std::pair<int, int>> counts(size);
+    for (int i = 0; i < counts.size(); ++i) counts[i] = {0, i};
+    for (auto b : bases)
+        if (b->getW() != nullptr)
+            b->getW()->forEachIV([&](const int& i, Real& v) {
+                if (v != 0) ++counts[i].first;
+            });
+
+    std::stable_sort(counts.begin() + 2, counts.end(), [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+        return a.first > b.first;
+    });
+
+    std::vector<int> featuresMap(size, -1);
+    featuresMap[1] = 1;
+    int newIndex = 2;
+    for (int i = 2; i < counts.size() && counts[i].first > 0; ++i) featuresMap[counts[i].second] = newIndex++;
+    newSize = newIndex;
+
+    for (auto b : bases) b->reindexWeights(featuresMap, newSize);
+    return featuresMap;
+}
+
+static unsigned long long pathSize(const std::string& path) {
+    if (std::filesystem::is_regular_file(path)) return std::filesystem::file_size(path);
+    unsigned long long size = 0;
+    for (const auto& f : std::filesystem::recursive_directory_iterator(path))
+        if (f.is_regular_file()) size += f.file_size();
+    return size;
+}
+
+static void verifyConversion(Args& args, const std::string& modelDir, Args& cArgs, const std::string& cModelDir) {
+    Log(CERR) << "Verifying predictions of the converted model ...\n";
+    std::shared_ptr<Model> model = Model::factory(args);
+    model->load(args, modelDir);
+    std::shared_ptr<Model> cModel = Model::factory(cArgs);
+    cModel->load(cArgs, cModelDir);
+
+    // Features of the converted model may be renumbered, so the data is read with the args of each model
+    IRMatrix labels, cLabels;
+    SRMatrix features, cFeatures;
+    readData(labels, features, args);
+    readData(cLabels, cFeatures, cArgs);
+
+    int rows = std::min(args.verifyRows, features.rows());
+    Real maxDiff = 0;
+    int top1Agreement = 0;
+    std::vector<Prediction> prediction, cPrediction;
+    for (int r = 0; r < rows; ++r) {
+        prediction.clear();
+        cPrediction.clear();
+        model->predict(prediction, features[r], args);
+        cModel->predict(cPrediction, cFeatures[r], cArgs);
+
+        // Compare probabilities of labels predicted by any of the models
+        for (const auto& p : prediction)
+            maxDiff = std::max(maxDiff, std::fabs(p.value - cModel->predictForLabel(p.label, cFeatures[r], cArgs)));
+        for (const auto& p : cPrediction)
+            maxDiff = std::max(maxDiff, std::fabs(p.value - model->predictForLabel(p.label, features[r], args)));
+
+        if (prediction.empty() == cPrediction.empty()
+            && (prediction.empty() || prediction.front().label == cPrediction.front().label))
+            ++top1Agreement;
+    }
+
+    Log(COUT) << "Verification on " << rows << " data points:"
+              << "\n  Max absolute difference of probabilities: " << maxDiff
+              << "\n  Top-1 agreement: " << (rows ? static_cast<double>(top1Agreement) / rows : 1.0) << "\n";
+    if (maxDiff > args.tolerance)
+        throw std::runtime_error("Predictions of the converted model differ by " + std::to_string(maxDiff)
+                                 + ", more than the tolerance " + std::to_string(args.tolerance));
+}
+
+void convertModel(Args& args) {
+    if (args.convertOutput.empty()) throw std::invalid_argument("Empty convert output path, set --convertOutput");
+    if (std::filesystem::exists(args.convertOutput) && std::filesystem::equivalent(args.output, args.convertOutput))
+        throw std::invalid_argument("Convert output path has to be different from the model path");
+
+    // Source model can be also an archive
+    std::unique_ptr<ModelArchive> archive;
+    std::string modelDir = args.output;
+    if (ModelArchive::isArchive(modelDir)) {
+        archive = std::make_unique<ModelArchive>(modelDir);
+        modelDir = archive->getDir();
+    }
+
+    args.loadFromFile(joinPath(modelDir, "args.bin"));
+    args.printArgs("convert");
+    if (args.ensemble > 1) throw std::invalid_argument("Converting ensembles is not supported");
+
+    // Weights are loaded as sparse, so pruning and reindexing do not allocate dense vectors
+    Args cArgs = args;
+    cArgs.loadAs = sparse;
+    std::shared_ptr<Model> model = Model::factory(cArgs);
+    model->load(cArgs, modelDir);
+    auto& bases = model->getBases();
+    if (bases.empty()) throw std::invalid_argument("Model has no base classifiers to convert");
+
+    if (args.pruneThreshold > 0) {
+        Log(CERR) << "Pruning weights with threshold " << args.pruneThreshold << " ...\n";
+        for (auto b : bases) b->pruneWeights(args.pruneThreshold);
+    }
+
+    if (args.reindexModel) {
+        Log(CERR) << "Reindexing features used by the model ...\n";
+        size_t newSize;
+        auto modelMap = reindexModelFeatures(bases, newSize);
+
+        // Compose with the map of the already reindexed model
+        auto featuresMap = std::make_shared<std::vector<int>>(modelMap);
+        if (args.featuresMap) {
+            *featuresMap = *args.featuresMap;
+            for (auto& i : *featuresMap) i = (i > 0 && i < modelMap.size()) ? modelMap[i] : -1;
+        }
+        cArgs.reindexFeatures = true;
+        cArgs.featuresMap = featuresMap;
+        cArgs.featuresSize = static_cast<int>(newSize);
+        Log(CERR) << "  Features: " << newSize - 2 << "\n";
+    }
+
+    // Other files of the model are copied as they are, OPLT auxiliary weights are only used to resume training
+    std::string outDir = args.archive ? args.convertOutput + ".tmp" : args.convertOutput;
+    makeDir(outDir);
+    if (archive) archive->unpack(outDir);
+    else
+        for (const auto& f : std::filesystem::directory_iterator(modelDir))
+            if (f.is_regular_file())
+                std::filesystem::copy_file(f.path(), joinPath(outDir, f.path().filename().string()),
+                                           std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::remove(joinPath(outDir, "aux_weights.bin"));
+
+    VectorCoding coding;
+    coding.sparse = args.saveAs == "auto" ? -1 : args.saveAs == "sparse";
+    coding.quantizeBits = args.quantize;
+    coding.compressIndices = args.compress;
+
+    Log(CERR) << "Saving converted model ...\n";
+    cArgs.saveToFile(joinPath(outDir, "args.bin"));
+    Model::saveBases(joinPath(outDir, "weights.bin"), bases, false, coding);
+    model.reset();
+
+    if (args.archive) {
+        std::ofstream out(args.convertOutput, std::ios::out | std::ios::binary);
+        ModelArchive::pack(outDir, out);
+        out.close();
+        std::filesystem::remove_all(outDir);
+    }
+
+    Log(COUT) << "Model size (MB): " << static_cast<double>(pathSize(args.output)) / 1024 / 1024
+              << " -> " << static_cast<double>(pathSize(args.convertOutput)) / 1024 / 1024
+              << "\nConverted model saved to " << args.convertOutput << "\n";
+
+    if (args.input.empty() || args.verifyRows <= 0) {
+        Log(CERR) << "Warning: No input data, predictions of the converted model are not verified!\n";
+        return;
+    }
+
+    // Converted model is loaded with the args from the command line, like by the test command
+    std::unique_ptr<ModelArchive> cArchive;
+    std::string cModelDir = args.convertOutput;
+    if (args.archive) {
+        cArchive = std::make_unique<ModelArchive>(cModelDir);
+        cModelDir = cArchive->getDir();
+    }
+    Args vArgs = args;
+    vArgs.loadFromFile(joinPath(cModelDir, "args.bin"));
+    verifyConversion(args, modelDir, vArgs, cModelDir);
+}
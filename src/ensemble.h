@@ -42,7 +42,7 @@ public:
     Ensemble();
     ~Ensemble() override;
 
-    void train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
+    void train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
     void predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) override;
     Real predictForLabel(Label label, SparseVector& features, Args& args) override;
     std::vector<std::vector<Prediction>> predictBatch(SRMatrix& features, Args& args) override;
@@ -71,14 +71,16 @@ template <typename T> Ensemble<T>::~Ensemble() {
 }
 
 template <typename T>
-void Ensemble<T>::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
+void Ensemble<T>::train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
     Log(CERR) << "Training ensemble of " << args.ensemble << " models ...\n";
 
     for (int i = 0; i < args.ensemble; ++i) {
         std::string memberDir = joinPath(output, "member_" + std::to_string(i));
         makeDir(memberDir);
         T* member = new T();
-        member->train(labels, features, args, memberDir);
+        Args memberArgs = args;
+        if (!args.warmStart.empty()) memberArgs.warmStart = joinPath(args.warmStart, "member_" + std::to_string(i));
+        member->train(labels, features, memberArgs, memberDir);
         delete member;
     }
 }
@@ -0,0 +1,212 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "generate_data.h"
+#include "basic_types.h"
+#include "log.h"
+#include "misc.h"
+#include "read_data.h"
+
+// Deterministic feature of the vocabulary of the label or the cluster, vocabularies don't need to be stored
+static inline int vocabularyFeature(uint64_t seed, uint64_t owner, uint64_t position, int features) {
+    // SplitMix64 finalizer
+    uint64_t x = seed ^ (owner * 0x9E3779B97F4A7C15ULL) ^ (position * 0xBF58476D1CE4E5B9ULL);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x = x ^ (x >> 31);
+    return static_cast<int>(x % features);
+}
+
+// Draws are computed from the raw output of mt19937_64, that is the same on every platform,
+// the distributions of the standard library are implementation-defined and would give different data for the same seed
+
+// Uniform real number from [0, 1)
+static inline double drawUniform(std::mt19937_64& rng) {
+    return static_cast<double>(rng() >> 11) * 0x1.0p-53;
+}
+
+// Uniform integer from [0, n)
+static inline int drawIndex(std::mt19937_64& rng, int n) {
+    return static_cast<int>(rng() % static_cast<uint64_t>(n));
+}
+
+// Index drawn proportionally to the weights, by inverse CDF over their cumulative sums
+static std::vector<double> cumulativeWeights(const std::vector<double>& weights) {
+    std::vector<double> cumulative(weights.size());
+    std::partial_sum(weights.begin(), weights.end(), cumulative.begin());
+    return cumulative;
+}
+
+static inline int drawIndex(std::mt19937_64& rng, const std::vector<double>& cumulative) {
+    auto it = std::upper_bound(cumulative.begin(), cumulative.end(), drawUniform(rng) * cumulative.back());
+    return static_cast<int>(std::min<size_t>(it - cumulative.begin(), cumulative.size() - 1));
+}
+
+// Poisson by multiplying uniforms (Knuth), the mean is split into parts so exp(-mean) doesn't underflow
+static int drawPoisson(std::mt19937_64& rng, double mean) {
+    int count = 0;
+    for (; mean > 0; mean -= 500) {
+        double limit = std::exp(-std::min(mean, 500.0));
+        double p = drawUniform(rng);
+        for (; p > limit; p *= drawUniform(rng)) ++count;
+    }
+    return count;
+}
+
+// Fisher-Yates shuffle
+static void shuffle(std::vector<int>& v, std::mt19937_64& rng) {
+    for (int i = static_cast<int>(v.size()) - 1; i > 0; --i) std::swap(v[i], v[drawIndex(rng, i + 1)]);
+}
+
+static void writeRow(std::ostream& out, std::vector<IRVPair>& lLabels, std::vector<IRVPair>& lFeatures, bool binary) {
+    if (binary) writeBinaryDataRow(out, lLabels, lFeatures);
+    else {
+        for (int i = 0; i < lLabels.size(); ++i) out << (i ? "," : "") << lLabels[i].index;
+        for (auto& f : lFeatures) out << " " << f.index << ":" << f.value;
+        out << "\n";
+    }
+}
+
+static std::ofstream openOutput(std::string outfile, int rows, int features, int labels, bool binary) {
+    std::ofstream out(outfile, std::ios::out | std::ios::binary);
+    if (!out.good()) throw std::invalid_argument("Cannot open output file: " + outfile);
+    if (binary) writeBinaryDataHeader(out, rows, features, labels);
+    else out << rows << " " << features << " " << labels << "\n";
+    return out;
+}
+
+void generateData(Args& args) {
+    const int rows = args.generateRows;
+    const int testRows = args.testOutput.empty() ? 0 : args.testRows;
+    const int features = args.generateFeatures;
+    const int labels = args.generateLabels;
+    if (rows <= 0 || features <= 0 || labels <= 0)
+        throw std::invalid_argument("Number of rows, features and labels to generate must be positive");
+    const int clusters = std::min(labels, args.latentClusters > 0 ? args.latentClusters :
+                                          std::max(1, static_cast<int>(std::sqrt(labels))));
+    const int labelVocabulary = std::max(1, 10 * args.featuresPerRow); // Features per label
+    const int clusterVocabulary = std::max(1, 20 * args.featuresPerRow); // Features per cluster
+    const Real inClusterLabels = 0.9; // Fraction of the labels drawn from the data point's cluster
+    const Real clusterFeatures = 0.5; // Fraction of not noise features drawn from the cluster vocabulary
+
+    Log(CERR) << "Generating " << rows << " data points with " << features << " features and " << labels
+              << " labels in " << clusters << " latent clusters ...\n";
+
+    std::mt19937_64 rng(args.seed);
+
+    // The most frequent labels get random ids
+    std::vector<int> labelIds(labels);
+    std::iota(labelIds.begin(), labelIds.end(), 0);
+    shuffle(labelIds, rng);
+
+    std::vector<double> labelWeights(labels);
+    for (int l = 0; l < labels; ++l) labelWeights[l] = 1.0 / std::pow(l + 1, args.labelsPowerLaw);
+    std::vector<double> labelDist = cumulativeWeights(labelWeights);
+
+    // Labels are assigned to clusters at random, so every cluster has a head and a tail
+    std::vector<std::vector<int>> clusterLabels(clusters);
+    std::vector<std::vector<double>> clusterLabelWeights(clusters);
+    std::vector<double> clusterWeights(clusters, 0);
+    for (int l = 0; l < labels; ++l) {
+        int c = l < clusters ? l : drawIndex(rng, clusters); // Each cluster has at least one label
+        clusterLabels[c].push_back(l);
+        clusterLabelWeights[c].push_back(labelWeights[l]);
+        clusterWeights[c] += labelWeights[l];
+    }
+    std::vector<double> clusterDist = cumulativeWeights(clusterWeights);
+    std::vector<std::vector<double>> clusterLabelDists;
+    for (int c = 0; c < clusters; ++c) clusterLabelDists.push_back(cumulativeWeights(clusterLabelWeights[c]));
+
+    std::vector<double> featureWeights(features);
+    for (int f = 0; f < features; ++f) featureWeights[f] = 1.0 / (f + 1);
+    std::vector<double> noiseFeatureDist = cumulativeWeights(featureWeights);
+
+    const double labelsCountMean = std::max<double>(args.labelsPerRow - 1, 0);
+    const double featuresCountMean = std::max(args.featuresPerRow - 1, 0);
+
+    std::ofstream out = openOutput(args.output, rows, features, labels, args.binaryData);
+    std::ofstream testOut;
+    if (testRows > 0) testOut = openOutput(args.testOutput, testRows, features, labels, args.binaryData);
+
+    std::vector<int> rowLabels;
+    UnorderedMap<int, int> counts;
+    std::vector<IRVPair> lLabels;
+    std::vector<IRVPair> lFeatures;
+    for (int r = 0; r < rows + testRows; ++r) {
+        printProgress(r, rows + testRows);
+        int c = drawIndex(rng, clusterDist);
+
+        // Labels, at least one
+        rowLabels.clear();
+        int count = std::min(labels, 1 + drawPoisson(rng, labelsCountMean));
+        for (int attempts = 0; rowLabels.size() < count && attempts < 10 * count; ++attempts) {
+            int l = drawUniform(rng) < inClusterLabels ? clusterLabels[c][drawIndex(rng, clusterLabelDists[c])]
+                                                      : drawIndex(rng, labelDist);
+            if (std::find(rowLabels.begin(), rowLabels.end(), l) == rowLabels.end()) rowLabels.push_back(l);
+        }
+
+        // Features, repeated ones get higher values like term frequencies
+        counts.clear();
+        int nonZero = 1 + drawPoisson(rng, featuresCountMean);
+        for (int i = 0; i < nonZero; ++i) {
+            double u = drawUniform(rng);
+            int f;
+            if (u < args.featuresNoise) f = drawIndex(rng, noiseFeatureDist);
+            else if (u < args.featuresNoise + (1 - args.featuresNoise) * clusterFeatures)
+                f = vocabularyFeature(args.seed, labels + c, drawIndex(rng, clusterVocabulary), features);
+            else {
+                int l = rowLabels[drawIndex(rng, static_cast<int>(rowLabels.size()))];
+                f = vocabularyFeature(args.seed, l, drawIndex(rng, labelVocabulary), features);
+            }
+            ++counts[f];
+        }
+
+        lLabels.clear();
+        for (auto l : rowLabels) lLabels.emplace_back(labelIds[l], 1);
+        std::sort(lLabels.begin(), lLabels.end(), IRVPairIndexComp());
+
+        lFeatures.clear();
+        for (auto& f : counts) {
+            // Rounded, so the values are the same in both formats
+            double value = std::round((1 + std::log(static_cast<double>(f.second))) * 1e4) / 1e4;
+            lFeatures.emplace_back(f.first, value);
+        }
+        std::sort(lFeatures.begin(), lFeatures.end(), IRVPairIndexComp());
+
+        // Test data points come from the same clusters and vocabularies as the train ones
+        writeRow(r < rows ? out : testOut, lLabels, lFeatures, args.binaryData);
+    }
+
+    out.close();
+    Log(CERR) << "  Saved to: " << args.output << "\n";
+    if (testRows > 0) {
+        testOut.close();
+        Log(CERR) << "  Saved test data to: " << args.testOutput << "\n";
+    }
+}
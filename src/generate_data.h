@@ -0,0 +1,34 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include "args.h"
+
+// Generates synthetic extreme classification dataset and saves it to args.output (and test split to args.testOutput),
+// in the binary format if args.binaryData is set, in the libsvm format otherwise.
+//
+// Labels frequencies follow the power law and labels are grouped into latent clusters.
+// Each data point belongs to one cluster and most of its labels are drawn from it.
+// Its features are drawn from the vocabularies of its labels and cluster, the rest is Zipf distributed noise,
+// so the features are informative about the labels and similar labels share the features.
+void generateData(Args& args);
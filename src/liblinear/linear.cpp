@@ -1,11 +1,14 @@
 #include "linear.h"
 #include "tron.h"
+#include "threads.h"
 #include <locale.h>
 #include <math.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <vector>
 int liblinear_version = LIBLINEAR_VERSION;
 typedef signed char schar;
 template <class T> static inline void swap(T& x, T& y) { T t=x; x=y; y=t; }
@@ -23,6 +26,66 @@ template <class S, class T> static inline void clone(T*& dst, S* src, int n)
 #define INF HUGE_VAL
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type))
 
+// Scratch memory reused between train_liblinear calls, everything allocated from it is released by reset_workspace
+struct workspace
+{
+	char *data;
+	size_t size;
+	size_t used;
+	size_t needed; // bytes requested since the last reset
+	std::vector<char *> overflow; // blocks allocated when data was too small
+};
+
+workspace *create_workspace()
+{
+	workspace *ws = new workspace;
+	ws->data = NULL;
+	ws->size = ws->used = ws->needed = 0;
+	return ws;
+}
+
+void destroy_workspace(workspace *ws)
+{
+	if(ws == NULL)
+		return;
+	for(size_t i = 0; i < ws->overflow.size(); i++)
+		free(ws->overflow[i]);
+	free(ws->data);
+	delete ws;
+}
+
+// Uninitialized memory for n elements, valid until the next reset
+template <class T> static T *ws_alloc(workspace *ws, size_t n)
+{
+	size_t bytes = (n*sizeof(T) + 15) & ~(size_t)15;
+	ws->needed += bytes;
+	if(ws->used + bytes <= ws->size)
+	{
+		T *ptr = (T *)(ws->data + ws->used);
+		ws->used += bytes;
+		return ptr;
+	}
+	char *block = Malloc(char, bytes);
+	ws->overflow.push_back(block);
+	return (T *)block;
+}
+
+static void reset_workspace(workspace *ws)
+{
+	for(size_t i = 0; i < ws->overflow.size(); i++)
+		free(ws->overflow[i]);
+	ws->overflow.clear();
+
+	// Grow the main block, so everything requested by the last call fits into it next time
+	if(ws->needed > ws->size)
+	{
+		free(ws->data);
+		ws->data = Malloc(char, ws->needed);
+		ws->size = ws->needed;
+	}
+	ws->used = ws->needed = 0;
+}
+
 static void print_string_stdout(const char *s)
 {
 	fputs(s,stdout);
@@ -45,33 +108,59 @@ static void info(const char *fmt,...)
 #else
 static void info(const char *fmt,...) {}
 #endif
+// Loops are unrolled with independent accumulators to break the dependency chain of additions,
+// the sentinel of the next element is checked only if the previous one is valid, so reads never go past the end of a row
 class sparse_operator
 {
 public:
 	static float nrm2_sq(const feature_node *x)
 	{
-		float ret = 0;
+		float ret0 = 0, ret1 = 0, ret2 = 0, ret3 = 0;
+		while(x[0].index != -1 && x[1].index != -1 && x[2].index != -1 && x[3].index != -1)
+		{
+			ret0 += x[0].value*x[0].value;
+			ret1 += x[1].value*x[1].value;
+			ret2 += x[2].value*x[2].value;
+			ret3 += x[3].value*x[3].value;
+			x += 4;
+		}
 		while(x->index != -1)
 		{
-			ret += x->value*x->value;
+			ret0 += x->value*x->value;
 			x++;
 		}
-		return (ret);
+		return (ret0 + ret1) + (ret2 + ret3);
 	}
 
 	static float dot(const float *s, const feature_node *x)
 	{
-		float ret = 0;
+		float ret0 = 0, ret1 = 0, ret2 = 0, ret3 = 0;
+		while(x[0].index != -1 && x[1].index != -1 && x[2].index != -1 && x[3].index != -1)
+		{
+			ret0 += s[x[0].index-1]*x[0].value;
+			ret1 += s[x[1].index-1]*x[1].value;
+			ret2 += s[x[2].index-1]*x[2].value;
+			ret3 += s[x[3].index-1]*x[3].value;
+			x += 4;
+		}
 		while(x->index != -1)
 		{
-			ret += s[x->index-1]*x->value;
+			ret0 += s[x->index-1]*x->value;
 			x++;
 		}
-		return (ret);
+		return (ret0 + ret1) + (ret2 + ret3);
 	}
 
 	static void axpy(const float a, const feature_node *x, float *y)
 	{
+		while(x[0].index != -1 && x[1].index != -1 && x[2].index != -1 && x[3].index != -1)
+		{
+			y[x[0].index-1] += a*x[0].value;
+			y[x[1].index-1] += a*x[1].value;
+			y[x[2].index-1] += a*x[2].value;
+			y[x[3].index-1] += a*x[3].value;
+			x += 4;
+		}
 		while(x->index != -1)
 		{
 			y[x->index-1] += a*x->value;
@@ -80,10 +169,69 @@ public:
 	}
 };
 
+// Runs func(thread_id, start, stop) for the range [0, n) split between nr_thread threads
+template<typename F> static void parallel_for(int nr_thread, int n, F func)
+{
+	if(nr_thread <= 1)
+	{
+		func(0, 0, n);
+		return;
+	}
+
+	ThreadSet tSet;
+	int chunk = (n + nr_thread - 1) / nr_thread;
+	for(int t = 0; t < nr_thread; t++)
+		tSet.add(func, t, min(t * chunk, n), min((t + 1) * chunk, n));
+	tSet.joinAll();
+}
+
+// Per-thread buffers for X^T v like products computed in parallel over rows
+class thread_buffers
+{
+public:
+	thread_buffers(int nr_thread, int size)
+	{
+		this->nr_thread = nr_thread;
+		this->size = size;
+		buf = new float*[nr_thread];
+		for(int t = 0; t < nr_thread; t++)
+			buf[t] = new float[size];
+	}
+
+	~thread_buffers()
+	{
+		for(int t = 0; t < nr_thread; t++)
+			delete[] buf[t];
+		delete[] buf;
+	}
+
+	float *get(int t) { return buf[t]; }
+
+	// Sums up the buffers into out
+	void reduce(float *out)
+	{
+		parallel_for(nr_thread, size, [&](int t, int start, int stop)
+		{
+			for(int j = start; j < stop; j++)
+			{
+				float sum = 0;
+				for(int k = 0; k < nr_thread; k++)
+					sum += buf[k][j];
+				out[j] = sum;
+			}
+		});
+	}
+
+private:
+	int nr_thread;
+	int size;
+	float **buf;
+};
+
 class l2r_lr_fun: public function
 {
 public:
-	l2r_lr_fun(const problem *prob, float *C);
+	l2r_lr_fun(const problem *prob, float *C, workspace *ws, int nr_thread = 1);
 	~l2r_lr_fun();
 
 	float fun(float *w);
@@ -101,23 +249,28 @@ private:
 	float *z;
 	float *D;
 	const problem *prob;
+	int nr_thread;
+	thread_buffers *bufs;
 };
 
-l2r_lr_fun::l2r_lr_fun(const problem *prob, float *C)
+l2r_lr_fun::l2r_lr_fun(const problem *prob, float *C, workspace *ws, int nr_thread)
 {
 	int l=prob->l;
 
 	this->prob = prob;
 
-	z = new float[l];
-	D = new float[l];
+	z = ws_alloc<float>(ws, l);
+	D = ws_alloc<float>(ws, l);
 	this->C = C;
+	this->nr_thread = max(1, min(nr_thread, l));
+	bufs = NULL;
+	if(this->nr_thread > 1)
+		bufs = new thread_buffers(this->nr_thread, get_nr_variable());
 }
 
 l2r_lr_fun::~l2r_lr_fun()
 {
-	delete[] z;
-	delete[] D;
+	delete bufs;
 }
 
 
@@ -134,14 +287,24 @@ float l2r_lr_fun::fun(float *w)
 	for(i=0;i<w_size;i++)
 		f += w[i]*w[i];
 	f /= 2.0;
-	for(i=0;i<l;i++)
+
+	float *f_thread = new float[nr_thread];
+	parallel_for(nr_thread, l, [&](int t, int start, int stop)
 	{
-		float yz = y[i]*z[i];
-		if (yz >= 0)
-			f += C[i]*log(1 + exp(-yz));
-		else
-			f += C[i]*(-yz+log(1 + exp(yz)));
-	}
+		float f_part = 0;
+		for(int i=start;i<stop;i++)
+		{
+			float yz = y[i]*z[i];
+			if (yz >= 0)
+				f_part += C[i]*log(1 + exp(-yz));
+			else
+				f_part += C[i]*(-yz+log(1 + exp(yz)));
+		}
+		f_thread[t] = f_part;
+	});
+	for(i=0;i<nr_thread;i++)
+		f += f_thread[i];
+	delete[] f_thread;
 
 	return(f);
 }
@@ -153,12 +316,15 @@ void l2r_lr_fun::grad(float *w, float *g)
 	int l=prob->l;
 	int w_size=get_nr_variable();
 
-	for(i=0;i<l;i++)
+	parallel_for(nr_thread, l, [&](int t, int start, int stop)
 	{
-		z[i] = 1/(1 + exp(-y[i]*z[i]));
-		D[i] = z[i]*(1-z[i]);
-		z[i] = C[i]*(z[i]-1)*y[i];
-	}
+		for(int i=start;i<stop;i++)
+		{
+			z[i] = 1/(1 + exp(-y[i]*z[i]));
+			D[i] = z[i]*(1-z[i]);
+			z[i] = C[i]*(z[i]-1)*y[i];
+		}
+	});
 	XTv(z, g);
 
 	for(i=0;i<w_size;i++)
@@ -198,6 +364,27 @@ void l2r_lr_fun::Hv(float *s, float *Hs)
 	int w_size=get_nr_variable();
 	feature_node **x=prob->x;
 
+	if(nr_thread > 1)
+	{
+		// Each thread accumulates its rows in own buffer, then the buffers are summed up
+		parallel_for(nr_thread, l, [&](int t, int start, int stop)
+		{
+			float *Hs_thread = bufs->get(t);
+			for(int j=0;j<w_size;j++)
+				Hs_thread[j] = 0;
+			for(int i=start;i<stop;i++)
+			{
+				feature_node * const xi=x[i];
+				float xTs = C[i]*D[i]*sparse_operator::dot(s, xi);
+				sparse_operator::axpy(xTs, xi, Hs_thread);
+			}
+		});
+		bufs->reduce(Hs);
+		for(i=0;i<w_size;i++)
+			Hs[i] = s[i] + Hs[i];
+		return;
+	}
+
 	for(i=0;i<w_size;i++)
 		Hs[i] = 0;
 	for(i=0;i<l;i++)
@@ -215,12 +402,14 @@ void l2r_lr_fun::Hv(float *s, float *Hs)
 
 void l2r_lr_fun::Xv(float *v, float *Xv)
 {
-	int i;
 	int l=prob->l;
 	feature_node **x=prob->x;
 
-	for(i=0;i<l;i++)
-		Xv[i]=sparse_operator::dot(v, x[i]);
+	parallel_for(nr_thread, l, [&](int t, int start, int stop)
+	{
+		for(int i=start;i<stop;i++)
+			Xv[i]=sparse_operator::dot(v, x[i]);
+	});
 }
 
 void l2r_lr_fun::XTv(float *v, float *XTv)
@@ -230,6 +419,20 @@ void l2r_lr_fun::XTv(float *v, float *XTv)
 	int w_size=get_nr_variable();
 	feature_node **x=prob->x;
 
+	if(nr_thread > 1)
+	{
+		parallel_for(nr_thread, l, [&](int t, int start, int stop)
+		{
+			float *XTv_thread = bufs->get(t);
+			for(int j=0;j<w_size;j++)
+				XTv_thread[j] = 0;
+			for(int i=start;i<stop;i++)
+				sparse_operator::axpy(v[i], x[i], XTv_thread);
+		});
+		bufs->reduce(XTv);
+		return;
+	}
+
 	for(i=0;i<w_size;i++)
 		XTv[i]=0;
 	for(i=0;i<l;i++)
@@ -239,7 +442,7 @@ void l2r_lr_fun::XTv(float *v, float *XTv)
 class l2r_l2_svc_fun: public function
 {
 public:
-	l2r_l2_svc_fun(const problem *prob, float *C);
+	l2r_l2_svc_fun(const problem *prob, float *C, workspace *ws, int nr_thread = 1);
 	~l2r_l2_svc_fun();
 
 	float fun(float *w);
@@ -258,23 +461,28 @@ protected:
 	int *I;
 	int sizeI;
 	const problem *prob;
+	int nr_thread;
+	thread_buffers *bufs;
 };
 
-l2r_l2_svc_fun::l2r_l2_svc_fun(const problem *prob, float *C)
+l2r_l2_svc_fun::l2r_l2_svc_fun(const problem *prob, float *C, workspace *ws, int nr_thread)
 {
 	int l=prob->l;
 
 	this->prob = prob;
 
-	z = new float[l];
-	I = new int[l];
+	z = ws_alloc<float>(ws, l);
+	I = ws_alloc<int>(ws, l);
 	this->C = C;
+	this->nr_thread = max(1, min(nr_thread, l));
+	bufs = NULL;
+	if(this->nr_thread > 1)
+		bufs = new thread_buffers(this->nr_thread, get_nr_variable());
 }
 
 l2r_l2_svc_fun::~l2r_l2_svc_fun()
 {
-	delete[] z;
-	delete[] I;
+	delete bufs;
 }
 
 float l2r_l2_svc_fun::fun(float *w)
@@ -290,13 +498,23 @@ float l2r_l2_svc_fun::fun(float *w)
 	for(i=0;i<w_size;i++)
 		f += w[i]*w[i];
 	f /= 2.0;
-	for(i=0;i<l;i++)
+
+	float *f_thread = new float[nr_thread];
+	parallel_for(nr_thread, l, [&](int t, int start, int stop)
 	{
-		z[i] = y[i]*z[i];
-		float d = 1-z[i];
-		if (d > 0)
-			f += C[i]*d*d;
-	}
+		float f_part = 0;
+		for(int i=start;i<stop;i++)
+		{
+			z[i] = y[i]*z[i];
+			float d = 1-z[i];
+			if (d > 0)
+				f_part += C[i]*d*d;
+		}
+		f_thread[t] = f_part;
+	});
+	for(i=0;i<nr_thread;i++)
+		f += f_thread[i];
+	delete[] f_thread;
 
 	return(f);
 }
@@ -354,6 +572,26 @@ void l2r_l2_svc_fun::Hv(float *s, float *Hs)
 	int w_size=get_nr_variable();
 	feature_node **x=prob->x;
 
+	if(nr_thread > 1)
+	{
+		parallel_for(nr_thread, sizeI, [&](int t, int start, int stop)
+		{
+			float *Hs_thread = bufs->get(t);
+			for(int j=0;j<w_size;j++)
+				Hs_thread[j] = 0;
+			for(int i=start;i<stop;i++)
+			{
+				feature_node * const xi=x[I[i]];
+				float xTs = C[I[i]]*sparse_operator::dot(s, xi);
+				sparse_operator::axpy(xTs, xi, Hs_thread);
+			}
+		});
+		bufs->reduce(Hs);
+		for(i=0;i<w_size;i++)
+			Hs[i] = s[i] + 2*Hs[i];
+		return;
+	}
+
 	for(i=0;i<w_size;i++)
 		Hs[i]=0;
 	for(i=0;i<sizeI;i++)
@@ -371,12 +609,14 @@ void l2r_l2_svc_fun::Hv(float *s, float *Hs)
 
 void l2r_l2_svc_fun::Xv(float *v, float *Xv)
 {
-	int i;
 	int l=prob->l;
 	feature_node **x=prob->x;
 
-	for(i=0;i<l;i++)
-		Xv[i]=sparse_operator::dot(v, x[i]);
+	parallel_for(nr_thread, l, [&](int t, int start, int stop)
+	{
+		for(int i=start;i<stop;i++)
+			Xv[i]=sparse_operator::dot(v, x[i]);
+	});
 }
 
 void l2r_l2_svc_fun::subXTv(float *v, float *XTv)
@@ -385,6 +625,20 @@ void l2r_l2_svc_fun::subXTv(float *v, float *XTv)
 	int w_size=get_nr_variable();
 	feature_node **x=prob->x;
 
+	if(nr_thread > 1)
+	{
+		parallel_for(nr_thread, sizeI, [&](int t, int start, int stop)
+		{
+			float *XTv_thread = bufs->get(t);
+			for(int j=0;j<w_size;j++)
+				XTv_thread[j] = 0;
+			for(int i=start;i<stop;i++)
+				sparse_operator::axpy(v[i], x[I[i]], XTv_thread);
+		});
+		bufs->reduce(XTv);
+		return;
+	}
+
 	for(i=0;i<w_size;i++)
 		XTv[i]=0;
 	for(i=0;i<sizeI;i++)
@@ -394,7 +648,7 @@ void l2r_l2_svc_fun::subXTv(float *v, float *XTv)
 class l2r_l2_svr_fun: public l2r_l2_svc_fun
 {
 public:
-	l2r_l2_svr_fun(const problem *prob, float *C, float p);
+	l2r_l2_svr_fun(const problem *prob, float *C, float p, workspace *ws);
 
 	float fun(float *w);
 	void grad(float *w, float *g);
@@ -403,8 +657,8 @@ private:
 	float p;
 };
 
-l2r_l2_svr_fun::l2r_l2_svr_fun(const problem *prob, float *C, float p):
-	l2r_l2_svc_fun(prob, C)
+l2r_l2_svr_fun::l2r_l2_svr_fun(const problem *prob, float *C, float p, workspace *ws):
+	l2r_l2_svc_fun(prob, C, ws)
 {
 	this->p = p;
 }
@@ -819,16 +1073,16 @@ void Solver_MCSVM_CS::Solve(float *w)
 
 static void solve_l2r_l1l2_svc(
 	const problem *prob, float *w, float eps,
-	float Cp, float Cn, int solver_type, int max_iter)
+	float Cp, float Cn, int solver_type, int max_iter, bool warm_start, workspace *ws)
 {
 	int l = prob->l;
 	int w_size = prob->n;
 	int i, s, iter = 0;
 	float C, d, G;
-	float *QD = new float[l];
-	int *index = new int[l];
-	float *alpha = new float[l];
-	schar *y = new schar[l];
+	float *QD = ws_alloc<float>(ws, l);
+	int *index = ws_alloc<int>(ws, l);
+	float *alpha = ws_alloc<float>(ws, l);
+	schar *y = ws_alloc<schar>(ws, l);
 	int active_size = l;
 
 	// PG: projected gradient, for shrinking and stopping
@@ -838,9 +1092,9 @@ static void solve_l2r_l1l2_svc(
 	float PGmax_new, PGmin_new;
 
 	// default solver_type: L2R_L2LOSS_SVC_DUAL
-	float *diag = new float[l];
-	float *upper_bound = new float[l];
-	float *C_ = new float[l];
+	float *diag = ws_alloc<float>(ws, l);
+	float *upper_bound = ws_alloc<float>(ws, l);
+	float *C_ = ws_alloc<float>(ws, l);
 	for(i=0; i<l; i++)
 	{
 		if(prob->y[i]>0)
@@ -874,8 +1128,19 @@ static void solve_l2r_l1l2_svc(
 	// Initial alpha can be set here. Note that
 	// 0 <= alpha[i] <= upper_bound[GETI(i)]
 	for(i=0; i<l; i++)
+	{
 		alpha[i] = 0;
 
+		// Approximate alpha of the given w from the optimality conditions:
+		// alpha[i] = (1 - yi w^T xi) / diag[i] for L2-loss, upper bound for L1-loss if the margin is violated
+		if(warm_start)
+		{
+			float loss = 1 - y[i]*sparse_operator::dot(w, prob->x[i]);
+			if(loss > 0)
+				alpha[i] = diag[GETI(i)] > 0 ? loss/diag[GETI(i)] : upper_bound[GETI(i)];
+		}
+	}
+
 	for(i=0; i<w_size; i++)
 		w[i] = 0;
 	for(i=0; i<l; i++)
@@ -995,13 +1260,6 @@ static void solve_l2r_l1l2_svc(
 	info("Objective value = %lf\n",v/2);
 	info("nSV = %d\n",nSV);
 
-	delete [] upper_bound;
-	delete [] diag;
-	delete [] C_;
-	delete [] QD;
-	delete [] alpha;
-	delete [] y;
-	delete [] index;
 }
 
 
@@ -1035,7 +1293,7 @@ static void solve_l2r_l1l2_svc(
 
 static void solve_l2r_l1l2_svr(
 	const problem *prob, float *w, const parameter *param,
-	int solver_type)
+	int solver_type, workspace *ws)
 {
 	int l = prob->l;
 	float C = param->C;
@@ -1045,20 +1303,20 @@ static void solve_l2r_l1l2_svr(
 	int i, s, iter = 0;
 	int max_iter = param->max_iter;
 	int active_size = l;
-	int *index = new int[l];
+	int *index = ws_alloc<int>(ws, l);
 
 	float d, G, H;
 	float Gmax_old = INF;
 	float Gmax_new, Gnorm1_new;
 	float Gnorm1_init = -1.0f; // Gnorm1_init is initialized at the first iteration
-	float *beta = new float[l];
-	float *QD = new float[l];
+	float *beta = ws_alloc<float>(ws, l);
+	float *QD = ws_alloc<float>(ws, l);
 	float *y = prob->y;
 
 	// L2R_L2LOSS_SVR_DUAL
-	float *lambda = new float[l];
-	float *upper_bound = new float[l];
-	float *C_ = new float[l];
+	float *lambda = ws_alloc<float>(ws, l);
+	float *upper_bound = ws_alloc<float>(ws, l);
+	float *C_ = ws_alloc<float>(ws, l);
 	for (i=0; i<l; i++)
 	{
 		C_[i] = prob->W[i] * C;
@@ -1220,12 +1478,6 @@ static void solve_l2r_l1l2_svr(
 	info("Objective value = %lf\n", v);
 	info("nSV = %d\n",nSV);
 
-	delete [] upper_bound;
-	delete [] lambda;
-	delete [] C_;
-	delete [] beta;
-	delete [] QD;
-	delete [] index;
 }
 
 
@@ -1251,19 +1503,19 @@ static void solve_l2r_l1l2_svr(
 #define GETI(i) (i)
 // To support weights for instances, use GETI(i) (i)
 
-void solve_l2r_lr_dual(const problem *prob, float *w, float eps, float Cp, float Cn, int max_iter)
+void solve_l2r_lr_dual(const problem *prob, float *w, float eps, float Cp, float Cn, int max_iter, bool warm_start, workspace *ws)
 {
 	int l = prob->l;
 	int w_size = prob->n;
 	int i, s, iter = 0;
-	float *xTx = new float[l];
-	int *index = new int[l];
-	float *alpha = new float[2*l]; // store alpha and C - alpha
-	schar *y = new schar[l];
+	float *xTx = ws_alloc<float>(ws, l);
+	int *index = ws_alloc<int>(ws, l);
+	float *alpha = ws_alloc<float>(ws, 2*l); // store alpha and C - alpha
+	schar *y = ws_alloc<schar>(ws, l);
 	int max_inner_iter = 100; // for inner Newton
 	float innereps = 1e-2;
 	float innereps_min = min(1e-8f, eps);
-	float *upper_bound = new float [l];
+	float *upper_bound = ws_alloc<float>(ws, l);
 
 	for(i=0; i<l; i++)
 	{
@@ -1284,7 +1536,16 @@ void solve_l2r_lr_dual(const problem *prob, float *w, float eps, float Cp, float
 	// alpha[2*i] + alpha[2*i+1] = upper_bound[GETI(i)]
 	for(i=0; i<l; i++)
 	{
-		alpha[2*i] = min(0.001f*upper_bound[GETI(i)], 1e-8f);
+		float alpha_min = min(0.001f*upper_bound[GETI(i)], 1e-8f);
+		alpha[2*i] = alpha_min;
+
+		// Approximate alpha of the given w from the optimality condition alpha[i] = C / (1 + exp(yi w^T xi))
+		if(warm_start)
+		{
+			float ywTx = y[i]*sparse_operator::dot(w, prob->x[i]);
+			alpha[2*i] = upper_bound[GETI(i)]/(1 + exp(ywTx));
+			alpha[2*i] = min(max(alpha[2*i], alpha_min), upper_bound[GETI(i)] - alpha_min);
+		}
 		alpha[2*i+1] = upper_bound[GETI(i)] - alpha[2*i];
 	}
 
@@ -1387,11 +1648,25 @@ void solve_l2r_lr_dual(const problem *prob, float *w, float eps, float Cp, float
 			- upper_bound[GETI(i)] * log(upper_bound[GETI(i)]);
 	info("Objective value = %lf\n", v);
 
-	delete [] upper_bound;
-	delete [] xTx;
-	delete [] alpha;
-	delete [] y;
-	delete [] index;
+}
+
+// Columns used by L1 solvers are either the problem's own transposition (row_map == NULL)
+// or shared columns of all rows, then row_map gives the problem's row of each entry or -1 if it is not part of it
+static inline int col_row(const feature_node *x, const int *row_map)
+{
+	return row_map ? row_map[x->index-1] : x->index-1;
+}
+
+// b += a * y .* x for the column x, y can be NULL
+static void col_axpy(float a, const feature_node *x, float *b, const schar *y, const int *row_map)
+{
+	for(; x->index != -1; x++)
+	{
+		int ind = col_row(x, row_map);
+		if(ind < 0)
+			continue;
+		b[ind] += y ? a*y[ind]*x->value : a*x->value;
+	}
 }
 
 // A coordinate descent algorithm for
@@ -1412,8 +1687,8 @@ void solve_l2r_lr_dual(const problem *prob, float *w, float eps, float Cp, float
 // To support weights for instances, use GETI(i) (i)
 
 static void solve_l1r_l2_svc(
-	problem *prob_col, float *w, float eps,
-	float Cp, float Cn, int max_iter)
+	const problem *prob_col, const int *row_map, float *w, float eps,
+	float Cp, float Cn, int max_iter, workspace *ws)
 {
 	int l = prob_col->l;
 	int w_size = prob_col->n;
@@ -1430,17 +1705,13 @@ static void solve_l1r_l2_svc(
 	float loss_old = 0, loss_new;
 	float appxcond, cond;
 
-	int *index = new int[w_size];
-	schar *y = new schar[l];
-	float *b = new float[l]; // b = 1-ywTx
-	float *xj_sq = new float[w_size];
+	int *index = ws_alloc<int>(ws, w_size);
+	schar *y = ws_alloc<schar>(ws, l);
+	float *b = ws_alloc<float>(ws, l); // b = 1-ywTx
+	float *xj_sq = ws_alloc<float>(ws, w_size);
 	feature_node *x;
 
-	float *C = new float[l];
-
-	// Initial w can be set here.
-	for(j=0; j<w_size; j++)
-		w[j] = 0;
+	float *C = ws_alloc<float>(ws, l);
 
 	for(j=0; j<l; j++)
 	{
@@ -1460,15 +1731,35 @@ static void solve_l1r_l2_svc(
 	{
 		index[j] = j;
 		xj_sq[j] = 0;
-		x = prob_col->x[j];
-		while(x->index != -1)
+		for(x = prob_col->x[j]; x->index != -1; x++)
 		{
-			int ind = x->index-1;
-			x->value *= y[ind]; // x->value stores yi*xij
-			float val = x->value;
+			int ind = col_row(x, row_map);
+			if(ind < 0)
+				continue;
+			float val = y[ind]*x->value;
 			b[ind] -= w[j]*val;
 			xj_sq[j] += C[GETI(ind)]*val*val;
-			x++;
+		}
+	}
+
+	// Starting from the given w, the stopping condition is relative to the gradient at w = 0 as in TRON
+	for(j=0; j<w_size; j++)
+		if(w[j] != 0)
+			break;
+	if(j < w_size)
+	{
+		Gnorm1_init = 0;
+		for(j=0; j<w_size; j++)
+		{
+			float G0 = 0;
+			for(x = prob_col->x[j]; x->index != -1; x++)
+			{
+				int ind = col_row(x, row_map);
+				if(ind < 0)
+					continue;
+				G0 -= 2*C[GETI(ind)]*y[ind]*x->value;
+			}
+			Gnorm1_init += max(fabs(G0)-1, 0.0f);
 		}
 	}
 
@@ -1489,18 +1780,18 @@ static void solve_l1r_l2_svc(
 			G_loss = 0;
 			H = 0;
 
-			x = prob_col->x[j];
-			while(x->index != -1)
+			for(x = prob_col->x[j]; x->index != -1; x++)
 			{
-				int ind = x->index-1;
+				int ind = col_row(x, row_map);
+				if(ind < 0)
+					continue;
 				if(b[ind] > 0)
 				{
-					float val = x->value;
+					float val = y[ind]*x->value;
 					float tmp = C[GETI(ind)]*val;
 					G_loss -= tmp*b[ind];
 					H += tmp*val;
 				}
-				x++;
 			}
 			G_loss *= 2;
 
@@ -1555,8 +1846,7 @@ static void solve_l1r_l2_svc(
 				appxcond = xj_sq[j]*d*d + G_loss*d + cond;
 				if(appxcond <= 0)
 				{
-					x = prob_col->x[j];
-					sparse_operator::axpy(d_diff, x, b);
+					col_axpy(d_diff, prob_col->x[j], b, y, row_map);
 					break;
 				}
 
@@ -1564,31 +1854,31 @@ static void solve_l1r_l2_svc(
 				{
 					loss_old = 0;
 					loss_new = 0;
-					x = prob_col->x[j];
-					while(x->index != -1)
+					for(x = prob_col->x[j]; x->index != -1; x++)
 					{
-						int ind = x->index-1;
+						int ind = col_row(x, row_map);
+						if(ind < 0)
+							continue;
 						if(b[ind] > 0)
 							loss_old += C[GETI(ind)]*b[ind]*b[ind];
-						float b_new = b[ind] + d_diff*x->value;
+						float b_new = b[ind] + d_diff*y[ind]*x->value;
 						b[ind] = b_new;
 						if(b_new > 0)
 							loss_new += C[GETI(ind)]*b_new*b_new;
-						x++;
 					}
 				}
 				else
 				{
 					loss_new = 0;
-					x = prob_col->x[j];
-					while(x->index != -1)
+					for(x = prob_col->x[j]; x->index != -1; x++)
 					{
-						int ind = x->index-1;
-						float b_new = b[ind] + d_diff*x->value;
+						int ind = col_row(x, row_map);
+						if(ind < 0)
+							continue;
+						float b_new = b[ind] + d_diff*y[ind]*x->value;
 						b[ind] = b_new;
 						if(b_new > 0)
 							loss_new += C[GETI(ind)]*b_new*b_new;
-						x++;
 					}
 				}
 
@@ -1615,13 +1905,12 @@ static void solve_l1r_l2_svc(
 				for(int i=0; i<w_size; i++)
 				{
 					if(w[i]==0) continue;
-					x = prob_col->x[i];
-					sparse_operator::axpy(-w[i], x, b);
+					col_axpy(-w[i], prob_col->x[i], b, y, row_map);
 				}
 			}
 		}
 
-		if(iter == 0)
+		if(Gnorm1_init < 0)
 			Gnorm1_init = Gnorm1_new;
 		iter++;
 		if(iter % 10 == 0)
@@ -1652,19 +1941,11 @@ static void solve_l1r_l2_svc(
 	float v = 0;
 	int nnz = 0;
 	for(j=0; j<w_size; j++)
-	{
-		x = prob_col->x[j];
-		while(x->index != -1)
-		{
-			x->value *= prob_col->y[x->index-1]; // restore x->value
-			x++;
-		}
 		if(w[j] != 0)
 		{
 			v += fabs(w[j]);
 			nnz++;
 		}
-	}
 	for(j=0; j<l; j++)
 		if(b[j] > 0)
 			v += C[GETI(j)]*b[j]*b[j];
@@ -1672,11 +1953,6 @@ static void solve_l1r_l2_svc(
 	info("Objective value = %lf\n", v);
 	info("#nonzeros/#features = %d/%d\n", nnz, w_size);
 
-	delete [] C;
-	delete [] index;
-	delete [] y;
-	delete [] b;
-	delete [] xj_sq;
 }
 
 // A coordinate descent algorithm for
@@ -1697,8 +1973,8 @@ static void solve_l1r_l2_svc(
 // To support weights for instances, use GETI(i) (i)
 
 static void solve_l1r_lr(
-	const problem *prob_col, float *w, float eps,
-	float Cp, float Cn, int max_iter)
+	const problem *prob_col, const int *row_map, float *w, float eps,
+	float Cp, float Cn, int max_iter, workspace *ws)
 {
 	int l = prob_col->l;
 	int w_size = prob_col->n;
@@ -1720,24 +1996,20 @@ static void solve_l1r_lr(
 	float QP_Gmax_new, QP_Gnorm1_new;
 	float delta, negsum_xTd, cond;
 
-	int *index = new int[w_size];
-	schar *y = new schar[l];
-	float *Hdiag = new float[w_size];
-	float *Grad = new float[w_size];
-	float *wpd = new float[w_size];
-	float *xjneg_sum = new float[w_size];
-	float *xTd = new float[l];
-	float *exp_wTx = new float[l];
-	float *exp_wTx_new = new float[l];
-	float *tau = new float[l];
-	float *D = new float[l];
+	int *index = ws_alloc<int>(ws, w_size);
+	schar *y = ws_alloc<schar>(ws, l);
+	float *Hdiag = ws_alloc<float>(ws, w_size);
+	float *Grad = ws_alloc<float>(ws, w_size);
+	float *wpd = ws_alloc<float>(ws, w_size);
+	float *xjneg_sum = ws_alloc<float>(ws, w_size);
+	float *xTd = ws_alloc<float>(ws, l);
+	float *exp_wTx = ws_alloc<float>(ws, l);
+	float *exp_wTx_new = ws_alloc<float>(ws, l);
+	float *tau = ws_alloc<float>(ws, l);
+	float *D = ws_alloc<float>(ws, l);
 	feature_node *x;
 
-	float *C = new float[l];
-
-	// Initial w can be set here.
-	for(j=0; j<w_size; j++)
-		w[j] = 0;
+	float *C = ws_alloc<float>(ws, l);
 
 	for(j=0; j<l; j++)
 	{
@@ -1762,15 +2034,15 @@ static void solve_l1r_lr(
 		wpd[j] = w[j];
 		index[j] = j;
 		xjneg_sum[j] = 0;
-		x = prob_col->x[j];
-		while(x->index != -1)
+		for(x = prob_col->x[j]; x->index != -1; x++)
 		{
-			int ind = x->index-1;
+			int ind = col_row(x, row_map);
+			if(ind < 0)
+				continue;
 			float val = x->value;
 			exp_wTx[ind] += w[j]*val;
 			if(y[ind] == -1)
 				xjneg_sum[j] += C[GETI(ind)]*val;
-			x++;
 		}
 	}
 	for(j=0; j<l; j++)
@@ -1781,6 +2053,24 @@ static void solve_l1r_lr(
 		D[j] = C[GETI(j)]*exp_wTx[j]*tau_tmp*tau_tmp;
 	}
 
+	// Starting from the given w, the stopping condition is relative to the gradient at w = 0 as in TRON
+	if(w_norm > 0)
+	{
+		Gnorm1_init = 0;
+		for(j=0; j<w_size; j++)
+		{
+			float G0 = xjneg_sum[j];
+			for(x = prob_col->x[j]; x->index != -1; x++)
+			{
+				int ind = col_row(x, row_map);
+				if(ind < 0)
+					continue;
+				G0 -= 0.5*C[GETI(ind)]*x->value;
+			}
+			Gnorm1_init += max(fabs(G0)-1, 0.0f);
+		}
+	}
+
 	while(newton_iter < max_newton_iter)
 	{
 		Gmax_new = 0;
@@ -1794,13 +2084,13 @@ static void solve_l1r_lr(
 			Grad[j] = 0;
 
 			float tmp = 0;
-			x = prob_col->x[j];
-			while(x->index != -1)
+			for(x = prob_col->x[j]; x->index != -1; x++)
 			{
-				int ind = x->index-1;
+				int ind = col_row(x, row_map);
+				if(ind < 0)
+					continue;
 				Hdiag[j] += x->value*x->value*D[ind];
 				tmp += x->value*tau[ind];
-				x++;
 			}
 			Grad[j] = -tmp + xjneg_sum[j];
 
@@ -1831,7 +2121,7 @@ static void solve_l1r_lr(
 			Gnorm1_new += violation;
 		}
 
-		if(newton_iter == 0)
+		if(Gnorm1_init < 0)
 			Gnorm1_init = Gnorm1_new;
 
 		if(Gnorm1_new <= eps*Gnorm1_init)
@@ -1861,13 +2151,13 @@ static void solve_l1r_lr(
 				j = index[s];
 				H = Hdiag[j];
 
-				x = prob_col->x[j];
 				G = Grad[j] + (wpd[j]-w[j])*nu;
-				while(x->index != -1)
+				for(x = prob_col->x[j]; x->index != -1; x++)
 				{
-					int ind = x->index-1;
+					int ind = col_row(x, row_map);
+					if(ind < 0)
+						continue;
 					G += x->value*D[ind]*xTd[ind];
-					x++;
 				}
 
 				float Gp = G+1;
@@ -1910,8 +2200,7 @@ static void solve_l1r_lr(
 
 				wpd[j] += z;
 
-				x = prob_col->x[j];
-				sparse_operator::axpy(z, x, xTd);
+				col_axpy(z, prob_col->x[j], xTd, NULL, row_map);
 			}
 
 			iter++;
@@ -2002,8 +2291,7 @@ static void solve_l1r_lr(
 			for(int i=0; i<w_size; i++)
 			{
 				if(w[i]==0) continue;
-				x = prob_col->x[i];
-				sparse_operator::axpy(w[i], x, exp_wTx);
+				col_axpy(w[i], prob_col->x[i], exp_wTx, NULL, row_map);
 			}
 
 			for(int i=0; i<l; i++)
@@ -2043,34 +2331,22 @@ static void solve_l1r_lr(
 	info("Objective value = %lf\n", v);
 	info("#nonzeros/#features = %d/%d\n", nnz, w_size);
 
-	delete [] C;
-	delete [] index;
-	delete [] y;
-	delete [] Hdiag;
-	delete [] Grad;
-	delete [] wpd;
-	delete [] xjneg_sum;
-	delete [] xTd;
-	delete [] exp_wTx;
-	delete [] exp_wTx_new;
-	delete [] tau;
-	delete [] D;
 }
 
 // transpose matrix X from row format to column format
-static void transpose(const problem *prob, feature_node **x_space_ret, problem *prob_col)
+static void transpose(const problem *prob, feature_node **x_space_ret, problem *prob_col, workspace *ws)
 {
 	int i;
 	int l = prob->l;
 	int n = prob->n;
 	size_t nnz = 0;
-	size_t *col_ptr = new size_t [n+1];
+	size_t *col_ptr = ws_alloc<size_t>(ws, n+1);
 	feature_node *x_space;
 	prob_col->l = l;
 	prob_col->n = n;
-	prob_col->y = new float[l];
-	prob_col->x = new feature_node*[n];
-	prob_col->W = new float[l];
+	prob_col->y = ws_alloc<float>(ws, l);
+	prob_col->x = ws_alloc<feature_node *>(ws, n);
+	prob_col->W = ws_alloc<float>(ws, l);
 
 	for(i=0; i<l; i++)
 	{
@@ -2093,7 +2369,7 @@ static void transpose(const problem *prob, feature_node **x_space_ret, problem *
 	for(i=1; i<n+1; i++)
 		col_ptr[i] += col_ptr[i-1] + 1;
 
-	x_space = new feature_node[nnz+n];
+	x_space = ws_alloc<feature_node>(ws, nnz+n);
 	for(i=0; i<n; i++)
 		prob_col->x[i] = &x_space[col_ptr[i]];
 
@@ -2114,19 +2390,112 @@ static void transpose(const problem *prob, feature_node **x_space_ret, problem *
 
 	*x_space_ret = x_space;
 
+}
+
+// Problem's columns taken from the shared columns of all rows, returns false if some of its rows are not there
+// or the same row is used more than once (e.g. with different labels), the columns can map it to only one row
+static bool shared_transpose(const problem *prob, const col_problem *cols, problem *prob_col, int **row_map_ret, workspace *ws)
+{
+	int l = prob->l;
+	if(prob->n > cols->n)
+		return false;
+
+	int *row_map = ws_alloc<int>(ws, cols->l);
+	for(int i=0; i<cols->l; i++)
+		row_map[i] = -1;
+	for(int i=0; i<l; i++)
+	{
+		feature_node **pos = std::lower_bound(cols->rows, cols->rows + cols->l, prob->x[i]);
+		if(pos == cols->rows + cols->l || *pos != prob->x[i] || row_map[pos - cols->rows] != -1)
+			return false;
+		row_map[pos - cols->rows] = i;
+	}
+
+	prob_col->l = l;
+	prob_col->n = prob->n;
+	prob_col->y = prob->y;
+	prob_col->W = prob->W;
+	prob_col->x = cols->x;
+	*row_map_ret = row_map;
+	return true;
+}
+
+static int compare_pointer(const void *a, const void *b)
+{
+	feature_node *pa = *(feature_node * const *)a;
+	feature_node *pb = *(feature_node * const *)b;
+	if(pa < pb)
+		return -1;
+	if(pa > pb)
+		return 1;
+	return 0;
+}
+
+col_problem *transpose_rows(feature_node **rows, int l, int n)
+{
+	col_problem *cols = new col_problem;
+	cols->l = l;
+	cols->n = n;
+	cols->rows = new feature_node*[l];
+	for(int i=0; i<l; i++)
+		cols->rows[i] = rows[i];
+	qsort(cols->rows, l, sizeof(feature_node *), compare_pointer);
+
+	size_t nnz = 0;
+	size_t *col_ptr = new size_t[n+1];
+	for(int i=0; i<n+1; i++)
+		col_ptr[i] = 0;
+	for(int i=0; i<l; i++)
+		for(feature_node *x = cols->rows[i]; x->index != -1; x++)
+			if(x->index <= n)
+			{
+				nnz++;
+				col_ptr[x->index]++;
+			}
+	for(int i=1; i<n+1; i++)
+		col_ptr[i] += col_ptr[i-1] + 1;
+
+	cols->x_space = new feature_node[nnz+n];
+	cols->x = new feature_node*[n];
+	for(int i=0; i<n; i++)
+		cols->x[i] = &cols->x_space[col_ptr[i]];
+
+	for(int i=0; i<l; i++)
+		for(feature_node *x = cols->rows[i]; x->index != -1; x++)
+			if(x->index <= n)
+			{
+				int ind = x->index-1;
+				cols->x_space[col_ptr[ind]].index = i+1;
+				cols->x_space[col_ptr[ind]].value = x->value;
+				col_ptr[ind]++;
+			}
+	for(int i=0; i<n; i++)
+		cols->x_space[col_ptr[i]].index = -1;
+
 	delete [] col_ptr;
+	return cols;
+}
+
+void free_col_problem(col_problem *cols)
+{
+	if(cols == NULL)
+		return;
+	delete [] cols->rows;
+	delete [] cols->x;
+	delete [] cols->x_space;
+	delete cols;
 }
 
 // label: label name, start: begin of each class, count: #data of classes, perm: indices to the original data
 // perm, length l, must be allocated before calling this subroutine
-static void group_classes(const problem *prob, int *nr_class_ret, int **label_ret, int **start_ret, int **count_ret, int *perm)
+static void group_classes(const problem *prob, int *nr_class_ret, int **label_ret, int **start_ret, int **count_ret, int *perm, workspace *ws)
 {
 	int l = prob->l;
 	int max_nr_class = 16;
 	int nr_class = 0;
 	int *label = Malloc(int,max_nr_class);
 	int *count = Malloc(int,max_nr_class);
-	int *data_label = Malloc(int,l);
+	int *data_label = ws_alloc<int>(ws, l);
 	int i;
 
 	for(i=0;i<l;i++)
@@ -2191,10 +2560,16 @@ static void group_classes(const problem *prob, int *nr_class_ret, int **label_re
 	*label_ret = label;
 	*start_ret = start;
 	*count_ret = count;
-	free(data_label);
 }
 
-static void train_one(const problem *prob, const parameter *param, float *w, float Cp, float Cn)
+// Scanning whole shared columns pays off only for problems covering a large part of all rows,
+// smaller ones are transposed, their copies are small anyway
+static bool use_shared_cols(const problem *prob, const parameter *param)
+{
+	return param->shared_cols != NULL && (size_t)prob->l * 4 >= (size_t)param->shared_cols->l;
+}
+
+static void train_one(const problem *prob, const parameter *param, float *w, float Cp, float Cn, workspace *ws)
 {
 	//inner and outer tolerances for TRON
 	float eps = param->eps;
@@ -2216,7 +2591,7 @@ static void train_one(const problem *prob, const parameter *param, float *w, flo
 	{
 		case L2R_LR:
 		{
-			float *C = new float[prob->l];
+			float *C = ws_alloc<float>(ws, prob->l);
 			for(int i = 0; i < prob->l; i++)
 			{
 				if(prob->y[i] > 0)
@@ -2224,17 +2599,16 @@ static void train_one(const problem *prob, const parameter *param, float *w, flo
 				else
 					C[i] = prob->W[i] * Cn;
 			}
-			fun_obj=new l2r_lr_fun(prob, C);
+			fun_obj=new l2r_lr_fun(prob, C, ws, param->nr_thread);
 			TRON tron_obj(fun_obj, primal_solver_tol, eps_cg);
 			tron_obj.set_print_string(liblinear_print_string);
 			tron_obj.tron(w);
 			delete fun_obj;
-			delete[] C;
 			break;
 		}
 		case L2R_L2LOSS_SVC:
 		{
-			float *C = new float[prob->l];
+			float *C = ws_alloc<float>(ws, prob->l);
 			for(int i = 0; i < prob->l; i++)
 			{
 				if(prob->y[i] > 0)
@@ -2242,67 +2616,61 @@ static void train_one(const problem *prob, const parameter *param, float *w, flo
 				else
 					C[i] = prob->W[i] * Cn;
 			}
-			fun_obj=new l2r_l2_svc_fun(prob, C);
+			fun_obj=new l2r_l2_svc_fun(prob, C, ws, param->nr_thread);
 			TRON tron_obj(fun_obj, primal_solver_tol, eps_cg);
 			tron_obj.set_print_string(liblinear_print_string);
 			tron_obj.tron(w);
 			delete fun_obj;
-			delete[] C;
 			break;
 		}
 		case L2R_L2LOSS_SVC_DUAL:
-			solve_l2r_l1l2_svc(prob, w, eps, Cp, Cn, L2R_L2LOSS_SVC_DUAL, max_iter);
+			solve_l2r_l1l2_svc(prob, w, eps, Cp, Cn, L2R_L2LOSS_SVC_DUAL, max_iter, param->init_sol != NULL, ws);
 			break;
 		case L2R_L1LOSS_SVC_DUAL:
-			solve_l2r_l1l2_svc(prob, w, eps, Cp, Cn, L2R_L1LOSS_SVC_DUAL, max_iter);
+			solve_l2r_l1l2_svc(prob, w, eps, Cp, Cn, L2R_L1LOSS_SVC_DUAL, max_iter, param->init_sol != NULL, ws);
 			break;
 		case L1R_L2LOSS_SVC:
 		{
 			problem prob_col;
 			feature_node *x_space = NULL;
-			transpose(prob, &x_space ,&prob_col);
-			solve_l1r_l2_svc(&prob_col, w, primal_solver_tol, Cp, Cn, max_iter);
-			delete [] prob_col.y;
-			delete [] prob_col.x;
-			delete [] prob_col.W;
-			delete [] x_space;
+			int *row_map = NULL;
+			if(!use_shared_cols(prob, param) || !shared_transpose(prob, param->shared_cols, &prob_col, &row_map, ws))
+				transpose(prob, &x_space ,&prob_col, ws);
+			solve_l1r_l2_svc(&prob_col, row_map, w, primal_solver_tol, Cp, Cn, max_iter, ws);
 			break;
 		}
 		case L1R_LR:
 		{
 			problem prob_col;
 			feature_node *x_space = NULL;
-			transpose(prob, &x_space ,&prob_col);
-			solve_l1r_lr(&prob_col, w, primal_solver_tol, Cp, Cn, max_iter);
-			delete [] prob_col.y;
-			delete [] prob_col.x;
-			delete [] prob_col.W;
-			delete [] x_space;
+			int *row_map = NULL;
+			if(!use_shared_cols(prob, param) || !shared_transpose(prob, param->shared_cols, &prob_col, &row_map, ws))
+				transpose(prob, &x_space ,&prob_col, ws);
+			solve_l1r_lr(&prob_col, row_map, w, primal_solver_tol, Cp, Cn, max_iter, ws);
 			break;
 		}
 		case L2R_LR_DUAL:
-			solve_l2r_lr_dual(prob, w, eps, Cp, Cn, max_iter);
+			solve_l2r_lr_dual(prob, w, eps, Cp, Cn, max_iter, param->init_sol != NULL, ws);
 			break;
 		case L2R_L2LOSS_SVR:
 		{
-			float *C = new float[prob->l];
+			float *C = ws_alloc<float>(ws, prob->l);
 			for(int i = 0; i < prob->l; i++)
 				C[i] = prob->W[i] * param->C;
 
-			fun_obj=new l2r_l2_svr_fun(prob, C, param->p);
+			fun_obj=new l2r_l2_svr_fun(prob, C, param->p, ws);
 			TRON tron_obj(fun_obj, param->eps);
 			tron_obj.set_print_string(liblinear_print_string);
 			tron_obj.tron(w);
 			delete fun_obj;
-			delete[] C;
 			break;
 
 		}
 		case L2R_L1LOSS_SVR_DUAL:
-			solve_l2r_l1l2_svr(prob, w, param, L2R_L1LOSS_SVR_DUAL);
+			solve_l2r_l1l2_svr(prob, w, param, L2R_L1LOSS_SVR_DUAL, ws);
 			break;
 		case L2R_L2LOSS_SVR_DUAL:
-			solve_l2r_l1l2_svr(prob, w, param, L2R_L2LOSS_SVR_DUAL);
+			solve_l2r_l1l2_svr(prob, w, param, L2R_L2LOSS_SVR_DUAL, ws);
 			break;
 		default:
 			fprintf(stderr, "ERROR: unknown solver_type\n");
@@ -2490,7 +2858,7 @@ static void find_parameter_C(const problem *prob, parameter *param_tmp, float st
 //
 // Remove zero weighed data as libsvm and some liblinear solvers require C > 0.
 //
-static void remove_zero_weight(problem *newprob, const problem *prob)
+static void remove_zero_weight(problem *newprob, const problem *prob, workspace *ws)
 {
 	int i;
 	int l = 0;
@@ -2498,9 +2866,9 @@ static void remove_zero_weight(problem *newprob, const problem *prob)
 		if(prob->W[i] > 0) l++;
 	*newprob = *prob;
 	newprob->l = l;
-	newprob->x = Malloc(feature_node*,l);
-	newprob->y = Malloc(float,l);
-	newprob->W = Malloc(float,l);
+	newprob->x = ws_alloc<feature_node *>(ws, l);
+	newprob->y = ws_alloc<float>(ws, l);
+	newprob->W = ws_alloc<float>(ws, l);
 
 	int j = 0;
 	for(i=0;i<prob->l;i++)
@@ -2516,10 +2884,23 @@ static void remove_zero_weight(problem *newprob, const problem *prob)
 //
 // Interface functions
 //
+// Solvers that start from the given w, dual ones only approximate their initial alpha with it if init_sol is set
+static bool uses_initial_w(int solver_type)
+{
+	return solver_type == L2R_LR || solver_type == L2R_L2LOSS_SVC || solver_type == L2R_L2LOSS_SVR ||
+		solver_type == L1R_LR || solver_type == L1R_L2LOSS_SVC;
+}
+
 model* train_liblinear(const problem *prob, const parameter *param)
 {
+	// Without a workspace from the caller use a temporary one
+	workspace *ws = param->ws;
+	if(ws == NULL)
+		ws = create_workspace();
+	reset_workspace(ws);
+
 	problem newprob;
-	remove_zero_weight(&newprob, prob);
+	remove_zero_weight(&newprob, prob, ws);
 	prob = &newprob;
 	int i,j;
 	int l = prob->l;
@@ -2536,18 +2917,18 @@ model* train_liblinear(const problem *prob, const parameter *param)
 
 	if(check_regression_model(model_))
 	{
-		model_->w = Malloc(float, w_size);
+		model_->w = param->ws ? ws_alloc<float>(ws, w_size) : Malloc(float, w_size);
 
 		if(param->init_sol != NULL)
 			for(i=0;i<w_size;i++)
 				model_->w[i] = param->init_sol[i];
-		else
+		else if(uses_initial_w(param->solver_type))
 			for(i=0;i<w_size;i++)
 				model_->w[i] = 0;
 
 		model_->nr_class = 2;
 		model_->label = NULL;
-		train_one(prob, param, model_->w, 0, 0);
+		train_one(prob, param, model_->w, 0, 0, ws);
 	}
 	else
 	{
@@ -2555,10 +2936,10 @@ model* train_liblinear(const problem *prob, const parameter *param)
 		int *label = NULL;
 		int *start = NULL;
 		int *count = NULL;
-		int *perm = Malloc(int,l);
+		int *perm = ws_alloc<int>(ws, l);
 
 		// group training data of the same class
-		group_classes(prob,&nr_class,&label,&start,&count,perm);
+		group_classes(prob,&nr_class,&label,&start,&count,perm,ws);
 
 		model_->nr_class=nr_class;
 		model_->label = Malloc(int,nr_class);
@@ -2566,7 +2947,7 @@ model* train_liblinear(const problem *prob, const parameter *param)
 			model_->label[i] = label[i];
 
 		// calculate weighted C
-		float *weighted_C = Malloc(float, nr_class);
+		float *weighted_C = ws_alloc<float>(ws, nr_class);
 		for(i=0;i<nr_class;i++)
 			weighted_C[i] = param->C;
 		for(i=0;i<param->nr_weight;i++)
@@ -2581,7 +2962,7 @@ model* train_liblinear(const problem *prob, const parameter *param)
 		}
 
 		// constructing the subproblem
-		feature_node **x = Malloc(feature_node *,l);
+		feature_node **x = ws_alloc<feature_node *>(ws, l);
 		for(i=0;i<l;i++)
 			x[i] = prob->x[perm[i]];
 
@@ -2589,9 +2970,9 @@ model* train_liblinear(const problem *prob, const parameter *param)
 		problem sub_prob;
 		sub_prob.l = l;
 		sub_prob.n = n;
-		sub_prob.x = Malloc(feature_node *,sub_prob.l);
-		sub_prob.y = Malloc(float,sub_prob.l);
-		sub_prob.W = Malloc(float,sub_prob.l);
+		sub_prob.x = ws_alloc<feature_node *>(ws, sub_prob.l);
+		sub_prob.y = ws_alloc<float>(ws, sub_prob.l);
+		sub_prob.W = ws_alloc<float>(ws, sub_prob.l);
 		for(k=0; k<sub_prob.l; k++){
 			sub_prob.x[k] = x[k];
 			sub_prob.W[k] = prob->W[perm[k]];
@@ -2600,7 +2981,7 @@ model* train_liblinear(const problem *prob, const parameter *param)
 		// multi-class svm by Crammer and Singer
 		if(param->solver_type == MCSVM_CS)
 		{
-			model_->w=Malloc(float, n*nr_class);
+			model_->w = param->ws ? ws_alloc<float>(ws, n*nr_class) : Malloc(float, n*nr_class);
 			for(i=0;i<nr_class;i++)
 				for(j=start[i];j<start[i]+count[i];j++)
 					sub_prob.y[j] = i;
@@ -2611,7 +2992,7 @@ model* train_liblinear(const problem *prob, const parameter *param)
 		{
 			if(nr_class == 2)
 			{
-				model_->w=Malloc(float, w_size);
+				model_->w = param->ws ? ws_alloc<float>(ws, w_size) : Malloc(float, w_size);
 
 				int e0 = start[0]+count[0];
 				k=0;
@@ -2623,16 +3004,16 @@ model* train_liblinear(const problem *prob, const parameter *param)
 				if(param->init_sol != NULL)
 					for(i=0;i<w_size;i++)
 						model_->w[i] = param->init_sol[i];
-				else
+				else if(uses_initial_w(param->solver_type))
 					for(i=0;i<w_size;i++)
 						model_->w[i] = 0;
 
-				train_one(&sub_prob, param, model_->w, weighted_C[0], weighted_C[1]);
+				train_one(&sub_prob, param, model_->w, weighted_C[0], weighted_C[1], ws);
 			}
 			else
 			{
-				model_->w=Malloc(float, w_size*nr_class);
-				float *w=Malloc(float, w_size);
+				model_->w = param->ws ? ws_alloc<float>(ws, w_size*nr_class) : Malloc(float, w_size*nr_class);
+				float *w = ws_alloc<float>(ws, w_size);
 				for(i=0;i<nr_class;i++)
 				{
 					int si = start[i];
@@ -2653,29 +3034,22 @@ model* train_liblinear(const problem *prob, const parameter *param)
 						for(j=0;j<w_size;j++)
 							w[j] = 0;
 
-					train_one(&sub_prob, param, w, weighted_C[i], param->C);
+					train_one(&sub_prob, param, w, weighted_C[i], param->C, ws);
 
 					for(j=0;j<w_size;j++)
 						model_->w[j*nr_class+i] = w[j];
 				}
-				free(w);
 			}
 
 		}
 
-		free(x);
 		free(label);
 		free(start);
 		free(count);
-		free(perm);
-		free(sub_prob.x);
-		free(sub_prob.y);
-		free(weighted_C);
-		free(sub_prob.W);
-		free(newprob.x);
-		free(newprob.y);
-		free(newprob.W);
 	}
+
+	if(param->ws == NULL)
+		destroy_workspace(ws);
 	return model_;
 }
 
@@ -3051,6 +3425,9 @@ struct model *load_model(const char *model_file_name)
 	param.weight_label = NULL;
 	param.weight = NULL;
 	param.init_sol = NULL;
+	param.nr_thread = 1;
+	param.ws = NULL;
+	param.shared_cols = NULL;
 
 	model_->label = NULL;
 
@@ -3210,7 +3587,8 @@ float get_decfun_bias(const struct model *model_, int label_idx)
 
 void free_model_content(struct model *model_ptr)
 {
-	if(model_ptr->w != NULL)
+	// Weights trained with a workspace are owned by it
+	if(model_ptr->w != NULL && model_ptr->param.ws == NULL)
 		free(model_ptr->w);
 	if(model_ptr->label != NULL)
 		free(model_ptr->label);
@@ -15,6 +15,16 @@ extern "C" {
 
 extern int liblinear_version;
 
+struct workspace;
+
+struct col_problem     /* columns of many rows shared between problems made of subsets of them */
+{
+	int l, n;
+	struct feature_node **rows;    /* rows sorted by address, index of a column's entry is a position here + 1 */
+	struct feature_node **x;
+	struct feature_node *x_space;
+};
+
 struct problem
 {
 	int l, n;
@@ -39,6 +49,11 @@ struct parameter
 	float p;
 	float *init_sol;
 	int max_iter;
+	int nr_thread;         /* threads used by L2R_LR and L2R_L2LOSS_SVC solvers */
+	struct workspace *ws;  /* scratch memory reused between calls, model's w is then owned by it
+	                          and valid until the next train_liblinear call with the same workspace */
+	const struct col_problem *shared_cols; /* used by L1R_LR and L1R_L2LOSS_SVC instead of transposing
+	                                          the problem, has to contain all of its rows, may be NULL */
 };
 
 struct model
@@ -52,6 +67,10 @@ struct model
 };
 
 struct model* train_liblinear(const struct problem *prob, const struct parameter *param);
+struct workspace* create_workspace();
+void destroy_workspace(struct workspace *ws);
+struct col_problem* transpose_rows(struct feature_node **rows, int l, int n);
+void free_col_problem(struct col_problem *cols);
 void cross_validation(const struct problem *prob, const struct parameter *param, int nr_fold, float *target);
 void find_parameters(const struct problem *prob, const struct parameter *param, int nr_fold, float start_C, float start_p, float *best_C, float *best_p, float *best_score);
 
@@ -26,17 +26,29 @@
  Only this file should use std:cout.
  */
 
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 #include "args.h"
 #include "basic_types.h"
+#include "convert.h"
+#include "generate_data.h"
+#include "plan.h"
 #include "log.h"
 #include "measure.h"
+#include "metrics.h"
+#include "profiler.h"
 #include "misc.h"
 #include "model.h"
+#include "model_archive.h"
 #include "read_data.h"
 #include "resources.h"
+#include "threads.h"
 #include "version.h"
 
 std::vector<Real> loadVec(std::string infile){
@@ -54,6 +66,20 @@ void saveVec(std::vector<Real>& vec, std::string outfile){
     out.close();
 }
 
+// Loads model args, model can be also a single archive file (see convert command),
+// it is then mapped and args.output is set to its virtual dir, the returned archive has to outlive the model
+std::unique_ptr<ModelArchive> loadModelArgs(Args& args){
+    std::unique_ptr<ModelArchive> archive;
+    std::string modelDir = args.output;
+    if (ModelArchive::isArchive(modelDir)) {
+        archive = std::make_unique<ModelArchive>(modelDir);
+        modelDir = archive->getDir();
+    }
+    args.loadFromFile(joinPath(modelDir, "args.bin"));
+    args.output = modelDir; // Loading args restores the output from the command line
+    return archive;
+}
+
 void loadVecs(std::shared_ptr<Model> model, Args& args){
     std::vector<std::vector<Prediction>> predictions;
     if (!args.thresholds.empty()) { // Using thresholds if provided
@@ -75,15 +101,25 @@ void outputPrediction(std::vector<std::vector<Prediction>>& predictions, std::of
 
 void train(Args& args) {
 
-    SRMatrix labels;
+    IRMatrix labels;
     SRMatrix features;
 
     args.printArgs("train");
     makeDir(args.output);
     args.saveToFile(joinPath(args.output, "args.bin"));
+    Profiler::start();
 
     // Create data reader and load train data
-    readData(labels, features, args);
+    {
+        ProfilerPhase phase("read data");
+        readData(labels, features, args);
+    }
+    if (args.reindexFeatures) {
+        ProfilerPhase phase("reindex features");
+        reindexFeatures(features, args);
+    }
+    args.featuresSize = features.cols();
+    args.saveToFile(joinPath(args.output, "args.bin"));
     Log(COUT) << "Train data statistics:"
               << "\n  Train data points: " << features.rows()
               << "\n  Uniq features: " << features.cols() - 2
@@ -96,7 +132,10 @@ void train(Args& args) {
     // Create and train model (train function also saves model)
     std::shared_ptr<Model> model = Model::factory(args);
     loadVecs(model, args);
-    model->train(labels, features, args, args.output);
+    {
+        ProfilerPhase phase("train");
+        model->train(labels, features, args, args.output);
+    }
     model->printInfo();
 
     auto resAfterTraining = getResources();
@@ -113,14 +152,19 @@ void train(Args& args) {
               << "\n  Train CPU time / data point (ms): " << cpuTime * 1000 / labels.rows()
               << "\n  Train peak of real memory (MB): " << resAfterTraining.peakRealMem / 1024
               << "\n  Train peak of virtual memory (MB): " << resAfterTraining.peakVirtualMem / 1024 << "\n";
+
+    if (Profiler::enabled) {
+        Profiler::save(joinPath(args.output, "profile.json"));
+        Log(COUT) << "Training profile saved to " << joinPath(args.output, "profile.json") << "\n";
+    }
 }
 
 void test(Args& args) {
-    SRMatrix labels;
+    IRMatrix labels;
     SRMatrix features;
 
     // Load model args
-    args.loadFromFile(joinPath(args.output, "args.bin"));
+    auto archive = loadModelArgs(args);
     args.printArgs("test");
 
     // Load test data
@@ -187,14 +231,14 @@ void test(Args& args) {
 
 void predict(Args& args) {
     // Load model args
-    args.loadFromFile(joinPath(args.output, "args.bin"));
+    auto archive = loadModelArgs(args);
     args.printArgs("predict");
 
     // Load model
     std::shared_ptr<Model> model = Model::factory(args);
     model->load(args, args.output);
 
-    SRMatrix labels;
+    IRMatrix labels;
     SRMatrix features;
     readData(labels, features, args);
 
@@ -217,14 +261,14 @@ void predict(Args& args) {
 
 void ofo(Args& args) {
     // Load model args
-    args.loadFromFile(joinPath(args.output, "args.bin"));
+    auto archive = loadModelArgs(args);
     args.printArgs();
 
     // Load model
     std::shared_ptr<Model> model = Model::factory(args);
     model->load(args, args.output);
 
-    SRMatrix labels;
+    IRMatrix labels;
     SRMatrix features;
     readData(labels, features, args);
 
@@ -246,18 +290,116 @@ void ofo(Args& args) {
               << "\n  Optimization CPU time (s): " << cpuTime << "\n";
 }
 
+void generate(Args& args) {
+    Log(CERR) << "Seed: " << args.seed << "\n";
+    generateData(args);
+}
+
+void plan(Args& args) {
+    args.printArgs("plan");
+    planConfiguration(args);
+}
+
+// Wall-clock latencies of single queries predicted concurrently
+struct LatencyResult {
+    int threads;
+    double arrivalRate; // 0 for closed loop
+    double wallTime;
+    std::vector<double> latencies; // Sorted
+
+    double percentile(double p) const {
+        if (latencies.empty()) return 0;
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    }
+
+    double mean() const {
+        double sum = 0;
+        for (auto l : latencies) sum += l;
+        return latencies.empty() ? 0 : sum / latencies.size();
+    }
+};
+
+LatencyResult measureLatency(std::shared_ptr<Model>& model, SRMatrix& features, std::vector<int>& queries, int threads,
+                             double arrivalRate, Args& args) {
+    // Open loop: arrival times are drawn in advance from Poisson process, latency includes the time
+    // the query waited for a free thread. Closed loop: each thread takes the next query as soon as it is done.
+    std::vector<double> arrivals;
+    if (arrivalRate > 0) {
+        std::default_random_engine rng(args.seed);
+        std::exponential_distribution<double> gap(arrivalRate);
+        double time = 0;
+        for (size_t i = 0; i < queries.size(); ++i) arrivals.push_back(time += gap(rng));
+    }
+
+    LatencyResult result = {threads, arrivalRate, 0, std::vector<double>(queries.size())};
+    std::atomic<size_t> next(0);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    auto worker = [&]() {
+        std::vector<Prediction> prediction;
+        std::vector<IRVPair> pruned;
+        for (size_t i = next++; i < queries.size(); i = next++) {
+            auto issueTime = std::chrono::steady_clock::now();
+            if (!arrivals.empty()) {
+                issueTime = startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                            std::chrono::duration<double>(arrivals[i]));
+                std::this_thread::sleep_until(issueTime);
+            }
+            prediction.clear();
+            model->predictPruned(prediction, features[queries[i]], args, pruned);
+            result.latencies[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - issueTime).count();
+        }
+    };
+
+    ThreadSet tSet;
+    for (int t = 0; t < threads; ++t) tSet.add(worker);
+    tSet.joinAll();
+
+    result.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+void saveLatencyReport(std::string outfile, std::vector<LatencyResult>& results, Args& args) {
+    std::ofstream out(outfile);
+    out << std::setprecision(9) << "{\n  \"model\": \"" << args.output << "\",\n  \"input\": \"" << args.input
+        << "\",\n  \"results\": [";
+    for (int i = 0; i < results.size(); ++i) {
+        auto& r = results[i];
+        out << (i ? "," : "") << "\n    {\"threads\": " << r.threads << ", \"arrival_rate\": " << r.arrivalRate
+            << ", \"queries\": " << r.latencies.size() << ", \"wall_time\": " << r.wallTime
+            << ", \"throughput\": " << r.latencies.size() / r.wallTime << ",\n     \"latency\": {\"mean\": " << r.mean()
+            << ", \"p50\": " << r.percentile(0.5) << ", \"p90\": " << r.percentile(0.9) << ", \"p99\": " << r.percentile(0.99)
+            << ", \"p999\": " << r.percentile(0.999) << ", \"max\": " << r.percentile(1.0) << "},\n     \"histogram\": [";
+
+        // Buckets are powers of 2 in microseconds, the last non-empty bucket ends the histogram
+        std::vector<long long> buckets;
+        for (auto l : r.latencies) {
+            size_t b = 0;
+            while ((1LL << b) < l * 1e6) ++b;
+            if (buckets.size() <= b) buckets.resize(b + 1, 0);
+            ++buckets[b];
+        }
+        for (int b = 0; b < buckets.size(); ++b)
+            out << (b ? ", " : "") << "{\"le_us\": " << (1LL << b) << ", \"count\": " << buckets[b] << "}";
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+}
+
 void testPredictionTime(Args& args) {
     // Method for testing performance on different batch (test dataset) sizes
 
     // Load model args
-    args.loadFromFile(joinPath(args.output, "args.bin"));
+    auto archive = loadModelArgs(args);
     args.printArgs();
 
     // Load model
     std::shared_ptr<Model> model = Model::factory(args);
     model->load(args, args.output);
 
-    SRMatrix labels;
+    IRMatrix labels;
     SRMatrix features;
     readData(labels, features, args);
 
@@ -270,8 +412,9 @@ void testPredictionTime(Args& args) {
     std::default_random_engine rng(args.seed);
     std::uniform_int_distribution<int> dist(0, features.rows() - 1);
 
-    Log(COUT) << "Results:";
+    if (args.batches > 0) Log(COUT) << "Results:";
     for(const auto& batchSize : batchSizes) {
+        if (args.batches <= 0) break;
         long double time = 0;
         long double timeSq = 0;
         long double timePerPoint = 0;
@@ -312,7 +455,255 @@ void testPredictionTime(Args& args) {
                   << "\n  Batch " << batchSize << " test CPU time / data points std (ms): " << std::sqrt(timePerPointSq / args.batches - meanTimePerPoint * meanTimePerPoint);
 
     }
-    Log(COUT) << "\n";
+    if (args.batches > 0) Log(COUT) << "\n";
+
+    // Latency of single queries and throughput for each number of threads
+    int queriesCount = args.benchmarkQueries > 0 ? args.benchmarkQueries : features.rows();
+    std::vector<int> queries;
+    for (int i = 0; i < std::max(queriesCount, args.warmupQueries); ++i) queries.push_back(dist(rng));
+
+    if (args.warmupQueries > 0) {
+        std::vector<int> warmup(queries.begin(), queries.begin() + args.warmupQueries);
+        measureLatency(model, features, warmup, 1, 0, args);
+    }
+    queries.resize(queriesCount);
+
+    std::vector<LatencyResult> results;
+    for (const auto& t : split(args.benchmarkThreads)) {
+        results.push_back(measureLatency(model, features, queries, std::stoi(t), args.arrivalRate, args));
+        auto& r = results.back();
+        Log(COUT) << "Latency with " << r.threads << " threads";
+        if (r.arrivalRate > 0) Log(COUT) << " and " << r.arrivalRate << " queries/s arrival rate";
+        Log(COUT) << ":\n  Throughput (queries/s): " << r.latencies.size() / r.wallTime
+                  << "\n  Mean latency (ms): " << r.mean() * 1000
+                  << "\n  p50 latency (ms): " << r.percentile(0.5) * 1000
+                  << "\n  p90 latency (ms): " << r.percentile(0.9) * 1000
+                  << "\n  p99 latency (ms): " << r.percentile(0.99) * 1000
+                  << "\n  p99.9 latency (ms): " << r.percentile(0.999) * 1000
+                  << "\n  Max latency (ms): " << r.percentile(1.0) * 1000 << "\n";
+    }
+
+    if (!args.report.empty()) saveLatencyReport(args.report, results, args);
+}
+
+// Configuration evaluated by tune command
+struct TuneCandidate {
+    int arity;
+    int maxLeaves;
+    Real weightsThreshold;
+    RepresentationType loadAs;
+    int beamSearchWidth; // 0 for exact search
+    double score;
+    double p99Latency;
+    unsigned long long mem;
+    bool pareto;
+    std::string dir; // Trained model
+
+    std::string toArgs(bool tree) const {
+        std::ostringstream out;
+        if (tree) out << "--arity " << arity << " --maxLeaves " << maxLeaves << " ";
+        out << "--weightsThreshold " << weightsThreshold << " --loadAs "
+            << (loadAs == dense ? "dense" : (loadAs == map ? "map" : "sparse"));
+        if (tree && beamSearchWidth > 0) out << " --treeSearchType beam --beamSearchWidth " << beamSearchWidth;
+        else if (tree) out << " --treeSearchType exact";
+        return out.str();
+    }
+};
+
+void convert(Args& args) {
+    convertModel(args);
+}
+
+void tune(Args& args) {
+    // Searches the trade-off between the first of measures and latency/memory on validation data,
+    // a model is trained for each arity and max leaves, the other args are applied to the trained weights
+    bool tree = args.modelType == plt || args.modelType == hsm;
+    if (!tree && args.modelType != br && args.modelType != ovr)
+        throw std::invalid_argument("Tuning is not supported for this model type");
+    if (args.ensemble > 1) throw std::invalid_argument("Tuning is not supported for ensembles");
+    if (args.validation.empty()) throw std::invalid_argument("Validation data is required, set --validation");
+
+    args.printArgs("tune");
+    makeDir(args.output);
+
+    IRMatrix labels;
+    SRMatrix features;
+    readData(labels, features, args);
+    if (args.reindexFeatures) reindexFeatures(features, args);
+    args.featuresSize = features.cols();
+    args.saveToFile(joinPath(args.output, "args.bin"));
+
+    IRMatrix vLabels;
+    SRMatrix vFeatures;
+    Args vArgs = args;
+    vArgs.input = args.validation;
+    readData(vLabels, vFeatures, vArgs);
+
+    // Values to search
+    std::vector<int> arities, maxLeaves, beamWidths;
+    std::vector<Real> thresholds;
+    std::vector<RepresentationType> types;
+    for (const auto& s : split(args.tuneArity)) arities.push_back(std::stoi(s));
+    for (const auto& s : split(args.tuneMaxLeaves)) maxLeaves.push_back(std::stoi(s));
+    for (const auto& s : split(args.tuneWeightsThreshold)) thresholds.push_back(std::stof(s));
+    for (const auto& s : split(args.tuneBeamSearchWidth)) beamWidths.push_back(std::stoi(s));
+    for (const auto& s : split(args.tuneLoadAs)) {
+        if (s == "dense") types.push_back(dense);
+        else if (s == "map") types.push_back(map);
+        else if (s == "sparse") types.push_back(sparse);
+        else throw std::invalid_argument("Unknown representation type: " + s);
+    }
+    if (!tree || arities.empty()) arities = {args.arity};
+    if (!tree || maxLeaves.empty()) maxLeaves = {args.maxLeaves};
+    if (thresholds.empty()) thresholds = {args.weightsThreshold};
+    if (types.empty()) types = {args.loadAs};
+    if (!tree) beamWidths = {0};
+    else if (beamWidths.empty()) beamWidths = {args.treeSearchType == beam ? args.beamSearchWidth : 0};
+    std::sort(thresholds.begin(), thresholds.end()); // Pruning is applied incrementally
+
+    Args mArgs = args;
+    mArgs.measures = split(args.measures).front();
+
+    std::default_random_engine rng(args.seed);
+    std::uniform_int_distribution<int> dist(0, vFeatures.rows() - 1);
+    std::vector<int> queries, warmup;
+    for (int i = 0; i < (args.benchmarkQueries > 0 ? args.benchmarkQueries : vFeatures.rows()); ++i)
+        queries.push_back(args.benchmarkQueries > 0 ? dist(rng) : i);
+    for (int i = 0; i < args.warmupQueries; ++i) warmup.push_back(dist(rng));
+
+    std::vector<TuneCandidate> candidates;
+    for (auto a : arities) {
+        for (auto ml : maxLeaves) {
+            Args cArgs = args;
+            cArgs.arity = a;
+            cArgs.maxLeaves = ml;
+            cArgs.weightsThreshold = thresholds.front();
+            std::string dir = joinPath(joinPath(args.output, "tune"),
+                                       tree ? "arity_" + std::to_string(a) + "_maxLeaves_" + std::to_string(ml) : "model");
+            makeDir(dir);
+            cArgs.output = dir;
+            cArgs.saveToFile(joinPath(dir, "args.bin"));
+            Model::factory(cArgs)->train(labels, features, cArgs, dir);
+
+            cArgs.loadAs = sparse;
+            std::shared_ptr<Model> model = Model::factory(cArgs);
+            model->load(cArgs, dir);
+            auto& bases = model->getBases();
+
+            LogLevel level = logLevel;
+            logLevel = std::min(logLevel, COUT);
+            for (auto th : thresholds) {
+                for (auto b : bases) b->pruneWeights(th);
+                model->updateUsedFeatures(cArgs);
+
+                for (auto type : types) {
+                    if (type == dense) {
+                        unsigned long long denseMem = 0;
+                        for (auto b : bases)
+                            if (b->getW() != nullptr) denseMem += Vector::estimateMem(b->getW()->size(), 0);
+                        if (denseMem > args.memLimit) continue;
+                    }
+                    unsigned long long mem = 0;
+                    for (auto b : bases) {
+                        b->to(type);
+                        mem += b->mem();
+                    }
+
+                    for (auto w : beamWidths) {
+                        cArgs.treeSearchType = w > 0 ? beam : exact;
+                        cArgs.beamSearchWidth = w;
+
+                        auto measure = Measure::factory(mArgs, model->outputSize()).front();
+                        auto predictions = model->predictBatch(vFeatures, cArgs);
+                        measure->accumulate(vLabels, predictions);
+                        if (!warmup.empty()) measureLatency(model, vFeatures, warmup, 1, 0, cArgs);
+                        auto latency = measureLatency(model, vFeatures, queries, 1, 0, cArgs);
+
+                        candidates.push_back({a, ml, th, type, w, measure->value(), latency.percentile(0.99), mem, false, dir});
+                        auto& c = candidates.back();
+                        Log(COUT) << "  " << c.toArgs(tree) << ": " << measure->getName() << ": " << c.score
+                                  << ", p99 latency (ms): " << c.p99Latency * 1000
+                                  << ", model memory (MB): " << static_cast<double>(c.mem) / 1024 / 1024 << "\n";
+                    }
+
+                    for (auto b : bases) b->to(sparse);
+                }
+            }
+            logLevel = level;
+        }
+    }
+    if (candidates.empty()) throw std::runtime_error("No configuration fits in the memory limit");
+
+    // Pareto front: no other configuration is at least as good in all objectives and better in one
+    for (auto& c : candidates) {
+        c.pareto = true;
+        for (auto& o : candidates) {
+            if (o.score >= c.score && o.p99Latency <= c.p99Latency && o.mem <= c.mem
+                && (o.score > c.score || o.p99Latency < c.p99Latency || o.mem < c.mem)) {
+                c.pareto = false;
+                break;
+            }
+        }
+    }
+
+    // The best score within the limits, otherwise the fastest
+    int chosen = -1;
+    for (int i = 0; i < candidates.size(); ++i) {
+        auto& c = candidates[i];
+        if ((args.latencyLimit > 0 && c.p99Latency * 1000 > args.latencyLimit) || c.mem > args.memLimit || !c.pareto) continue;
+        if (chosen < 0 || c.score > candidates[chosen].score
+            || (c.score == candidates[chosen].score && c.p99Latency < candidates[chosen].p99Latency))
+            chosen = i;
+    }
+    if (chosen < 0) {
+        Log(CERR) << "Warning: No configuration meets the latency limit, choosing the fastest one!\n";
+        chosen = 0;
+        for (int i = 1; i < candidates.size(); ++i)
+            if (candidates[i].p99Latency < candidates[chosen].p99Latency) chosen = i;
+    }
+    auto& best = candidates[chosen];
+
+    Log(COUT) << "Pareto front of " << mArgs.measures << " against p99 latency and model memory:\n";
+    for (auto& c : candidates)
+        if (c.pareto)
+            Log(COUT) << (&c == &best ? "* " : "  ") << c.toArgs(tree) << ": " << mArgs.measures << ": " << c.score
+                      << ", p99 latency (ms): " << c.p99Latency * 1000
+                      << ", model memory (MB): " << static_cast<double>(c.mem) / 1024 / 1024 << "\n";
+
+    // Chosen model is saved in the output dir with weights pruned with the chosen threshold
+    for (const auto& f : std::filesystem::directory_iterator(best.dir))
+        if (f.is_regular_file() && f.path().filename() != "args.bin")
+            std::filesystem::copy_file(f.path(), joinPath(args.output, f.path().filename().string()),
+                                       std::filesystem::copy_options::overwrite_existing);
+    {
+        Args cArgs = args;
+        cArgs.arity = best.arity;
+        cArgs.maxLeaves = best.maxLeaves;
+        cArgs.loadAs = sparse;
+        std::shared_ptr<Model> model = Model::factory(cArgs);
+        model->load(cArgs, best.dir);
+        for (auto b : model->getBases()) b->pruneWeights(best.weightsThreshold);
+        Model::saveBases(joinPath(args.output, "weights.bin"), model->getBases());
+
+        // Chosen args are applied when the model is loaded, unless they are given again
+        cArgs.tunedArgs = best.toArgs(tree);
+        cArgs.saveToFile(joinPath(args.output, "args.bin"));
+    }
+    std::filesystem::remove_all(joinPath(args.output, "tune")); // Models of the other candidates
+
+    std::ofstream out(joinPath(args.output, "tune.json"));
+    out << std::setprecision(9) << "{\n  \"measure\": \"" << mArgs.measures << "\",\n  \"candidates\": [";
+    for (int i = 0; i < candidates.size(); ++i) {
+        auto& c = candidates[i];
+        out << (i ? "," : "") << "\n    {\"args\": \"" << c.toArgs(tree) << "\", \"score\": " << c.score
+            << ", \"p99_latency\": " << c.p99Latency << ", \"mem\": " << c.mem
+            << ", \"pareto\": " << (c.pareto ? "true" : "false") << "}";
+    }
+    out << "\n  ],\n  \"chosen\": " << chosen << ",\n  \"chosen_args\": \"" << best.toArgs(tree) << "\"\n}\n";
+    out.close();
+
+    Log(COUT) << "Chosen args: " << best.toArgs(tree)
+              << "\nModel saved to " << args.output << ", results saved to " << joinPath(args.output, "tune.json") << "\n";
 }
 
 void printHelp() {
@@ -323,6 +714,14 @@ Commands:
     test                    Test model on given input data
     predict                 Predict for given data
     ofo                     Use online f-measure optimization
+    testPredictionTime      Measure prediction time for batches, latency percentiles and throughput
+    generate                Generate synthetic dataset and save it to the output file
+    plan                    Estimate memory required to train and predict with given args on input data
+                            and recommend configuration within the memory limit, without training
+    tune                    Search args for the trade-off between precision and prediction latency/memory
+                            on validation data and save the chosen model
+    convert                 Rewrite the model with pruned, quantized or compressed weights, renumbered features
+                            or as a single archive file and verify its predictions on input data
     version                 Print napkinXC version
     help                    Print help
 
@@ -333,14 +732,27 @@ Args:
     -m, --model             Model type (default = plt)
                             Models: plt, hsm, br, ovr, oplt
     -p, --prediction
+    --metrics               Save counters and latency histograms of training and prediction stages to the file,
+                            in Prometheus text format if it has .prom extension, in JSON otherwise (default = None)
+    --profile               Save wall and CPU time, memory of the training phases and training times of the base
+                            estimators to profile.json in the model dir (default = 0)
     --ensemble              Number of models in ensemble (default = 1)
     -t, --threads           Number of threads to use (default = 0)
                             Note: set to -1 to use a number of available CPUs - 1, 0 to use a number of available CPUs
+    --poolSize              Maximum number of workers of the process-wide thread pool shared by all the parallel
+                            parts, tasks above it run one after another (default = 0, no limit)
     --memLimit              Maximum amount of memory (in G) available for training (default = 0)
                             Note: set to 0 to set limit to amount of available memory
     --hash                  Size of features space (default = 0)
                             Note: set to 0 to disable hashing
     --featuresThreshold     Prune features below given threshold (default = 0.0)
+    --reindexFeatures       Renumber features by descending frequency in the training data and store the mapping
+                            in the model, features not seen in training are dropped at prediction (default = 0)
+    --pruneQueryFeatures    Remove features with zero weights in all base estimators from the queries
+                            before prediction (default = 1)
+    --denseFeatures         Number of leading features that are dense, e.g. embeddings, BR scores blocks of queries
+                            with their dense part by matrix products, PLT scores the nodes with the dense part
+                            of the query, other features stay sparse (default = 0)
     --seed                  Seed (default = system time)
     --verbose               Verbose level (default = 2)
 
@@ -364,6 +776,20 @@ Args:
                                     Supported solvers: L2R_LR_DUAL, L2R_LR, L1R_LR,
                                                        L2R_L2LOSS_SVC_DUAL, L2R_L2LOSS_SVC, L2R_L1LOSS_SVC_DUAL, L1R_L2LOSS_SVC
     --maxIter, --liblinearMaxIter   Maximum number of iterations for LIBLINEAR (default = 100)
+    --sharedColumns, --liblinearSharedColumns
+                                    Transpose training data once for all base estimators trained by L1R_LR
+                                    and L1R_L2LOSS_SVC solvers instead of each one separately,
+                                    lowers memory usage (default = 0)
+    --deduplicate                   Merge examples of a base estimator with identical features and label
+                                    into one weighted example (default = 0)
+    --hybrid                        Choose optimizer for each base estimator by its size (default = 0)
+                                    Small problems are trained with AdaGrad, max iter of large ones is scaled down
+    --hybridMinRows                 Problems with fewer examples are trained with AdaGrad (default = 100)
+    --hybridEpochs                  Number of AdaGrad epochs for small problems (default = 3)
+    --hybridIterRows                Max iter of problems with more examples is scaled by hybridIterRows / examples,
+                                    but is at least 10 (default = 100000)
+    --warmStart                     Path to a previously trained model, its base estimators are used as initial solutions,
+                                    tree based models also reuse its tree (default = None)
 
     SGD/AdaGrad:
     -l, --lr, --eta         Step size (learning rate) for online optimizers (default = 1.0)
@@ -393,6 +819,61 @@ Args:
     --measures              Evaluate test using set of measures (default = "p@1,p@3,p@5")
                             Measures: acc (accuracy), p (precision), r (recall), c (coverage), hl (hamming loos)
                                       p@k (precision at k), r@k (recall at k), c@k (coverage at k), s (prediction size)
+
+    Generate:
+    --rows                  Number of data points (default = 10000)
+    --testRows              Number of test data points, generated from the same clusters as the others (default = 0)
+    --testOutput            Output file for test data points
+    --features              Number of features (default = 100000)
+    --labels                Number of labels (default = 10000)
+    --labelsPerRow          Mean number of labels per data point (default = 3)
+    --featuresPerRow        Mean number of non-zero features per data point (default = 50)
+    --labelsPowerLaw        Exponent of the power law of labels frequencies (default = 1.0)
+    --latentClusters        Number of latent clusters of labels, 0 for square root of labels (default = 0)
+    --featuresNoise         Fraction of features unrelated to the labels (default = 0.1)
+    --binary                Save in binary format, faster to read than libsvm format (default = 0)
+                            Note: use --seed to generate the same dataset again
+
+    Plan:
+    --scanRows              Number of data points scanned to estimate statistics of the whole input,
+                            set to 0 to scan all of them (default = 0)
+
+    Tune:
+    --validation            Validation dataset, required
+    --tuneArity             Arities of tree nodes to train models with (default = "", --arity)
+    --tuneMaxLeaves         Maximum degrees of pre-leaf nodes to train models with (default = "", --maxLeaves)
+    --tuneWeightsThreshold  Thresholds for pruning weights of the trained models (default = "0.1,0.2,0.3,0.5")
+    --tuneLoadAs            Representations of the weights (default = "map,sparse,dense")
+    --tuneBeamSearchWidth   Widths of beam search, 0 for exact search (default = "0,10,20")
+    --latencyLimit          Maximum p99 latency (in ms) of the chosen args, they have the best value of the first
+                            of --measures within the latency and --memLimit (default = 0, no limit)
+                            Note: --benchmarkQueries and --warmupQueries set the number of queries to measure latency
+
+    Prediction time test:
+    --batchSizes            Sizes of batches to measure CPU time of (default = "100,1000,10000")
+    --batches               Number of batches of each size, set to 0 to skip them (default = 10)
+    --benchmarkThreads      Numbers of threads to measure latency and throughput with (default = "1")
+    --benchmarkQueries      Number of queries sampled from the input for each number of threads
+                            (default = 0, number of data points in the input)
+    --warmupQueries         Number of queries predicted before the measurements (default = 100)
+    --arrivalRate           Queries per second arriving as Poisson process, latency includes waiting
+                            for a free thread, set to 0 to predict in closed loop (default = 0)
+    --report                Save results with latency histograms to the JSON file
+
+    Convert:
+    --convertOutput         Output path of the converted model, required
+    --pruneThreshold        Threshold value for pruning weights of the model (default = 0.0)
+    --saveAs                Coding of the weights on disk: auto, dense, sparse (default = auto)
+                            Note: auto selects the smaller one for each weights vector
+    --quantize              Number of bits of the quantized weights, 8 or 16, 0 to keep them as floats (default = 0)
+    --compress              Save indices of the sparse weights as variable-length deltas (default = 0)
+    --reindexModel          Renumber features by the number of base estimators that use them,
+                            features unused by the model are dropped from the queries (default = 0)
+    --archive               Save the model as a single archive file, that is mapped into the memory when loaded,
+                            -o of other commands accepts it in place of a model dir (default = 0)
+    --verifyRows            Number of data points of the input used to compare predictions of the models,
+                            set to 0 to skip verification (default = 1000)
+    --tolerance             Maximum absolute difference of predicted probabilities (default = 0.01)
     )HELP";
 }
 
@@ -418,6 +899,11 @@ int main(int argc, char** argv) {
         exit(EXIT_FAILURE);
     }
 
+    // Process-wide settings are applied once, loading of the model args doesn't change them
+    Metrics::enabled = !args.metrics.empty() || args.profile; // Profiler uses the times of the metrics
+    Profiler::enabled = args.profile;
+    WorkerPool::getInstance().setMaxSize(args.poolSize);
+
     if (command == "-h" || command == "--help" || command == "help")
         printHelp();
     else if (command == "-v" || command == "--version" || command == "version")
@@ -432,11 +918,21 @@ int main(int argc, char** argv) {
         ofo(args);
     else if (command == "testPredictionTime")
         testPredictionTime(args);
+    else if (command == "generate")
+        generate(args);
+    else if (command == "plan")
+        plan(args);
+    else if (command == "tune")
+        tune(args);
+    else if (command == "convert")
+        convert(args);
     else {
         std::cout << "Unknown command type: " << command << "\n";
         printHelp();
         exit(EXIT_FAILURE);
     }
 
+    if (!args.metrics.empty()) Metrics::save(args.metrics);
+
     return EXIT_SUCCESS;
 }
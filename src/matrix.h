@@ -22,8 +22,43 @@
 
 #pragma once
 
+#include <memory>
+#include <type_traits>
+
 #include "vector.h"
 
+// Chunked bump allocator for rows of a matrix, avoids a separate heap allocation for every row,
+// all the memory is released together with the matrix
+class RowArena {
+public:
+    RowArena() = default;
+    RowArena(const RowArena&) {} // Copied rows own their data
+    RowArena(RowArena&&) = default;
+    RowArena& operator=(const RowArena&) { return *this; }
+    RowArena& operator=(RowArena&&) = default;
+
+    template <typename T> T* alloc(size_t n) {
+        size_t bytes = (n * sizeof(T) + alignment - 1) & ~(alignment - 1);
+        if (bytes > left) {
+            size_t size = std::max(bytes, chunkSize);
+            chunks.emplace_back(new char[size]);
+            next = chunks.back().get();
+            left = size;
+        }
+        T* ptr = reinterpret_cast<T*>(next);
+        next += bytes;
+        left -= bytes;
+        return ptr;
+    }
+
+private:
+    static constexpr size_t alignment = 16;
+    static constexpr size_t chunkSize = 1 << 20;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* next = nullptr;
+    size_t left = 0;
+};
+
 // Simple row ordered matrix
 template <typename T> class RMatrix {
 public:
@@ -35,7 +70,7 @@ public:
 
     template<typename U>
     void appendRow(const U& vec, bool sorted = true) {
-        T& row = r.emplace_back(vec, sorted);
+        T& row = emplaceRow(vec, sorted);
         m = r.size();
         if(row.size() > n) n = row.size();
     }
@@ -53,19 +88,25 @@ public:
         return totalN0;
     }
     inline unsigned long long mem() const {
-        int totalMem = 0; // Mem
+        unsigned long long totalMem = 0; // Mem
         for(auto &vec : r) totalMem += vec.mem();
         return totalMem;
     }
     inline int size(int index) { return r[index].nonZero(); }
 
-    void save(std::ofstream& out) {
+    // Recalculates the number of columns after the rows were modified in place
+    void updateCols() {
+        n = 0;
+        for(auto& row : r) n = std::max(n, row.size());
+    }
+
+    void save(std::ostream& out) {
         out.write((char*)&m, sizeof(m));
         out.write((char*)&n, sizeof(n));
         for(auto& v : r) v.save(out);
     }
 
-    void load(std::ifstream& in){
+    void load(std::istream& in){
         in.read((char*)&m, sizeof(m));
         in.read((char*)&n, sizeof(n));
         r.resize(m);
@@ -80,8 +121,19 @@ private:
     size_t m;              // Row count
     size_t n;              // Col count
     std::vector<T> r;      // Rows data
+    RowArena arena;        // Data of sparse rows
+
+    template<typename U>
+    T& emplaceRow(const U& vec, bool sorted) {
+        if constexpr (std::is_same<T, SparseVector>::value)
+            return r.emplace_back(vec, sorted, arena.alloc<IRVPair>(vec.size() + 1));
+        else if constexpr (std::is_same<T, IndexVector>::value)
+            return r.emplace_back(vec, sorted, arena.alloc<IndexEntry>(vec.size() + 1));
+        else return r.emplace_back(vec, sorted);
+    }
 };
 
 typedef RMatrix<Vector> Matrix;
 typedef RMatrix<MapVector> MRMatrix;
 typedef RMatrix<SparseVector> SRMatrix;
+typedef RMatrix<IndexVector> IRMatrix;
@@ -92,7 +92,7 @@ Measure::Measure() {
     count = 0;
 }
 
-void Measure::accumulate(SRMatrix& labels, std::vector<std::vector<Prediction>>& predictions) {
+void Measure::accumulate(IRMatrix& labels, std::vector<std::vector<Prediction>>& predictions) {
     assert(predictions.size() == labels.rows());
     for (int i = 0; i < labels.rows(); ++i) accumulate(labels[i], predictions[i]);
 }
@@ -119,11 +119,11 @@ TruePositivesAtK::TruePositivesAtK(int k) : MeasureAtK(k) {
     meanMeasure = true;
 }
 
-void TruePositivesAtK::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void TruePositivesAtK::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     addValue(calculate(labels, prediction, k));
 }
 
-double TruePositivesAtK::calculate(SparseVector& labels, const std::vector<Prediction>& prediction, int k) {
+double TruePositivesAtK::calculate(IndexVector& labels, const std::vector<Prediction>& prediction, int k) {
     double tp = 0;
     for (int i = 0; i < std::min(k, static_cast<int>(prediction.size())); ++i) {
         for(auto &l : labels)
@@ -141,11 +141,11 @@ TruePositives::TruePositives() {
     meanMeasure = true;
 }
 
-void TruePositives::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void TruePositives::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     addValue(TruePositives::calculate(labels, prediction));
 }
 
-double TruePositives::calculate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+double TruePositives::calculate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     return TruePositivesAtK::calculate(labels, prediction, prediction.size());
 }
 
@@ -154,11 +154,11 @@ FalsePositives::FalsePositives() {
     meanMeasure = true;
 }
 
-void FalsePositives::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void FalsePositives::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     addValue(FalsePositives::calculate(labels, prediction));
 }
 
-double FalsePositives::calculate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+double FalsePositives::calculate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     double fp = 0;
 
     for (const auto& p : prediction) {
@@ -180,11 +180,11 @@ FalseNegatives::FalseNegatives() {
     meanMeasure = true;
 }
 
-void FalseNegatives::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void FalseNegatives::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     addValue(FalseNegatives::calculate(labels, prediction));
 }
 
-double FalseNegatives::calculate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+double FalseNegatives::calculate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     double fn = 0;
 
     
@@ -207,7 +207,7 @@ Recall::Recall() {
     meanMeasure = true;
 }
 
-void Recall::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void Recall::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     double tp = TruePositives::calculate(labels, prediction);
     if(labels.nonZero()) addValue(tp / labels.nonZero());
 }
@@ -217,7 +217,7 @@ RecallAtK::RecallAtK(int k) : MeasureAtK(k) {
     meanMeasure = true;
 }
 
-void RecallAtK::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void RecallAtK::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     double tp = TruePositivesAtK::calculate(labels, prediction, k);
     if(labels.nonZero()) addValue(tp / labels.nonZero());
 }
@@ -227,7 +227,7 @@ Precision::Precision() {
     meanMeasure = true;
 }
 
-void Precision::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void Precision::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     double tp = TruePositives::calculate(labels, prediction);
     if (!prediction.empty()) addValue(tp / prediction.size());
 }
@@ -237,7 +237,7 @@ PrecisionAtK::PrecisionAtK(int k) : MeasureAtK(k) {
     meanMeasure = true;
 }
 
-void PrecisionAtK::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void PrecisionAtK::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     addValue(TruePositivesAtK::calculate(labels, prediction, k) / k);
 }
 
@@ -246,11 +246,11 @@ DCGAtK::DCGAtK(int k) : MeasureAtK(k) {
     meanMeasure = true;
 }
 
-void DCGAtK::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void DCGAtK::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     addValue(calculate(labels, prediction, k));
 }
 
-double DCGAtK::calculate(SparseVector& labels, const std::vector<Prediction>& prediction, int k){
+double DCGAtK::calculate(IndexVector& labels, const std::vector<Prediction>& prediction, int k){
     double score = 0;
     for (int i = 0; i < std::min(k, static_cast<int>(prediction.size())); ++i) {
         for(auto &l : labels)
@@ -269,7 +269,7 @@ NDCGAtK::NDCGAtK(int k) : MeasureAtK(k) {
     meanMeasure = true;
 }
 
-void NDCGAtK::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void NDCGAtK::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     double nDenominator = 0;
 
     int i = 0;
@@ -289,7 +289,7 @@ Coverage::Coverage(int outputSize) : m(outputSize) {
     meanMeasure = false;
 }
 
-void Coverage::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void Coverage::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     for (const auto& p : prediction) {
         for(auto &l : labels)
             if (p.label == l.index) {
@@ -306,7 +306,7 @@ CoverageAtK::CoverageAtK(int outputSize, int k) : MeasureAtK(k), m(outputSize) {
     meanMeasure = false;
 }
 
-void CoverageAtK::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void CoverageAtK::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     for (int i = 0; i < std::min(k, static_cast<int>(prediction.size())); ++i) {
         for(auto &l : labels)
             if (prediction[i].label == l.index) {
@@ -323,7 +323,7 @@ Accuracy::Accuracy() {
     meanMeasure = true;
 }
 
-void Accuracy::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void Accuracy::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     if (!prediction.empty() && labels[0] == prediction[0].label) addValue(1);
     else addValue(0);
 }
@@ -333,7 +333,7 @@ PredictionSize::PredictionSize() {
     meanMeasure = true;
 }
 
-void PredictionSize::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void PredictionSize::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     addValue(prediction.size());
 }
 
@@ -342,7 +342,7 @@ HammingLoss::HammingLoss() {
     meanMeasure = true;
 }
 
-void HammingLoss::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void HammingLoss::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     addValue(FalsePositives::calculate(labels, prediction) + FalseNegatives::calculate(labels, prediction));
 }
 
@@ -351,7 +351,7 @@ SampleF1::SampleF1() {
     meanMeasure = true;
 }
 
-void SampleF1::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void SampleF1::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     double tp = TruePositives::calculate(labels, prediction);
     if (!prediction.empty() && labels.nonZero() > 0) {
         double p = tp / prediction.size();
@@ -365,7 +365,7 @@ MicroF1::MicroF1() {
     meanMeasure = false;
 }
 
-void MicroF1::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) {
+void MicroF1::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction) {
     double tp = TruePositives::calculate(labels, prediction);
     sum += 2 * tp;
     count += 2 * tp + FalsePositives::calculate(labels, prediction) + FalseNegatives::calculate(labels, prediction);
@@ -379,7 +379,7 @@ MacroF1::MacroF1(int outputSize) : m(outputSize), zeroDivisionDenominator(1) {
     labelsFN.resize(m, 0);
 }
 
-void MacroF1::accumulate(SparseVector& labels, const std::vector<Prediction>& prediction){
+void MacroF1::accumulate(IndexVector& labels, const std::vector<Prediction>& prediction){
 
     for (const auto& p : prediction) {
         bool found = false;
@@ -0,0 +1,199 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "metrics.h"
+#include "threads.h"
+
+static const char* counterNames[] = {"predicted_queries", "evaluated_nodes", "heap_pushes", "heap_pops", "trained_bases"};
+static const char* timerNames[] = {"predict", "level", "assign", "base_train", "base_save", "base_load"};
+
+void MetricsShard::reset() {
+    for (auto& c : counters) c = 0;
+    for (auto& t : buckets)
+        for (auto& b : t) b = 0;
+    for (auto& s : sums) s = 0;
+}
+
+// Shards of finished threads are reused by the new ones, so their number stays at the max number of threads
+static std::mutex shardsMutex;
+static std::vector<std::unique_ptr<MetricsShard>> shards;
+static std::vector<MetricsShard*> freeShards;
+
+struct ShardHandle {
+    MetricsShard* shard;
+
+    ShardHandle() {
+        std::lock_guard<std::mutex> lock(shardsMutex);
+        if (freeShards.empty()) {
+            shards.emplace_back(new MetricsShard());
+            shard = shards.back().get();
+        } else {
+            shard = freeShards.back();
+            freeShards.pop_back();
+        }
+    }
+
+    ~ShardHandle() {
+        std::lock_guard<std::mutex> lock(shardsMutex);
+        freeShards.push_back(shard);
+    }
+};
+
+MetricsShard& Metrics::shard() {
+    static thread_local ShardHandle handle;
+    return *handle.shard;
+}
+
+void Metrics::record(MetricTimer timer, double seconds, const MetricRecordInfo& info) {
+    if (!enabled.load(std::memory_order_relaxed)) return;
+    auto& s = shard();
+    long long us = static_cast<long long>(seconds * 1e6);
+    int bucket = 0;
+    while (bucket < metricBuckets - 1 && (1LL << bucket) < us) ++bucket;
+    auto& b = s.buckets[timer][bucket];
+    b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    s.sums[timer].store(s.sums[timer].load(std::memory_order_relaxed) + seconds, std::memory_order_relaxed);
+    if (auto hook = recordHook.load(std::memory_order_relaxed)) hook(timer, seconds, info);
+}
+
+// Counters of the models, only their values since the last reset are reported
+struct MetricSource {
+    MetricCounter counter;
+    const ShardedCounter* source;
+    long long offset;
+};
+static std::vector<MetricSource> sources;
+static std::array<long long, countersCount> removedSources{}; // Values of the removed sources
+
+void Metrics::addSource(MetricCounter counter, const ShardedCounter* source) {
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    sources.push_back({counter, source, *source});
+}
+
+void Metrics::removeSource(const ShardedCounter* source) {
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    for (auto& s : sources)
+        if (s.source == source) removedSources[s.counter] += *s.source - s.offset;
+    sources.erase(std::remove_if(sources.begin(), sources.end(), [&](const MetricSource& s) { return s.source == source; }),
+                  sources.end());
+}
+
+void Metrics::reset() {
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    for (auto& s : shards) s->reset();
+    for (auto& s : sources) s.offset = *s.source;
+    removedSources.fill(0);
+}
+
+// Merged values of all the shards
+struct MetricsSnapshot {
+    std::array<long long, countersCount> counters{};
+    std::array<std::array<long long, metricBuckets>, timersCount> buckets{};
+    std::array<double, timersCount> sums{};
+    std::array<long long, timersCount> counts{};
+
+    MetricsSnapshot() {
+        std::lock_guard<std::mutex> lock(shardsMutex);
+        for (auto& s : shards) {
+            for (int i = 0; i < countersCount; ++i) counters[i] += s->counters[i].load(std::memory_order_relaxed);
+            for (int i = 0; i < timersCount; ++i) {
+                for (int j = 0; j < metricBuckets; ++j) buckets[i][j] += s->buckets[i][j].load(std::memory_order_relaxed);
+                sums[i] += s->sums[i].load(std::memory_order_relaxed);
+            }
+        }
+        for (auto& s : sources) counters[s.counter] += *s.source - s.offset;
+        for (int i = 0; i < countersCount; ++i) counters[i] += removedSources[i];
+        for (int i = 0; i < timersCount; ++i)
+            for (auto b : buckets[i]) counts[i] += b;
+    }
+
+    // Upper bound of the bucket with the given quantile (in seconds)
+    double quantile(int timer, double q) const {
+        long long rank = std::ceil(q * counts[timer]), seen = 0;
+        for (int j = 0; j < metricBuckets; ++j) {
+            seen += buckets[timer][j];
+            if (seen >= rank && seen > 0) return bucketBound(j);
+        }
+        return 0;
+    }
+
+    static double bucketBound(int bucket) { return static_cast<double>(1LL << bucket) / 1e6; }
+};
+
+double Metrics::sum(MetricTimer timer) {
+    return MetricsSnapshot().sums[timer];
+}
+
+std::string Metrics::toJson() {
+    MetricsSnapshot m;
+    std::ostringstream out;
+    out << std::setprecision(9) << "{\n  \"counters\": {";
+    for (int i = 0; i < countersCount; ++i)
+        out << (i ? "," : "") << "\n    \"" << counterNames[i] << "\": " << m.counters[i];
+    out << "\n  },\n  \"timers\": {";
+    for (int i = 0; i < timersCount; ++i) {
+        out << (i ? "," : "") << "\n    \"" << timerNames[i] << "\": {\"count\": " << m.counts[i]
+            << ", \"sum\": " << m.sums[i] << ", \"mean\": " << (m.counts[i] ? m.sums[i] / m.counts[i] : 0)
+            << ", \"p50\": " << m.quantile(i, 0.5) << ", \"p90\": " << m.quantile(i, 0.9)
+            << ", \"p99\": " << m.quantile(i, 0.99) << ", \"p999\": " << m.quantile(i, 0.999) << "}";
+    }
+    out << "\n  }\n}\n";
+    return out.str();
+}
+
+std::string Metrics::toPrometheus() {
+    MetricsSnapshot m;
+    std::ostringstream out;
+    out << std::setprecision(9);
+    for (int i = 0; i < countersCount; ++i)
+        out << "# TYPE napkinxc_" << counterNames[i] << "_total counter\n"
+            << "napkinxc_" << counterNames[i] << "_total " << m.counters[i] << "\n";
+    for (int i = 0; i < timersCount; ++i) {
+        std::string name = std::string("napkinxc_") + timerNames[i] + "_seconds";
+        out << "# TYPE " << name << " histogram\n";
+        long long cumulative = 0;
+        for (int j = 0; j < metricBuckets - 1; ++j) {
+            cumulative += m.buckets[i][j];
+            out << name << "_bucket{le=\"" << MetricsSnapshot::bucketBound(j) << "\"} " << cumulative << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << m.counts[i] << "\n"
+            << name << "_sum " << m.sums[i] << "\n" << name << "_count " << m.counts[i] << "\n";
+    }
+    return out.str();
+}
+
+void Metrics::save(const std::string& outfile) {
+    std::ofstream out(outfile);
+    if (!out.good()) throw std::invalid_argument("Cannot write metrics to " + outfile);
+    bool prometheus = outfile.size() >= 5 && outfile.compare(outfile.size() - 5, 5, ".prom") == 0;
+    out << (prometheus ? toPrometheus() : toJson());
+}
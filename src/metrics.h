@@ -0,0 +1,120 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Lightweight counters and latency histograms of the hot paths of training and prediction.
+// Every thread writes only to its own shard, shards are merged when the metrics are exported.
+
+enum MetricCounter {
+    predictedQueries,
+    evaluatedNodes,
+    heapPushes,
+    heapPops,
+    trainedBases,
+    countersCount
+};
+
+enum MetricTimer {
+    predictTime, // Prediction of a single query
+    levelTime, // Level of the beam search
+    assignTime, // Assignment of the data points to base estimators
+    baseTrainTime, // Training of a single base estimator
+    baseSaveTime,
+    baseLoadTime,
+    timersCount
+};
+
+// Buckets of the histograms are powers of 2 in microseconds
+constexpr int metricBuckets = 32;
+
+struct MetricsShard {
+    std::array<std::atomic<long long>, countersCount> counters;
+    std::array<std::array<std::atomic<long long>, metricBuckets>, timersCount> buckets;
+    std::array<std::atomic<double>, timersCount> sums;
+
+    MetricsShard() { reset(); }
+    void reset();
+};
+
+class ShardedCounter;
+
+// Details of the measured operation passed to the record hook
+struct MetricRecordInfo {
+    int rows = 0; // Size of the problem
+    const char* detail = ""; // E.g. optimizer of the base estimator
+};
+
+class Metrics {
+public:
+    static inline std::atomic<bool> enabled{false}; // Set while the predictions may run, e.g. from Python
+
+    static inline void count(MetricCounter counter, long long value = 1) {
+        if (!enabled.load(std::memory_order_relaxed)) return;
+        auto& c = shard().counters[counter];
+        c.store(c.load(std::memory_order_relaxed) + value, std::memory_order_relaxed); // Single writer
+    }
+
+    static void record(MetricTimer timer, double seconds, const MetricRecordInfo& info = MetricRecordInfo());
+    // Sum of the recorded times of all the threads
+    static double sum(MetricTimer timer);
+
+    // Called with every recorded time while the metrics are enabled, the profiler uses it to keep the times of bases
+    using RecordHook = void (*)(MetricTimer timer, double seconds, const MetricRecordInfo& info);
+    static inline std::atomic<RecordHook> recordHook{nullptr};
+
+    // Counters kept by the models for their own stats (e.g. evaluated nodes of PLT) are read by the metrics
+    // instead of being counted twice, they are counted also while the metrics are disabled
+    static void addSource(MetricCounter counter, const ShardedCounter* source);
+    static void removeSource(const ShardedCounter* source);
+
+    static void reset();
+    static std::string toJson();
+    static std::string toPrometheus();
+
+    // Exports in Prometheus text format if file has .prom extension, in JSON otherwise
+    static void save(const std::string& outfile);
+
+private:
+    static MetricsShard& shard();
+};
+
+// Records time of the scope
+class MetricScope {
+public:
+    explicit MetricScope(MetricTimer timer): timer(timer), active(Metrics::enabled.load(std::memory_order_relaxed)) {
+        if (active) startTime = std::chrono::steady_clock::now();
+    }
+    ~MetricScope() {
+        if (active) Metrics::record(timer, std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+    }
+
+private:
+    MetricTimer timer;
+    bool active;
+    std::chrono::steady_clock::time_point startTime;
+};
@@ -29,10 +29,11 @@
 #include <filesystem>
 
 #include "misc.h"
+#include "model_archive.h"
 #include "threads.h"
 
 // Data utils
-std::vector<Prediction> computeLabelsPriors(const SRMatrix& labels) {
+std::vector<Prediction> computeLabelsPriors(const IRMatrix& labels) {
     Log(CERR) << "Computing labels' prior probabilities ...\n";
 
     std::vector<Prediction> labelsProb;
@@ -53,7 +54,7 @@ std::vector<Prediction> computeLabelsPriors(const SRMatrix& labels) {
 
 void computeLabelsFeaturesMatrixThread(std::vector<std::vector<Feature>>& labelsFeatures,
                                         std::vector<std::vector<int>>& labelsExamples,
-                                        const SRMatrix& labels, const SRMatrix& features,
+                                        const IRMatrix& labels, const SRMatrix& features,
                                         bool norm, bool weightedFeatures, int threadId, int threads){
     int size = labelsExamples.size();
     for (int l = threadId; l < size; l += threads) {
@@ -76,7 +77,7 @@ void computeLabelsFeaturesMatrixThread(std::vector<std::vector<Feature>>& labels
     }
 }
 
-void computeLabelsFeaturesMatrix(SRMatrix& labelsFeatures, const SRMatrix& labels,
+void computeLabelsFeaturesMatrix(SRMatrix& labelsFeatures, const IRMatrix& labels,
                                  const SRMatrix& features, int threads, bool norm, bool weightedFeatures) {
     assert(features.rows() == labels.rows());
     Log(CERR) << "Computing labels' features matrix in " << threads << " threads ...\n";
@@ -158,10 +159,9 @@ void FileHelper::saveToFile(std::string outfile) {
 }
 
 void FileHelper::loadFromFile(std::string infile) {
-    checkFileName(infile);
-    std::ifstream in(infile, std::ios::in | std::ios::binary);
-    load(in);
-    in.close();
+    auto in = openInputStream(infile);
+    if (!in->good()) throw std::invalid_argument("Invalid filename: \"" + infile + "\"!");
+    load(*in);
 }
 
 // Checks filename
@@ -36,14 +36,14 @@
 #include "log.h"
 
 // Data utils
-std::vector<Prediction> computeLabelsPriors(const SRMatrix& labels);
+std::vector<Prediction> computeLabelsPriors(const IRMatrix& labels);
 
 void computeLabelsFeaturesMatrixThread(std::vector<std::vector<Feature>>& labelsFeatures,
                                        std::vector<std::vector<int>>& labelsExamples,
-                                       const SRMatrix& labels, const SRMatrix& features,
+                                       const IRMatrix& labels, const SRMatrix& features,
                                        bool norm, bool weightedFeatures, int threadId, int threads);
 
-void computeLabelsFeaturesMatrix(SRMatrix& labelsFeatures, const SRMatrix& labels,
+void computeLabelsFeaturesMatrix(SRMatrix& labelsFeatures, const IRMatrix& labels,
                                  const SRMatrix& features, int threads = 1, bool norm = false,
                                  bool weightedFeatures = false);
 
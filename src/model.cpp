@@ -20,14 +20,18 @@
  SOFTWARE.
  */
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iomanip>
 #include <mutex>
 #include <string>
 
 #include "ensemble.h"
+#include "linear.h"
 #include "log.h"
 #include "measure.h"
+#include "model_archive.h"
 #include "model.h"
 #include "threads.h"
 
@@ -64,7 +68,7 @@ std::shared_ptr<Model> Model::factory(Args& args) {
     return model;
 }
 
-Model::Model():preloaded(false), loaded(false), m(0), f(0) {}
+Model::Model():preloaded(false), loaded(false), m(0), f(0), weightsSize(0) {}
 
 Model::~Model() {
     unload();
@@ -73,23 +77,63 @@ Model::~Model() {
 void Model::predictBatchThread(int threadId, Model* model, std::vector<std::vector<Prediction>>& predictions,
                                SRMatrix& features, Args& args, const int startRow, const int stopRow) {
     const int batchSize = stopRow - startRow;
+    std::vector<IRVPair> pruned;
     for (int r = startRow; r < stopRow; ++r) {
         int i = r - startRow;
-        model->predict(predictions[r], features[r], args);
+        MetricScope scope(predictTime);
+        Metrics::count(predictedQueries);
+        model->predictPruned(predictions[r], features[r], args, pruned);
         if (!threadId) printProgress(i, batchSize);
     }
 }
 
+void Model::predictPruned(std::vector<Prediction>& prediction, SparseVector& features, Args& args, std::vector<IRVPair>& pruned) {
+    if (pruneFeatures(pruned, features)) {
+        SparseVector prunedFeatures(pruned);
+        predict(prediction, prunedFeatures, args);
+    } else predict(prediction, features, args);
+}
+
+void Model::findUsedFeatures(std::vector<Base*>& bases, Args& args) {
+    usedFeatures.clear();
+    weightsSize = 0;
+    for (auto b : bases)
+        if (b->getW() != nullptr) weightsSize = std::max(weightsSize, b->getW()->size());
+    if (!args.pruneQueryFeatures || args.resume) return; // Resumed models may get new weights
+
+    for (auto b : bases) {
+        auto W = b->getW();
+        if (W == nullptr) continue;
+        if (W->size() > usedFeatures.size()) usedFeatures.resize(W->size(), false);
+        W->forEachIV([&](const int& i, Real& v) {
+            if (v != 0) usedFeatures[i] = true;
+        });
+    }
+
+    int used = std::count(usedFeatures.begin(), usedFeatures.end(), true);
+    Log(CERR) << "  Features used by the model: " << used << "/" << usedFeatures.size() << "\n";
+}
+
+bool Model::pruneFeatures(std::vector<IRVPair>& pruned, SparseVector& features) {
+    if (usedFeatures.empty()) return false;
+
+    pruned.clear();
+    for (auto& f : features)
+        if (f.index < usedFeatures.size() && usedFeatures[f.index]) pruned.push_back(f);
+    return pruned.size() < features.nonZero();
+}
+
 std::vector<std::vector<Prediction>> Model::predictBatch(SRMatrix& features, Args& args) {
     Log(CERR) << "Starting prediction in " << args.threads << " threads ...\n";
 
     int rows = features.rows();
     std::vector<std::vector<Prediction>> predictions(rows);
 
-    // Run prediction in parallel using thread set
+    // Run prediction in parallel using thread set, small batches don't need all the threads
     ThreadSet tSet;
-    int tRows = ceil(static_cast<Real>(rows) / args.threads);
-    for (int t = 0; t < args.threads; ++t)
+    int threads = std::max(1, std::min(args.threads, rows));
+    int tRows = ceil(static_cast<Real>(rows) / threads);
+    for (int t = 0; t < threads; ++t)
         tSet.add(predictBatchThread, t, this, std::ref(predictions), std::ref(features), std::ref(args), t * tRows,
                  std::min((t + 1) * tRows, rows));
     tSet.joinAll();
@@ -97,6 +141,19 @@ std::vector<std::vector<Prediction>> Model::predictBatch(SRMatrix& features, Arg
     return predictions;
 }
 
+std::vector<std::vector<Prediction>> Model::predictDenseBatch(const Real* x, int rows, int dims, Args& args) {
+    SRMatrix features;
+    std::vector<IRVPair> row;
+    for (int r = 0; r < rows; ++r) {
+        const Real* xr = x + static_cast<size_t>(r) * dims;
+        row.clear();
+        for (int i = 1; i < dims; ++i)
+            if (xr[i] != 0) row.emplace_back(i, xr[i]);
+        features.appendRow(row);
+    }
+    return predictBatch(features, args);
+}
+
 void Model::setThresholds(std::vector<Real> th){
 //    if(th.size() != m)
 //        throw std::invalid_argument("Size of thresholds vector dose not match number of model outputs");
@@ -114,7 +171,7 @@ void Model::setLabelsWeights(std::vector<Real> lw){
     labelsWeights = lw;
 }
 
-Real Model::microOfo(SRMatrix& features, SRMatrix& labels, Args& args){
+Real Model::microOfo(SRMatrix& features, IRMatrix& labels, Args& args){
     Real a = args.ofoA;
     Real b = args.ofoB;
 
@@ -131,13 +188,8 @@ Real Model::microOfo(SRMatrix& features, SRMatrix& labels, Args& args){
         predict(prediction, features[r], args);
 
         // Update a and b counters
-        for (const auto &p : prediction) {
-            for (int l = -1; labels[r][l] > -1; ++l)
-                if (p.label == labels[r][l]) {
-                    a++;
-                    break;
-                }
-        }
+        for (const auto &p : prediction)
+            if (labels[r].contains(p.label)) a++;
 
         b += prediction.size() + labels.size(r);
     }
@@ -145,7 +197,7 @@ Real Model::microOfo(SRMatrix& features, SRMatrix& labels, Args& args){
     return a / b;
 }
 
-std::vector<Real> Model::macroOfo(SRMatrix& features, SRMatrix& labels, Args& args){
+std::vector<Real> Model::macroOfo(SRMatrix& features, IRMatrix& labels, Args& args){
     // Variables required for OFO
     std::vector<Real> as(m, args.ofoA);
     std::vector<Real> bs(m, args.ofoB);
@@ -169,7 +221,7 @@ std::vector<Real> Model::macroOfo(SRMatrix& features, SRMatrix& labels, Args& ar
 }
 
 void Model::macroOfoThread(int threadId, Model* model, std::vector<Real>& as, std::vector<Real>& bs,
-                      SRMatrix& features, SRMatrix& labels, Args& args, const int startRow, const int stopRow) {
+                      SRMatrix& features, IRMatrix& labels, Args& args, const int startRow, const int stopRow) {
 
     const int rowsRange = stopRow - startRow;
     const int examples = rowsRange * args.epochs;
@@ -214,7 +266,7 @@ void Model::macroOfoThread(int threadId, Model* model, std::vector<Real>& as, st
     }
 }
 
-std::vector<Real> Model::ofo(SRMatrix& features, SRMatrix& labels, Args& args) {
+std::vector<Real> Model::ofo(SRMatrix& features, IRMatrix& labels, Args& args) {
 
     args.topK = 0;
     args.threshold = 0;
@@ -242,19 +294,46 @@ std::vector<Real> Model::ofo(SRMatrix& features, SRMatrix& labels, Args& args) {
     return thresholds;
 }
 
+std::vector<Base*>& Model::getBases() {
+    throw std::invalid_argument(name + " model does not provide access to its base classifiers");
+}
+
 Base* Model::trainBase(ProblemData& problemsData, Args& args) {
     Base* base = new Base();
     base->train(problemsData, args);
     return base;
 }
 
-void Model::trainBatchThread(std::vector<std::promise<Base *>>& results, std::vector<ProblemData>& problemsData, Args& args, int threadId, int threads) {
+// Problems smaller than this are always trained in a single thread
+static const size_t minRowsPerThread = 10000;
+
+int Model::problemThreads(ProblemData& problemData, size_t remainingRows, Args& args) {
+    // Only primal Newton solvers can use more than one thread
+    if (args.threads <= 1 || args.optimizerType != liblinear ||
+        (args.solverType != L2R_LR && args.solverType != L2R_L2LOSS_SVC))
+        return 1;
+
+    // Give the problem threads proportional to its share in the remaining work
+    size_t rows = problemData.binLabels.size();
+    int threads = std::round(static_cast<double>(args.threads) * rows / std::max<size_t>(remainingRows, 1));
+    threads = std::min<int>(threads, rows / minRowsPerThread);
+    return std::max(1, std::min(threads, args.threads));
+}
+
+void Model::trainBatchThread(std::vector<std::promise<Base *>>& results, std::vector<ProblemData>& problemsData,
+                             std::vector<size_t>& remainingRows, std::atomic<int>& next, Args& args) {
     size_t size = problemsData.size();
-    for (int i = threadId; i < size; i += threads)
+    workspace* ws = create_workspace();
+    for (int i = next++; i < size; i = next++) {
+        problemsData[i].threads = problemThreads(problemsData[i], remainingRows[i], args);
+        problemsData[i].ws = ws;
         results[i].set_value(trainBase(problemsData[i], args));
+        problemsData[i].ws = NULL;
+    }
+    destroy_workspace(ws);
 }
 
-void Model::saveResults(std::ofstream& out, std::vector<std::future<Base*>>& results, bool saveGrads) {
+void Model::saveResults(std::ostream& out, std::vector<std::future<Base*>>& results, bool saveGrads) {
     for (int i = 0; i < results.size(); ++i) {
         printProgress(i, results.size());
         Base* base = results[i].get();
@@ -267,14 +346,125 @@ void Model::trainBases(std::string outfile, std::vector<ProblemData>& problemsDa
     std::ofstream out(outfile, std::ios::out | std::ios::binary);
     int size = problemsData.size();
     out.write((char*)&size, sizeof(size));
-    trainBases(out, problemsData, args);
+    auto warmStart = openWarmStart(args, size);
+    trainBases(out, problemsData, args, warmStart.get());
     out.close();
 }
 
-void Model::trainBases(std::ofstream& out, std::vector<ProblemData>& problemsData, Args& args) {
+std::unique_ptr<std::istream> Model::openWarmStart(Args& args, int size) {
+    if (args.warmStart.empty()) return nullptr;
+
+    std::string infile = joinPath(args.warmStart, "weights.bin");
+    auto in = openInputStream(infile);
+    if (!in->good()) throw std::invalid_argument("Cannot open warm start model's weights: " + infile);
+
+    // Bases are aligned by their position, so the previous model has to match
+    int warmSize;
+    in->read((char*)&warmSize, sizeof(warmSize));
+    if (warmSize != size) {
+        Log(CERR) << "Warning: Warm start model has " << warmSize << " base estimators instead of " << size
+                  << ", training from scratch!\n";
+        return nullptr;
+    }
+    return in;
+}
+
+col_problem* Model::transposeProblems(std::vector<ProblemData>& problemsData) {
+    // Rows of the problems point to the same training data, so all of them are transposed once
+    std::vector<Feature*> rows;
+    int n = 0;
+    for (auto& pd : problemsData) {
+        rows.insert(rows.end(), pd.binFeatures.begin(), pd.binFeatures.end());
+        n = std::max(n, pd.n);
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    Log(CERR) << "Transposing " << rows.size() << " rows shared by base estimators ...\n";
+    col_problem* cols = transpose_rows(reinterpret_cast<feature_node**>(rows.data()), rows.size(), n);
+    for (auto& pd : problemsData) pd.sharedColumns = cols;
+    return cols;
+}
+
+// Fowler–Noll–Vo hash of row's features
+static uint64_t rowHash(const Feature* row) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const Feature* f = row; f->index != -1; ++f) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(f);
+        for (size_t i = 0; i < sizeof(Feature); ++i) {
+            h ^= bytes[i];
+            h *= 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+static bool rowLess(const Feature* a, const Feature* b) {
+    for (; a->index != -1 && b->index != -1; ++a, ++b) {
+        if (a->index != b->index) return a->index < b->index;
+        if (a->value != b->value) return a->value < b->value;
+    }
+    return a->index == -1 && b->index != -1;
+}
+
+void Model::findDuplicateRows(UnorderedMap<Feature*, Feature*>& duplicateRows, std::vector<ProblemData>& problemsData) {
+    // Rows of the problems point to the same training data, rows with identical features are found once for all of them
+    std::vector<Feature*> rows;
+    for (auto& pd : problemsData) rows.insert(rows.end(), pd.binFeatures.begin(), pd.binFeatures.end());
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    std::vector<std::pair<uint64_t, Feature*>> hashedRows;
+    hashedRows.reserve(rows.size());
+    for (auto r : rows) hashedRows.emplace_back(rowHash(r), r);
+    rows.clear();
+    rows.shrink_to_fit();
+    std::sort(hashedRows.begin(), hashedRows.end(), [](const std::pair<uint64_t, Feature*>& a, const std::pair<uint64_t, Feature*>& b) {
+        if (a.first != b.first) return a.first < b.first;
+        if (rowLess(a.second, b.second)) return true;
+        if (rowLess(b.second, a.second)) return false;
+        return a.second < b.second;
+    });
+
+    // Every row is mapped to the first one with the same features
+    duplicateRows.clear();
+    for (size_t i = 1, first = 0; i < hashedRows.size(); ++i) {
+        if (hashedRows[i].first == hashedRows[first].first && !rowLess(hashedRows[first].second, hashedRows[i].second))
+            duplicateRows[hashedRows[i].second] = hashedRows[first].second;
+        else first = i;
+    }
+
+    Log(CERR) << "Found " << duplicateRows.size() << " duplicated rows out of " << hashedRows.size() << " rows\n";
+    if (!duplicateRows.empty())
+        for (auto& pd : problemsData) pd.duplicateRows = &duplicateRows;
+}
+
+void Model::trainBases(std::ostream& out, std::vector<ProblemData>& problemsData, Args& args, std::istream* warmStart) {
+    ProfilerPhase phase("train bases");
 
     size_t size = problemsData.size(); // This "batch" size
+
+    // Previous bases of this batch, only liblinear can start from them
+    std::vector<Base*> initBases;
+    if (warmStart && args.optimizerType == liblinear) {
+        Log(CERR) << "Loading " << size << " base estimators for warm start ...\n";
+        initBases.reserve(size);
+        for (int i = 0; i < size && warmStart->peek() != EOF; ++i) {
+            initBases.push_back(new Base());
+            initBases.back()->load(*warmStart, false, sparse);
+            problemsData[i].initBase = initBases.back();
+        }
+    }
+
     Log(CERR) << "Starting training " << size << " base estimators in " << args.threads << " threads ...\n";
+
+    col_problem* sharedColumns = nullptr;
+    if (args.sharedColumns && args.optimizerType == liblinear && (args.solverType == L1R_LR || args.solverType == L1R_L2LOSS_SVC))
+        sharedColumns = transposeProblems(problemsData);
+
+    UnorderedMap<Feature*, Feature*> duplicateRows;
+    if (args.deduplicate && args.optimizerType == liblinear)
+        findDuplicateRows(duplicateRows, problemsData);
     //Log(CERR) << "  Required memory: " << formatMem(args.threads * args.threads * n * sizeof(Real)) << "\n";
 
     // Run learning in parallel
@@ -284,8 +474,15 @@ void Model::trainBases(std::ofstream& out, std::vector<ProblemData>& problemsDat
         std::vector<std::promise<Base *>> resultsPromise(size);
         std::vector<std::future<Base *>> results(size);
         for(int i = 0; i < size; ++i) results[i] = resultsPromise[i].get_future();
+
+        // Problems are taken in order, the number of rows left from each one decides how many threads it gets
+        std::vector<size_t> remainingRows(size + 1, 0);
+        for(int i = static_cast<int>(size) - 1; i >= 0; --i)
+            remainingRows[i] = remainingRows[i + 1] + problemsData[i].binLabels.size();
+        std::atomic<int> next(0);
         for (int t = 0; t < args.threads; ++t)
-            tSet.add(trainBatchThread, std::ref(resultsPromise), std::ref(problemsData), args, t, args.threads);
+            tSet.add(trainBatchThread, std::ref(resultsPromise), std::ref(problemsData), std::ref(remainingRows),
+                     std::ref(next), args);
 
         // Thread pool solution is slower
         /*
@@ -301,12 +498,48 @@ void Model::trainBases(std::ofstream& out, std::vector<ProblemData>& problemsDat
         saveResults(out, results, args.saveGrads);
         tSet.joinAll();
     } else {
+        workspace* ws = create_workspace();
         for (int i = 0; i < size; ++i){
             Base* base = new Base();
+            problemsData[i].ws = ws;
             base->train(problemsData[i], args);
+            problemsData[i].ws = NULL;
             base->save(out, args.saveGrads);
             delete base;
         }
+        destroy_workspace(ws);
+    }
+
+    for (auto& pd : problemsData) pd.duplicateRows = NULL;
+
+    if (sharedColumns) {
+        for (auto& pd : problemsData) pd.sharedColumns = NULL;
+        free_col_problem(sharedColumns);
+    }
+
+    for (int i = 0; i < initBases.size(); ++i) {
+        problemsData[i].initBase = NULL;
+        delete initBases[i];
+    }
+
+    if (args.hybrid && args.optimizerType == liblinear) {
+        // Summary of each optimizer's share of the problems
+        Log(CERR) << "Hybrid training:\n";
+        for (auto optimizer : {liblinear, adagrad}) {
+            int count = 0;
+            double time = 0;
+            Real loss = 0;
+            for (const auto &pd : problemsData) {
+                if (pd.optimizer != optimizer || pd.binLabels.empty()) continue;
+                ++count;
+                time += pd.trainTime;
+                loss += pd.loss;
+            }
+            Log(CERR) << "  " << (optimizer == liblinear ? "liblinear" : "AdaGrad") << ": " << count
+                      << " base estimators, train time (s): " << time;
+            if (args.reportLoss && count) Log(CERR) << ", mean node loss: " << loss / count;
+            Log(CERR) << "\n";
+        }
     }
 
     if(args.reportLoss){
@@ -324,6 +557,14 @@ void Model::trainBases(std::ofstream& out, std::vector<ProblemData>& problemsDat
     }
 }
 
+void Model::saveBases(std::string outfile, std::vector<Base*>& bases, bool saveGrads, const VectorCoding& coding) {
+    std::ofstream out(outfile, std::ios::out | std::ios::binary);
+    int size = bases.size();
+    out.write((char*)&size, sizeof(size));
+    for (auto& b : bases) b->save(out, saveGrads, coding);
+    out.close();
+}
+
 std::vector<Base*> Model::loadBases(std::string infile, bool resume, RepresentationType loadAs) {
     Log(CERR) << "Loading base estimators ...\n";
 
@@ -332,21 +573,20 @@ std::vector<Base*> Model::loadBases(std::string infile, bool resume, Representat
     int sparse = 0;
 
     std::vector<Base*> bases;
-    std::ifstream in(infile, std::ios::in | std::ios::binary);
+    auto in = openInputStream(infile);
     int size;
-    in.read((char*)&size, sizeof(size));
+    in->read((char*)&size, sizeof(size));
     bases.reserve(size);
     for (int i = 0; i < size; ++i) {
         printProgress(i, size);
         auto b = new Base();
-        b->load(in, resume, loadAs);
+        b->load(*in, resume, loadAs);
 
         if(b->getW() != nullptr) nonZeroSum += b->getW()->nonZero();
         memSize += b->mem();
         if(b->getType() != dense) ++sparse;
         bases.push_back(b);
     }
-    in.close();
 
     Log(CERR) << "  Loaded bases: " << size
               << "\n  Bases size: " << formatMem(memSize) << "\n  Non zero weights / bases: " << nonZeroSum / size
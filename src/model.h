@@ -23,14 +23,18 @@
 
 #pragma once
 
+#include <atomic>
 #include <fstream>
 #include <future>
+#include <memory>
 #include <string>
 
 #include "args.h"
 #include "base.h"
 #include "basic_types.h"
+#include "metrics.h"
 #include "misc.h"
+#include "profiler.h"
 
 class Model {
 public:
@@ -39,10 +43,17 @@ public:
     Model();
     virtual ~Model();
 
-    virtual void train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) = 0;
+    virtual void train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) = 0;
     virtual void predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) = 0;
     virtual Real predictForLabel(Label label, SparseVector& features, Args& args) = 0;
     virtual std::vector<std::vector<Prediction>> predictBatch(SRMatrix& features, Args& args);
+    // Prediction for queries given as dense rows of x with dims features, indexed like the sparse features (index 1 is the bias),
+    // models without dense scoring predict for the rows converted to the sparse ones
+    virtual std::vector<std::vector<Prediction>> predictDenseBatch(const Real* x, int rows, int dims, Args& args);
+    // Removes features unused by the model before prediction, pruned is a buffer for them
+    void predictPruned(std::vector<Prediction>& prediction, SparseVector& features, Args& args, std::vector<IRVPair>& pruned);
+    // Has to be called after the weights of the bases are changed in place
+    void updateUsedFeatures(Args& args) { findUsedFeatures(getBases(), args); }
 
     // Prediction with thresholds and ofo
     virtual void setThresholds(std::vector<Real> th);
@@ -52,9 +63,9 @@ public:
     virtual void setLabelsWeights(std::vector<Real> lw);
     std::vector<Real> getLabelsWeights(){ return labelsWeights; };
 
-    std::vector<Real> ofo(SRMatrix& features, SRMatrix& labels, Args& args);
-    Real microOfo(SRMatrix& features, SRMatrix& labels, Args& args);
-    std::vector<Real> macroOfo(SRMatrix& features, SRMatrix& labels, Args& args);
+    std::vector<Real> ofo(SRMatrix& features, IRMatrix& labels, Args& args);
+    Real microOfo(SRMatrix& features, IRMatrix& labels, Args& args);
+    std::vector<Real> macroOfo(SRMatrix& features, IRMatrix& labels, Args& args);
 
     virtual void load(Args& args, std::string infile) = 0;
     virtual void preload(Args& args, std::string infile) { preloaded = true; };
@@ -65,6 +76,12 @@ public:
     virtual void printInfo() {}
     inline int outputSize() { return m; };
 
+    // Base classifiers of the model, throws for models that do not keep them in a single list,
+    // the list of extremeText is empty, it uses node vectors instead of bases
+    virtual std::vector<Base*>& getBases();
+    static void saveBases(std::string outfile, std::vector<Base*>& bases, bool saveGrads=false,
+                          const VectorCoding& coding=VectorCoding());
+
 protected:
     ModelType type;
     std::string name;
@@ -74,14 +91,26 @@ protected:
     bool loaded;
     std::vector<Real> thresholds; // For prediction with thresholds
     std::vector<Real> labelsWeights; // For prediction with label weights
+    std::vector<bool> usedFeatures; // Features with non-zero weights in any base, empty if queries are not pruned
+    size_t weightsSize; // The largest size of the weights of the bases
+
+    // Also updates weightsSize
+    void findUsedFeatures(std::vector<Base*>& bases, Args& args);
+    bool pruneFeatures(std::vector<IRVPair>& pruned, SparseVector& features);
 
     // Base utils
     static Base* trainBase(ProblemData& problemsData, Args& args);
-    static void trainBatchThread(std::vector<std::promise<Base *>>& results, std::vector<ProblemData>& problemsData, Args& args, int threadId, int threads);
+    static void trainBatchThread(std::vector<std::promise<Base *>>& results, std::vector<ProblemData>& problemsData,
+                                 std::vector<size_t>& remainingRows, std::atomic<int>& next, Args& args);
+    static int problemThreads(ProblemData& problemData, size_t remainingRows, Args& args);
+    static col_problem* transposeProblems(std::vector<ProblemData>& problemsData);
+    static void findDuplicateRows(UnorderedMap<Feature*, Feature*>& duplicateRows, std::vector<ProblemData>& problemsData);
     static void trainBases(std::string outfile, std::vector<ProblemData>& problemsData, Args& args);
-    static void trainBases(std::ofstream& out, std::vector<ProblemData>& problemsData, Args& args);
+    static void trainBases(std::ostream& out, std::vector<ProblemData>& problemsData, Args& args,
+                           std::istream* warmStart = nullptr);
+    static std::unique_ptr<std::istream> openWarmStart(Args& args, int size);
 
-    static void saveResults(std::ofstream& out, std::vector<std::future<Base*>>& results, bool saveGrads=false);
+    static void saveResults(std::ostream& out, std::vector<std::future<Base*>>& results, bool saveGrads=false);
     static std::vector<Base*> loadBases(std::string infile, bool resume=false, RepresentationType loadAs=map);
 
 private:
@@ -89,6 +118,6 @@ private:
                                    SRMatrix& features, Args& args, const int startRow, const int stopRow);
 
     static void macroOfoThread(int threadId, Model* model, std::vector<Real>& as, std::vector<Real>& bs,
-                               SRMatrix& features, SRMatrix& labels, Args& args,
+                               SRMatrix& features, IRMatrix& labels, Args& args,
                                const int startRow, const int stopRow);
 };
@@ -0,0 +1,245 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#include "misc.h"
+#include "model_archive.h"
+#include "save_load.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define fdRead read
+#define fdWrite write
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#define fdRead _read
+#define fdWrite _write
+#endif
+
+
+MemoryStreamBuf::MemoryStreamBuf(const char* data, size_t size) {
+    char* begin = const_cast<char*>(data); // Buffer is only read
+    setg(begin, begin, begin + size);
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+    char* pos;
+    if (dir == std::ios_base::beg) pos = eback() + off;
+    else if (dir == std::ios_base::cur) pos = gptr() + off;
+    else pos = egptr() + off;
+
+    if (pos < eback() || pos > egptr()) return pos_type(off_type(-1));
+    setg(eback(), pos, egptr());
+    return pos_type(pos - eback());
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+// Files of the opened archives, accessed by their virtual paths
+struct MemoryFile {
+    const char* data;
+    size_t size;
+};
+
+static std::mutex archivesMtx;
+static std::unordered_map<std::string, MemoryFile> archivesFiles;
+static int archivesCount = 0;
+static const uint32_t archiveMagic = 0x4e584331; // "NXC1"
+
+std::unique_ptr<std::istream> openInputStream(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(archivesMtx);
+        auto f = archivesFiles.find(path);
+        if (f != archivesFiles.end()) return std::make_unique<MemoryIStream>(f->second.data, f->second.size);
+    }
+    return std::make_unique<std::ifstream>(path, std::ios::in | std::ios::binary);
+}
+
+void ModelArchive::pack(const std::string& dir, std::ostream& out) {
+    std::vector<std::filesystem::path> paths;
+    for (const auto& e : std::filesystem::recursive_directory_iterator(dir))
+        if (e.is_regular_file()) paths.push_back(e.path());
+    std::sort(paths.begin(), paths.end());
+
+    uint32_t magic = archiveMagic;
+    int fileCount = paths.size();
+    saveVar(out, magic);
+    saveVar(out, fileCount);
+
+    std::vector<char> buffer;
+    for (const auto& p : paths) {
+        std::string name = std::filesystem::relative(p, dir).generic_string();
+        size_t size = std::filesystem::file_size(p);
+        saveVar(out, name);
+        saveVar(out, size);
+
+        buffer.resize(size);
+        std::ifstream in(p, std::ios::in | std::ios::binary);
+        in.read(buffer.data(), size);
+        out.write(buffer.data(), size);
+    }
+}
+
+std::string ModelArchive::pack(const std::string& dir) {
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    pack(dir, out);
+    return out.str();
+}
+
+void ModelArchive::pack(const std::string& dir, int fd) {
+    std::string data = pack(dir);
+    size_t written = 0;
+    while (written < data.size()) {
+        auto n = fdWrite(fd, data.data() + written, data.size() - written);
+        if (n <= 0) throw std::runtime_error("Failed to write the model archive to the file descriptor");
+        written += n;
+    }
+}
+
+ModelArchive::ModelArchive(const char* data, size_t size) {
+    open(data, size);
+}
+
+ModelArchive::ModelArchive(int fd) {
+    const size_t chunkSize = 1 << 20;
+    size_t size = 0;
+    while (true) {
+        ownedData.resize(size + chunkSize);
+        auto n = fdRead(fd, ownedData.data() + size, chunkSize);
+        if (n < 0) throw std::runtime_error("Failed to read the model archive from the file descriptor");
+        if (n == 0) break;
+        size += n;
+    }
+    ownedData.resize(size);
+    open(ownedData.data(), size);
+}
+
+ModelArchive::ModelArchive(const std::string& path) {
+#if defined(__linux__) || defined(__APPLE__)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Failed to open the model archive: " + path);
+    size_t size = std::filesystem::file_size(path);
+    void* data = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) throw std::runtime_error("Failed to map the model archive: " + path);
+    mappedData = data;
+    mappedSize = size;
+    try {
+        open(static_cast<const char*>(data), size);
+    } catch (...) {
+        munmap(mappedData, mappedSize);
+        throw;
+    }
+#else
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in) throw std::runtime_error("Failed to open the model archive: " + path);
+    ownedData.resize(std::filesystem::file_size(path));
+    in.read(ownedData.data(), ownedData.size());
+    open(ownedData.data(), ownedData.size());
+#endif
+}
+
+ModelArchive::~ModelArchive() {
+    {
+        std::lock_guard<std::mutex> lock(archivesMtx);
+        for (const auto& f : files) archivesFiles.erase(f);
+    }
+#if defined(__linux__) || defined(__APPLE__)
+    if (mappedData != nullptr) munmap(mappedData, mappedSize);
+#endif
+}
+
+bool ModelArchive::isArchive(const std::string& path) {
+    if (!std::filesystem::is_regular_file(path)) return false;
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    uint32_t magic = 0;
+    loadVar(in, magic);
+    return in && magic == archiveMagic;
+}
+
+void ModelArchive::open(const char* data, size_t size) {
+    archiveData = data;
+    archiveSize = size;
+    const char* end = data + size;
+    // Sizes come from the data, they are compared with the remaining length, so they can't overflow the pointer
+    auto check = [&](size_t varSize) {
+        if (varSize > static_cast<size_t>(end - data)) throw std::invalid_argument("Invalid model archive");
+    };
+    auto read = [&](void* var, size_t varSize) {
+        check(varSize);
+        std::memcpy(var, data, varSize);
+        data += varSize;
+    };
+
+    uint32_t magic;
+    int fileCount;
+    read(&magic, sizeof(magic));
+    if (magic != archiveMagic) throw std::invalid_argument("Invalid model archive");
+    read(&fileCount, sizeof(fileCount));
+
+    std::vector<std::pair<std::string, MemoryFile>> archiveFiles;
+    for (int i = 0; i < fileCount; ++i) {
+        size_t nameSize, fileSize;
+        read(&nameSize, sizeof(nameSize));
+        check(nameSize);
+        std::string name(data, nameSize);
+        data += nameSize;
+        read(&fileSize, sizeof(fileSize));
+        check(fileSize);
+        archiveFiles.push_back({name, {data, fileSize}});
+        data += fileSize;
+    }
+
+    // Register files only when the whole archive is valid
+    std::lock_guard<std::mutex> lock(archivesMtx);
+    dir = "mem://archive_" + std::to_string(archivesCount++);
+    for (const auto& f : archiveFiles) {
+        files.push_back(joinPath(dir, f.first));
+        archivesFiles[files.back()] = f.second;
+    }
+}
+
+void ModelArchive::unpack(const std::string& outDir) {
+    std::lock_guard<std::mutex> lock(archivesMtx);
+    for (const auto& f : files) {
+        auto outFile = std::filesystem::path(outDir) / f.substr(dir.size() + 1);
+        makeDir(outFile.parent_path().string());
+        std::ofstream out(outFile, std::ios::out | std::ios::binary);
+        auto& mf = archivesFiles[f];
+        out.write(mf.data, mf.size);
+    }
+}
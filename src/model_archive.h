@@ -0,0 +1,93 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// Read-only stream buffer over a memory region, allows to read data without copying it
+class MemoryStreamBuf : public std::streambuf {
+public:
+    MemoryStreamBuf(const char* data, size_t size);
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+};
+
+class MemoryIStream : public std::istream {
+public:
+    MemoryIStream(const char* data, size_t size): std::istream(nullptr), buf(data, size) { rdbuf(&buf); }
+
+private:
+    MemoryStreamBuf buf;
+};
+
+// Opens file for reading, files from loaded model archives are read directly from the memory
+std::unique_ptr<std::istream> openInputStream(const std::string& path);
+
+
+// Whole model directory in a single buffer, the layout is:
+// magic number, number of files, and for every file: its path relative to the model directory, size and content
+class ModelArchive {
+public:
+    static void pack(const std::string& dir, std::ostream& out);
+    static std::string pack(const std::string& dir);
+    static void pack(const std::string& dir, int fd);
+
+    // The buffer is used without copying, so it has to outlive the archive
+    ModelArchive(const char* data, size_t size);
+    // Reads the whole content of the file descriptor
+    explicit ModelArchive(int fd);
+    // Maps the archive file into the memory (reads it on systems without mmap)
+    explicit ModelArchive(const std::string& path);
+    ~ModelArchive();
+
+    ModelArchive(const ModelArchive&) = delete;
+    ModelArchive& operator=(const ModelArchive&) = delete;
+
+    // Virtual directory of the model, it can be used as a model path (e.g. args.output) to load the model
+    inline const std::string& getDir() const { return dir; }
+    inline const char* data() const { return archiveData; }
+    inline size_t size() const { return archiveSize; }
+
+    void unpack(const std::string& outDir);
+
+    // Checks if the path is a regular file with the archive magic number
+    static bool isArchive(const std::string& path);
+
+private:
+    std::string dir;
+    const char* archiveData;
+    size_t archiveSize;
+    std::vector<std::string> files;
+    std::vector<char> ownedData;
+    void* mappedData = nullptr;
+    size_t mappedSize = 0;
+
+    void open(const char* data, size_t size);
+};
@@ -43,7 +43,7 @@ void BR::unload() {
 }
 
 void BR::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vector<Feature*>& binFeatures, std::vector<Real>& binWeights,
-                          SRMatrix& labels, SRMatrix& features, int rStart, int rStop, Args& args){
+                          IRMatrix& labels, SRMatrix& features, int rStart, int rStop, Args& args){
     int rows = labels.rows();
 
     binWeights.resize(rows, 1);
@@ -58,7 +58,7 @@ void BR::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vector
     }
 }
 
-void BR::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
+void BR::train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
     int lCols = labels.cols();
     int parts = calculateNumberOfParts(labels, features, args);
     int range = lCols / parts + 1;
@@ -72,6 +72,7 @@ void BR::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string out
 
     std::ofstream out(joinPath(output, "weights.bin"), std::ios::out | std::ios::binary);
     saveVar(out, lCols);
+    auto warmStart = openWarmStart(args, lCols);
 
     for (int p = 0; p < parts; ++p) {
         int rStart = p * range;
@@ -84,7 +85,11 @@ void BR::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string out
 
         for (auto &bl: binLabels) std::fill(bl.begin(), bl.end(), 0);
 
-        assignDataPoints(binLabels, binFeatures, binWeights, labels, features, rStart, rStop, args);
+        {
+            MetricScope scope(assignTime);
+            ProfilerPhase phase("assign data points");
+            assignDataPoints(binLabels, binFeatures, binWeights, labels, features, rStart, rStop, args);
+        }
 
         unsigned long long usedMem = binFeatures.size() * ((range + 1) * sizeof(Real) + sizeof(void*));
         Log(CERR) << "  Temporary data size: " << formatMem(usedMem) << "\n";
@@ -97,7 +102,7 @@ void BR::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string out
             for (int i = 0; i < range; ++i) binProblemData[i].invPs = labelsWeights[i + rStart];
         }
 
-        trainBases(out, binProblemData, args);
+        trainBases(out, binProblemData, args, warmStart.get());
 
         for (auto& l : binLabels) l.clear();
         binFeatures.clear();
@@ -110,7 +115,10 @@ void BR::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string out
 
 void BR::predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) {
     prediction = predictForAllLabels(features, args);
+    processPrediction(prediction, args);
+}
 
+void BR::processPrediction(std::vector<Prediction>& prediction, Args& args) {
     if(!labelsWeights.empty())
         for(auto &p : prediction) p.value *= labelsWeights[p.label];
 
@@ -133,6 +141,73 @@ void BR::predict(std::vector<Prediction>& prediction, SparseVector& features, Ar
     prediction.shrink_to_fit();
 }
 
+std::vector<std::vector<Prediction>> BR::predictBatch(SRMatrix& features, Args& args) {
+    // OVR and the other subclasses normalize the values of all labels, they use the per query prediction
+    if (args.denseFeatures <= 0 || type != br) return Model::predictBatch(features, args);
+    return predictDense(&features, nullptr, features.rows(), args.denseFeatures + 2, args); // Features are shifted by 2
+}
+
+std::vector<std::vector<Prediction>> BR::predictDenseBatch(const Real* x, int rows, int dims, Args& args) {
+    if (type != br) return Model::predictDenseBatch(x, rows, dims, args);
+    return predictDense(nullptr, x, rows, dims, args);
+}
+
+std::vector<std::vector<Prediction>> BR::predictDense(SRMatrix* features, const Real* x, int rows, int dims, Args& args) {
+    Log(CERR) << "Starting prediction with " << dims - 2 << " dense features in " << args.threads << " threads ...\n";
+
+    std::vector<std::vector<Prediction>> predictions(rows);
+
+    ThreadSet tSet;
+    int threads = std::max(1, std::min(args.threads, rows));
+    int tRows = ceil(static_cast<Real>(rows) / threads);
+    for (int t = 0; t < threads; ++t)
+        tSet.add(predictDenseBatchThread, t, this, std::ref(predictions), features, x, dims, std::ref(args), t * tRows,
+                 std::min((t + 1) * tRows, rows));
+    tSet.joinAll();
+
+    return predictions;
+}
+
+void BR::predictDenseBatchThread(int threadId, BR* model, std::vector<std::vector<Prediction>>& predictions,
+                                 SRMatrix* features, const Real* x, int dims, Args& args,
+                                 const int startRow, const int stopRow) {
+    // Queries are scored in blocks, for each base its weights are read once per block instead of once per query
+    const int blockSize = 16;
+    auto& bases = model->bases;
+
+    // Dense rows are scored in place, sparse rows are copied to the block
+    std::vector<Real> block(features ? blockSize * dims : 0);
+    Feature emptyTail(-1, 0);
+    std::vector<Feature*> tails(blockSize, &emptyTail);
+    std::vector<Real> values(blockSize);
+
+    for (int r = startRow; r < stopRow; r += blockSize) {
+        int count = std::min(blockSize, stopRow - r);
+
+        // Copy the dense part of the rows to the block, the rest of each row is left as a sparse tail
+        const Real* blockX;
+        if (features) {
+            std::fill(block.begin(), block.end(), 0);
+            for (int q = 0; q < count; ++q) {
+                Feature* f = (*features)[r + q].data();
+                for (; f->index != -1 && f->index < dims; ++f) block[q * dims + f->index] = f->value;
+                tails[q] = f;
+            }
+            blockX = block.data();
+        } else blockX = x + static_cast<size_t>(r) * dims;
+        for (int q = 0; q < count; ++q) predictions[r + q].reserve(bases.size());
+
+        for (int i = 0; i < bases.size(); ++i) {
+            bases[i]->predictValues(values.data(), blockX, dims, tails.data(), count);
+            for (int q = 0; q < count; ++q) predictions[r + q].emplace_back(i, bases[i]->probability(values[q]));
+        }
+
+        for (int q = 0; q < count; ++q) model->processPrediction(predictions[r + q], args);
+        Metrics::count(predictedQueries, count);
+        if (!threadId) printProgress(r - startRow, stopRow - startRow);
+    }
+}
+
 std::vector<Prediction> BR::predictForAllLabels(SparseVector& features, Args& args) {
     std::vector<Prediction> prediction;
     prediction.reserve(bases.size());
@@ -149,6 +224,7 @@ Real BR::predictForLabel(Label label, SparseVector& features, Args& args) {
 void BR::load(Args& args, std::string infile) {
     Log(CERR) << "Loading weights ...\n";
     bases = loadBases(joinPath(infile, "weights.bin"), args.resume, args.loadAs);
+    findUsedFeatures(bases, args);
     m = bases.size();
 
     loaded = true;
@@ -159,24 +235,37 @@ void BR::printInfo() {
               << "\n  Mean # estimators per data point: " << bases.size() << "\n";
 }
 
-size_t BR::calculateNumberOfParts(SRMatrix& labels, SRMatrix& features, Args& args){
-    int rows = features.rows();
-    int lCols = labels.cols();
-    int lCells = labels.cells();
-
+size_t BR::calculateNumberOfParts(IRMatrix& labels, SRMatrix& features, Args& args){
     // Calculate required memory
     // Size of required data
     unsigned long long dataMem = labels.mem() + features.mem();
-    unsigned long long tmpDataMem = 0;
-    if(args.modelType == ovr && args.pickOneLabelWeighting)
-        tmpDataMem = lCells * ((lCols + 1) * sizeof(Real) + sizeof(void*));
-    else tmpDataMem = rows * ((lCols + 1) * sizeof(Real) + sizeof(void*));
-    unsigned long long baseMem = 4 * args.threads * features.cols() * sizeof(Real);
+    unsigned long long tmpDataMem = estimateTmpDataMem(features.rows(), labels.cols(), labels.cells(), args);
+    unsigned long long baseMem = estimateBaseMem(features.cols(), args);
     unsigned long long reqMem = tmpDataMem + dataMem + baseMem;
     //Log(CERR) << "Required memory to train: " << formatMem(reqMem) << ", available memory: " << formatMem(args.memLimit) << "\n";
     Log(CERR) << "Required memory to train: " << formatMem(reqMem) << " (data: " << formatMem(dataMem)
               << ", weights: " << formatMem(baseMem) << ", tmp data: " << formatMem(tmpDataMem) << "), available memory: " << formatMem(args.memLimit) << "\n";
 
-    size_t parts = tmpDataMem / (args.memLimit - dataMem - baseMem) + 1;
+    size_t parts = calculateNumberOfParts(dataMem, tmpDataMem, baseMem, labels.cols(), args);
+    if (dataMem + baseMem >= args.memLimit)
+        Log(CERR) << "Warning: Data and base estimators do not fit in the memory limit, training one label at a time!\n";
     return parts;
 }
+
+unsigned long long BR::estimateTmpDataMem(int rows, int lCols, long long lCells, Args& args) {
+    if(args.modelType == ovr && args.pickOneLabelWeighting)
+        return lCells * ((lCols + 1) * sizeof(Real) + sizeof(void*));
+    return static_cast<unsigned long long>(rows) * ((lCols + 1) * sizeof(Real) + sizeof(void*));
+}
+
+unsigned long long BR::estimateBaseMem(int fCols, Args& args) {
+    return 4ULL * args.threads * fCols * sizeof(Real);
+}
+
+size_t BR::calculateNumberOfParts(unsigned long long dataMem, unsigned long long tmpDataMem,
+                                  unsigned long long baseMem, int lCols, Args& args) {
+    // Without any memory left for the temporary data, train one label at a time
+    if (dataMem + baseMem >= args.memLimit) return std::max(lCols, 1);
+    size_t parts = tmpDataMem / (args.memLimit - dataMem - baseMem) + 1;
+    return std::min<size_t>(parts, std::max(lCols, 1));
+}
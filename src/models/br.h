@@ -30,21 +30,37 @@ class BR : public Model {
 public:
     BR();
 
-    void train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
+    void train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
     void predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) override;
+    std::vector<std::vector<Prediction>> predictBatch(SRMatrix& features, Args& args) override;
+    std::vector<std::vector<Prediction>> predictDenseBatch(const Real* x, int rows, int dims, Args& args) override;
     Real predictForLabel(Label label, SparseVector& features, Args& args) override;
 
     void load(Args& args, std::string infile) override;
     void unload() override;
 
     void printInfo() override;
+    std::vector<Base*>& getBases() override { return bases; };
+
+    // Memory required to train, also used by the planner
+    static unsigned long long estimateTmpDataMem(int rows, int lCols, long long lCells, Args& args);
+    static unsigned long long estimateBaseMem(int fCols, Args& args);
+    static size_t calculateNumberOfParts(unsigned long long dataMem, unsigned long long tmpDataMem,
+                                         unsigned long long baseMem, int lCols, Args& args);
 
 protected:
     std::vector<Base*> bases;
     virtual void assignDataPoints(std::vector<std::vector<Real>>& binLabels,
                                   std::vector<Feature*>& binFeatures,
                                   std::vector<Real>& binWeights,
-                                  SRMatrix& labels, SRMatrix& features, int rStart, int rStop, Args& args);
+                                  IRMatrix& labels, SRMatrix& features, int rStart, int rStop, Args& args);
     virtual std::vector<Prediction> predictForAllLabels(SparseVector& features, Args& args);
-    static size_t calculateNumberOfParts(SRMatrix& labels, SRMatrix& features, Args& args);
+    void processPrediction(std::vector<Prediction>& prediction, Args& args);
+    static size_t calculateNumberOfParts(IRMatrix& labels, SRMatrix& features, Args& args);
+
+private:
+    std::vector<std::vector<Prediction>> predictDense(SRMatrix* features, const Real* x, int rows, int dims, Args& args);
+    static void predictDenseBatchThread(int threadId, BR* model, std::vector<std::vector<Prediction>>& predictions,
+                                        SRMatrix* features, const Real* x, int dims, Args& args,
+                                        const int startRow, const int stopRow);
 };
@@ -21,6 +21,7 @@
  */
 
 #include "extreme_text.h"
+#include "model_archive.h"
 #include "threads.h"
 
 
@@ -29,7 +30,7 @@ ExtremeText::ExtremeText() {
     name = "extremeText";
 }
 
-void ExtremeText::trainThread(int threadId, ExtremeText* model, SRMatrix& labels,
+void ExtremeText::trainThread(int threadId, ExtremeText* model, IRMatrix& labels,
                                     SRMatrix& features, Args& args, const int startRow, const int stopRow) {
     const int rowsRange = stopRow - startRow;
     const int examples = rowsRange * args.epochs;
@@ -60,7 +61,7 @@ Real ExtremeText::updateNode(TreeNode* node, Real label, Vector& hidden, Vector&
     return label ? -log(pred) : -log(1.0 - pred);
 }
 
-Real ExtremeText::update(Real lr, const SparseVector& features, const SparseVector& labels, const Args& args){
+Real ExtremeText::update(Real lr, const SparseVector& features, const IndexVector& labels, const Args& args){
 
     // Compute hidden
     Real valuesSum = 0;
@@ -95,7 +96,7 @@ Real ExtremeText::update(Real lr, const SparseVector& features, const SparseVect
     return loss;
 }
 
-void ExtremeText::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
+void ExtremeText::train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
 
     // Create tree
     if (!tree) {
@@ -141,10 +142,9 @@ void ExtremeText::load(Args& args, std::string infile) {
     tree = new LabelTree();
     tree->loadFromFile(joinPath(infile, "tree.bin"));
 
-    std::ifstream in(joinPath(infile, "XTWeights.bin"));
-    inputW.load(in);
-    outputW.load(in);
-    in.close();
+    auto in = openInputStream(joinPath(infile, "XTWeights.bin"));
+    inputW.load(*in);
+    outputW.load(*in);
 
     assert(inputW.cols() == outputW.cols());
     dims = inputW.cols();
@@ -30,7 +30,7 @@ class ExtremeText : public PLT {
 public:
     ExtremeText();
 
-    void train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
+    void train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
 
     void predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) override;
     Real predictForLabel(Label label, SparseVector& features, Args& args) override;
@@ -42,16 +42,16 @@ protected:
     Matrix outputW; // Tree node vectors
     int dims;
 
-    Real update(Real lr, const SparseVector& features, const SparseVector& labels, const Args& args);
+    Real update(Real lr, const SparseVector& features, const IndexVector& labels, const Args& args);
     Real updateNode(TreeNode* node, Real label, Vector& hidden, Vector& gradient, Real lr, Real l2);
 
     SparseVector computeHidden(const SparseVector& features);
 
-    inline Real predictForNode(TreeNode* node, SparseVector& features) override {
-        return 1.0 / (1.0 + std::exp(-outputW[node->index].dot(features)));
+    inline Real predictForNode(TreeNode* node, NodeQuery& query) override {
+        return 1.0 / (1.0 + std::exp(-outputW[node->index].dot(query.features)));
     };
 
-    static void trainThread(int threadId, ExtremeText* model, SRMatrix& labels,
+    static void trainThread(int threadId, ExtremeText* model, IRMatrix& labels,
                                   SRMatrix& features, Args& args, const int startRow, const int stopRow);
 
     static void printProgress(int state, int max, Real lr, Real loss) {
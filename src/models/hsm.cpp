@@ -39,7 +39,7 @@ HSM::HSM() {
 }
 
 void HSM::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vector<std::vector<Feature*>>& binFeatures,
-                           std::vector<std::vector<Real>>& binWeights, SRMatrix& labels,
+                           std::vector<std::vector<Real>>& binWeights, IRMatrix& labels,
                            SRMatrix& features, Args& args) {
     Log(CERR) << "Assigning data points to nodes ...\n";
 
@@ -55,7 +55,7 @@ void HSM::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vecto
         nPositive.clear();
         nNegative.clear();
 
-        SparseVector& rLabels = labels[r];
+        IndexVector& rLabels = labels[r];
         int rSize = rLabels.nonZero();
 
         // Check row
@@ -115,7 +115,8 @@ void HSM::getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<Tree
 
 Prediction HSM::predictNextLabel(
     std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue,
-    TopKQueue<TreeNodeValue>& nQueue, SparseVector& features) {
+    TopKQueue<TreeNodeValue>& nQueue, NodeQuery& query) {
+    SparseVector& features = query.features;
 
     while (!nQueue.empty()) {
         TreeNodeValue nVal = nQueue.top();
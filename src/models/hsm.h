@@ -46,11 +46,11 @@ protected:
     void assignDataPoints(std::vector<std::vector<Real>>& binLabels,
                           std::vector<std::vector<Feature*>>& binFeatures,
                           std::vector<std::vector<Real>>& binWeights,
-                          SRMatrix& labels, SRMatrix& features, Args& args) override;
+                          IRMatrix& labels, SRMatrix& features, Args& args) override;
     void getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, int rLabel);
     Prediction predictNextLabel(
         std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue,
-        TopKQueue<TreeNodeValue>& nQueue, SparseVector& features) override;
+        TopKQueue<TreeNodeValue>& nQueue, NodeQuery& query) override;
 
     int pathLength;   // Length of the path
 };
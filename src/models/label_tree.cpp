@@ -32,6 +32,7 @@
 #include <vector>
 
 #include "label_tree.h"
+#include "profiler.h"
 #include "threads.h"
 
 LabelTree::LabelTree() {
@@ -68,7 +69,7 @@ void LabelTree::buildTreeStructure(int labelCount, Args& args) {
         throw std::invalid_argument("Unknown tree type");
 }
 
-void LabelTree::buildTreeStructure(SRMatrix& labels, SRMatrix& features, Args& args) {
+void LabelTree::buildTreeStructure(IRMatrix& labels, SRMatrix& features, Args& args) {
     clear();
 
     // Load tree structure from file
@@ -89,9 +90,13 @@ void LabelTree::buildTreeStructure(SRMatrix& labels, SRMatrix& features, Args& a
         buildHuffmanTree(labels, args);
     else if (args.treeType == hierarchicalKmeans) {
         SRMatrix labelsFeatures;
-        computeLabelsFeaturesMatrix(labelsFeatures, labels, features, args.threads, args.norm,
-                                    args.kmeansWeightedFeatures);
+        {
+            ProfilerPhase phase("labels features matrix");
+            computeLabelsFeaturesMatrix(labelsFeatures, labels, features, args.threads, args.norm,
+                                        args.kmeansWeightedFeatures);
+        }
         //labelsFeatures.dump(joinPath(args.output, "lf_mat.txt"));
+        ProfilerPhase phase("k-means clustering");
         buildKmeansTree(labelsFeatures, args);
     } else if (args.treeType == onlineKaryComplete || args.treeType == onlineKaryRandom)
         buildOnlineTree(labels, features, args);
@@ -169,7 +174,7 @@ void LabelTree::buildKmeansTree(SRMatrix& labelsFeatures, Args& args) {
     }
 }
 
-void LabelTree::buildHuffmanTree(SRMatrix& labels, Args& args) {
+void LabelTree::buildHuffmanTree(IRMatrix& labels, Args& args) {
     Log(CERR) << "Building Huffman Tree ...\n";
 
     int k = labels.cols();
@@ -287,7 +292,7 @@ void LabelTree::buildCompleteTree(int labelCount, bool randomizeOrder, Args& arg
     }
 }
 
-void LabelTree::buildOnlineTree(SRMatrix& labels, SRMatrix& features, Args& args) {
+void LabelTree::buildOnlineTree(IRMatrix& labels, SRMatrix& features, Args& args) {
     Log(CERR) << "Building online tree ...\n";
 
     int nextToExpand = 0;
@@ -502,7 +507,7 @@ TreeNode* LabelTree::createTreeNode(TreeNode* parent, int label) {
     return n;
 }
 
-void LabelTree::save(std::ofstream& out) {
+void LabelTree::save(std::ostream& out) {
     Log(CERR) << "Saving tree ...\n";
 
     int k = leaves.size();
@@ -533,7 +538,7 @@ void LabelTree::save(std::ofstream& out) {
     }
 }
 
-void LabelTree::load(std::ifstream& in) {
+void LabelTree::load(std::istream& in) {
     clear();
 
     Log(CERR) << "Loading tree ...\n";
@@ -78,20 +78,20 @@ public:
 
     // Build tree structure of given type
     void buildTreeStructure(int labelCount, Args& args);
-    void buildTreeStructure(SRMatrix& labels, SRMatrix& features, Args& args);
+    void buildTreeStructure(IRMatrix& labels, SRMatrix& features, Args& args);
 
     // Hierarchical K-Means
     void buildKmeansTree(SRMatrix& labelsFeatures, Args& args);
 
     // Huffman tree
-    void buildHuffmanTree(SRMatrix& labels, Args& args);
+    void buildHuffmanTree(IRMatrix& labels, Args& args);
 
     // Just random complete and balance tree
     void buildCompleteTree(int labelCount, bool randomizeOrder, Args& args);
     void buildBalancedTree(int labelCount, bool randomizeOrder, Args& args);
 
     // Simulate simple online tree building
-    void buildOnlineTree(SRMatrix& labels, SRMatrix& features, Args& args);
+    void buildOnlineTree(IRMatrix& labels, SRMatrix& features, Args& args);
 
     // Flatten tree
     void flattenTree(int levels);
@@ -106,8 +106,8 @@ public:
     std::vector<std::tuple<int, int, int>> getTreeStructure();
     void validateTree();
 
-    void save(std::ofstream& out) override;
-    void load(std::ifstream& in) override;
+    void save(std::ostream& out) override;
+    void load(std::istream& in) override;
 
     inline TreeNode* getRoot() const { return root; };
     inline TreeNode* getNode(int index) const {
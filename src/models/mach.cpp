@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "mach.h"
+#include "model_archive.h"
 #include "threads.h"
 
 
@@ -35,7 +36,7 @@ int MACH::getFirstBiggerPrime(int number){
     return number;
 }
 
-void MACH::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
+void MACH::train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
     int hashCount = args.machHashes;
     bucketCount = args.machBuckets;
 
@@ -137,19 +138,19 @@ Real MACH::predictForLabel(Label label, SparseVector& features, Args& args) {
 void MACH::load(Args& args, std::string infile) {
     Log(CERR) << "Loading weights ...\n";
     bases = loadBases(joinPath(infile, "weights.bin"));
+    findUsedFeatures(bases, args);
 
     Log(CERR) << "Loading hashes ...\n";
-    std::ifstream in(joinPath(infile, "hashes.bin"));
+    auto in = openInputStream(joinPath(infile, "hashes.bin"));
     int hashCount, a, b;
-    in.read((char*)&m, sizeof(m));
-    in.read((char*)&bucketCount, sizeof(bucketCount));
-    in.read((char*)&hashCount, sizeof(hashCount));
+    in->read((char*)&m, sizeof(m));
+    in->read((char*)&bucketCount, sizeof(bucketCount));
+    in->read((char*)&hashCount, sizeof(hashCount));
     for(int i = 0; i < hashCount; ++i){
-        in.read((char*)&a, sizeof(a));
-        in.read((char*)&b, sizeof(b));
+        in->read((char*)&a, sizeof(a));
+        in->read((char*)&b, sizeof(b));
         hashes.emplace_back(a, b);
     }
-    in.close();
 
     // This is needed for fast brute force prediction
     baseToLabels.resize(bases.size());
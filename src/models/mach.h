@@ -27,11 +27,13 @@ public:
     MACH();
     ~MACH() override;
 
-    void train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
+    void train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
     void predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) override;
     Real predictForLabel(Label label, SparseVector& features, Args& args) override;
 
     void load(Args& args, std::string infile) override;
+    std::vector<Base*>& getBases() override { return bases; };
+
     inline int baseForLabel(int label, int hash) {
         return (hash * bucketCount) + (hashes[hash].hash(label) % bucketCount);
     }
@@ -26,17 +26,17 @@
 #include "log.h"
 
 
-void OnlineModel::onlineTrainThread(int threadId, OnlineModel* model, SRMatrix& labels,
-                                    SRMatrix& features, Args& args, const int startRow, const int stopRow) {
+void OnlineModel::onlineTrainThread(int threadId, OnlineModel* model, IRMatrix& labels, SRMatrix& features,
+                                    Args& args, const int epochs, const int startRow, const int stopRow) {
     const int rowsRange = stopRow - startRow;
-    const int examples = rowsRange * args.epochs;
+    const int examples = rowsRange * epochs;
     for (int i = 0; i < examples; ++i) {
         if (!threadId) printProgress(i, examples);
         int r = startRow + i % rowsRange;
         int e = i / rowsRange;
         model->update(e, r, labels[r], features[r], args);
 
-        if(!threadId && logLevel >= CERR_DEBUG && i % (examples / 100) == 0){
+        if(!threadId && logLevel >= CERR_DEBUG && (examples < 100 || i % (examples / 100) == 0)){
             auto res = getResources();
             Log(COUT) << "  R mem (MB): " << res.currentRealMem / 1024
                       << ", V mem (MB): " << res.currentVirtualMem / 1024
@@ -46,7 +46,7 @@ void OnlineModel::onlineTrainThread(int threadId, OnlineModel* model, SRMatrix&
     }
 }
 
-void OnlineModel::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
+void OnlineModel::train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
     Log(CERR) << "Preparing online model ...\n";
 
     // Init model
@@ -55,14 +55,17 @@ void OnlineModel::train(SRMatrix& labels, SRMatrix& features, Args& args, std::s
 
     // Iterate over rows
     Log(CERR) << "Training online for " << args.epochs << " epochs in " << args.threads << " threads ...\n";
+    updateBatch(labels, features, args, args.epochs);
 
+    // Save training output
+    save(args, output);
+}
+
+void OnlineModel::updateBatch(IRMatrix& labels, SRMatrix& features, Args& args, int epochs) {
     ThreadSet tSet;
     int tRows = ceil(static_cast<Real>(features.rows()) / args.threads);
     for (int t = 0; t < args.threads; ++t)
-        tSet.add(onlineTrainThread, t, this, std::ref(labels), std::ref(features), std::ref(args), t * tRows,
+        tSet.add(onlineTrainThread, t, this, std::ref(labels), std::ref(features), std::ref(args), epochs, t * tRows,
                  std::min((t + 1) * tRows, features.rows()));
     tSet.joinAll();
-
-    // Save training output
-    save(args, output);
 }
@@ -27,14 +27,17 @@
 
 class OnlineModel : virtual public Model {
 public:
-    void train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) final;
+    void train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) final;
 
     virtual void init(Args& args) = 0;
-    virtual void init(SRMatrix& labels, SRMatrix& features, Args& args) = 0;
-    virtual void update(const int epoch, const int row, SparseVector& labels, SparseVector& features, Args& args) = 0;
+    virtual void init(IRMatrix& labels, SRMatrix& features, Args& args) = 0;
+    virtual void update(const int epoch, const int row, IndexVector& labels, SparseVector& features, Args& args) = 0;
     virtual void save(Args& args, std::string output) = 0;
 
+    // Updates already initialized model with a batch of examples, can be called many times (e.g. for streamed data)
+    void updateBatch(IRMatrix& labels, SRMatrix& features, Args& args, int epochs = 1);
+
 private:
-    static void onlineTrainThread(int threadId, OnlineModel* model, SRMatrix& labels,
-                                  SRMatrix& features, Args& args, const int startRow, const int stopRow);
+    static void onlineTrainThread(int threadId, OnlineModel* model, IRMatrix& labels, SRMatrix& features,
+                                  Args& args, const int epochs, const int startRow, const int stopRow);
 };
@@ -39,7 +39,7 @@ void OnlinePLT::init(Args& args) {
     onlineTree = true;
 }
 
-void OnlinePLT::init(SRMatrix& labels, SRMatrix& features, Args& args) {
+void OnlinePLT::init(IRMatrix& labels, SRMatrix& features, Args& args) {
     tree = new LabelTree();
 
     if (args.treeType == onlineRandom || args.treeType == onlineBestScore) {
@@ -65,7 +65,7 @@ void OnlinePLT::init(SRMatrix& labels, SRMatrix& features, Args& args) {
     }
 }
 
-void OnlinePLT::update(const int epoch, const int row, SparseVector& labels, SparseVector& features, Args& args) {
+void OnlinePLT::update(const int epoch, const int row, IndexVector& labels, SparseVector& features, Args& args) {
     UnorderedSet<TreeNode *> nPositive;
     UnorderedSet<TreeNode *> nNegative;
     if (epoch == 0 && onlineTree) { // Check if example contains a new label
@@ -35,8 +35,8 @@ public:
     ~OnlinePLT() override;
 
     void init(Args& args) override;
-    void init(SRMatrix& labels, SRMatrix& features, Args& args) override;
-    void update(const int epoch, const int row, SparseVector& labels, SparseVector& features, Args& args) override;
+    void init(IRMatrix& labels, SRMatrix& features, Args& args) override;
+    void update(const int epoch, const int row, IndexVector& labels, SparseVector& features, Args& args) override;
 
     void save(Args& args, std::string output) override;
     void load(Args& args, std::string infile) override;
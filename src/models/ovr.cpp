@@ -37,7 +37,7 @@ OVR::OVR() {
 }
 
 void OVR::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vector<Feature*>& binFeatures, std::vector<Real>& binWeights,
-                          SRMatrix& labels, SRMatrix& features, int rStart, int rStop, Args& args){
+                          IRMatrix& labels, SRMatrix& features, int rStart, int rStop, Args& args){
     int rows = labels.rows();
     for (int r = 0; r < rows; ++r) {
         printProgress(r, rows);
@@ -34,7 +34,7 @@ protected:
     void assignDataPoints(std::vector<std::vector<Real>>& binLabels,
                           std::vector<Feature*>& binFeatures,
                           std::vector<Real>& binWeights,
-                          SRMatrix& labels, SRMatrix& features,
+                          IRMatrix& labels, SRMatrix& features,
                           int rStart, int rStop, Args& args) override;
     std::vector<Prediction> predictForAllLabels(SparseVector& features, Args& args) override;
 };
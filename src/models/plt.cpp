@@ -24,10 +24,12 @@
 #include <cassert>
 #include <climits>
 #include <cmath>
+#include <filesystem>
 #include <list>
 #include <vector>
 
 #include "plt.h"
+#include "threads.h"
 
 
 PLT::PLT() {
@@ -37,6 +39,11 @@ PLT::PLT() {
     type = plt;
     name = "PLT";
     tree = nullptr;
+    Metrics::addSource(evaluatedNodes, &nodeEvaluationCount);
+}
+
+PLT::~PLT() {
+    Metrics::removeSource(&nodeEvaluationCount);
 }
 
 void PLT::unload() {
@@ -49,8 +56,10 @@ void PLT::unload() {
 }
 
 void PLT::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vector<std::vector<Feature*>>& binFeatures,
-                           std::vector<std::vector<Real>>& binWeights, SRMatrix& labels, SRMatrix& features, Args& args) {
+                           std::vector<std::vector<Real>>& binWeights, IRMatrix& labels, SRMatrix& features, Args& args) {
     Log(CERR) << "Assigning data points to nodes ...\n";
+    ProfilerPhase phase("assign data points");
+    MetricScope scope(assignTime);
 
     // Positive and negative nodes
     UnorderedSet<TreeNode*> nPositive;
@@ -75,7 +84,7 @@ void PLT::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vecto
     Log(CERR) << "  Temporary data size: " << formatMem(usedMem) << "\n";
 }
 
-void PLT::getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, const SparseVector& labels) {
+void PLT::getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, const IndexVector& labels) {
     for (auto &l : labels) {
         auto ni = tree->leaves.find(l.index);
         if (ni == tree->leaves.end()) {
@@ -120,11 +129,70 @@ void PLT::addNodesLabelsAndFeatures(std::vector<std::vector<Real>>& binLabels, s
 }
 
 std::vector<std::vector<Prediction>> PLT::predictBatch(SRMatrix& features, Args& args) {
-    if (args.treeSearchType == exact) return Model::predictBatch(features, args);
+    if (args.treeSearchType == exact) {
+        if (args.denseFeatures > 0 && hasDenseScoring())
+            return predictDense(&features, nullptr, features.rows(), args.denseFeatures + 2, args); // Features are shifted by 2
+        return Model::predictBatch(features, args);
+    }
     else if (args.treeSearchType == beam) return predictWithBeamSearch(features, args);
     else throw std::invalid_argument("Unknown tree search type");
 }
 
+std::vector<std::vector<Prediction>> PLT::predictDenseBatch(const Real* x, int rows, int dims, Args& args) {
+    if (args.treeSearchType == exact && hasDenseScoring()) return predictDense(nullptr, x, rows, dims, args);
+    return Model::predictDenseBatch(x, rows, dims, args);
+}
+
+std::vector<std::vector<Prediction>> PLT::predictDense(SRMatrix* features, const Real* x, int rows, int dims, Args& args) {
+    Log(CERR) << "Starting prediction with " << dims - 2 << " dense features in " << args.threads << " threads ...\n";
+
+    std::vector<std::vector<Prediction>> predictions(rows);
+
+    ThreadSet tSet;
+    int threads = std::max(1, std::min(args.threads, rows));
+    int tRows = ceil(static_cast<Real>(rows) / threads);
+    for (int t = 0; t < threads; ++t)
+        tSet.add(predictDenseThread, t, this, std::ref(predictions), features, x, dims, std::ref(args), t * tRows,
+                 std::min((t + 1) * tRows, rows));
+    tSet.joinAll();
+
+    return predictions;
+}
+
+void PLT::predictDenseThread(int threadId, PLT* model, std::vector<std::vector<Prediction>>& predictions,
+                             SRMatrix* features, const Real* x, int dims, Args& args,
+                             const int startRow, const int stopRow) {
+    // Dense rows are used in place, the dense part of sparse rows is copied to the buffer
+    std::vector<Real> buffer(features ? dims : 0);
+    std::vector<IRVPair> pruned;
+    Feature emptyTail(-1, 0);
+    SparseVector empty;
+
+    // Sparse rows are pruned like in predictPruned, so the tail has only the features used by the model
+    auto predictRow = [&](std::vector<Prediction>& prediction, SparseVector& row) {
+        std::fill(buffer.begin(), buffer.end(), 0);
+        Feature* f = row.data();
+        for (; f->index != -1 && f->index < dims; ++f) buffer[f->index] = f->value;
+        NodeQuery query{row, buffer.data(), dims, f};
+        model->predictQuery(prediction, query, args);
+    };
+
+    for (int r = startRow; r < stopRow; ++r) {
+        MetricScope scope(predictTime);
+        Metrics::count(predictedQueries);
+        if (features) {
+            if (model->pruneFeatures(pruned, (*features)[r])) {
+                SparseVector prunedFeatures(pruned);
+                predictRow(predictions[r], prunedFeatures);
+            } else predictRow(predictions[r], (*features)[r]);
+        } else {
+            NodeQuery query{empty, x + static_cast<size_t>(r) * dims, dims, &emptyTail};
+            model->predictQuery(predictions[r], query, args);
+        }
+        if (!threadId) printProgress(r - startRow, stopRow - startRow);
+    }
+}
+
 std::vector<std::vector<Prediction>> PLT::predictWithBeamSearch(SRMatrix& features, Args& args){
     Log(CERR) << "Starting prediction in 1 thread ...\n";
 
@@ -138,11 +206,14 @@ std::vector<std::vector<Prediction>> PLT::predictWithBeamSearch(SRMatrix& featur
     auto nextLevelQueue = new std::queue<TreeNode*>();
     nextLevelQueue->push(tree->root);
     for(int i = 0; i < rows; ++i) nodePredictions[tree->root->index].emplace_back(i, 1.0);
-    AbstractVector* tmpW = new Vector(features.cols());
-    AbstractVector* originalW = nullptr;
+
+    // Sparse weights are unpacked to the buffer of this call, so the bases are not modified
+    // and the prediction can run concurrently with others
+    Vector unpackedW(args.beamSearchUnpack ? std::max<size_t>(features.cols(), weightsSize) : 0);
 
     int nCount = 0;
     while(!nextLevelQueue->empty()){
+        MetricScope levelScope(levelTime);
 
         auto levelQueue = nextLevelQueue;
         nextLevelQueue = new std::queue<TreeNode*>();
@@ -157,16 +228,13 @@ std::vector<std::vector<Prediction>> PLT::predictWithBeamSearch(SRMatrix& featur
 
             if(!nodePredictions[nIdx].empty()){
                 auto base = bases[nIdx];
-                auto type = base->getType();
-                if(type == sparse && args.beamSearchUnpack){
-                    originalW = base->getW();
-                    tmpW->add(*originalW);
-                    base->setW(tmpW);
-                }
+                bool unpack = base->getType() == sparse && args.beamSearchUnpack && base->getW()
+                              && base->getW()->size() <= unpackedW.size(); // Online models may grow after load
+                if(unpack) unpackedW.add(*base->getW());
 
                 for(auto &e : nodePredictions[nIdx]){
                     int rIdx = e.label;
-                    Real prob = bases[nIdx]->predictProbability(features[rIdx]) * e.value;
+                    Real prob = (unpack ? base->predictProbability(features[rIdx], unpackedW) : base->predictProbability(features[rIdx])) * e.value;
                     Real value = prob;
 
                     // Reweight score
@@ -178,10 +246,7 @@ std::vector<std::vector<Prediction>> PLT::predictWithBeamSearch(SRMatrix& featur
                 nodeEvaluationCount += nodePredictions[nIdx].size();
                 nodePredictions[nIdx].clear();
 
-                if(type == sparse && args.beamSearchUnpack){
-                    tmpW->zero(*originalW);
-                    base->setW(originalW);
-                }
+                if(unpack) unpackedW.zero(*base->getW());
             }
 
             for(auto &c : n->children)
@@ -192,25 +257,7 @@ std::vector<std::vector<Prediction>> PLT::predictWithBeamSearch(SRMatrix& featur
         // Keep top predictions and prepare next level
         for(int rIdx = 0; rIdx < rows; ++rIdx){
             auto &v = levelPredictions[rIdx];
-
-            if(!thresholds.empty()){
-                int j = 0;
-                for(int i = 0; i < v.size(); ++i){
-                    if(v[i].value > nodesThr[v[i].node->index].th)
-                        v[j++] = v[i];
-                }
-                v.resize(j - 1);
-            }
-            else {
-                std::sort(v.rbegin(), v.rend());
-
-                if(args.threshold > 0){
-                    int i = 0;
-                    while (i < v.size() && v[i++].value > args.threshold);
-                    v.resize(i - 1);
-                }
-                else v.resize(std::min(v.size(), (size_t)args.beamSearchWidth));
-            }
+            selectBeam(v, args);
 
             for(auto &nv : v)
                 for(auto &c : nv.node->children)
@@ -219,7 +266,6 @@ std::vector<std::vector<Prediction>> PLT::predictWithBeamSearch(SRMatrix& featur
         }
     }
     delete nextLevelQueue;
-    delete tmpW;
 
     for(int rIdx = 0; rIdx < rows; ++rIdx){
         auto &v = prediction[rIdx];
@@ -230,7 +276,67 @@ std::vector<std::vector<Prediction>> PLT::predictWithBeamSearch(SRMatrix& featur
     return prediction;
 }
 
+void PLT::selectBeam(std::vector<TreeNodeValue>& level, Args& args){
+    if(!thresholds.empty()){
+        int j = 0;
+        for(int i = 0; i < level.size(); ++i){
+            if(level[i].value > nodesThr[level[i].node->index].th)
+                level[j++] = level[i];
+        }
+        level.resize(j);
+    }
+    else {
+        std::sort(level.rbegin(), level.rend());
+
+        if(args.threshold > 0){
+            int i = 0;
+            while (i < level.size() && level[i].value > args.threshold) ++i;
+            level.resize(i);
+        }
+        else level.resize(std::min(level.size(), (size_t)args.beamSearchWidth));
+    }
+}
+
+void PLT::predictWithBeamSearch(std::vector<Prediction>& prediction, NodeQuery& query, Args& args){
+    std::vector<TreeNodeValue> level, nextLevel;
+
+    auto evaluate = [&](TreeNode* n, Real parentProb) {
+        Real prob = predictForNode(n, query) * parentProb;
+        Real value = prob;
+
+        // Reweight score
+        if (!labelsWeights.empty()) value *= nodesWeights[n->index].weight;
+
+        if(n->label >= 0) prediction.emplace_back(n->label, value); // Label prediction
+        if(n->children.size() > 0) nextLevel.emplace_back(n, prob, value); // Internal node prediction
+    };
+
+    evaluate(tree->root, 1.0);
+    ++nodeEvaluationCount;
+    ++dataPointCount;
+
+    while(!nextLevel.empty()){
+        selectBeam(nextLevel, args);
+        level.swap(nextLevel);
+        nextLevel.clear();
+
+        for(auto &nv : level){
+            for(auto &c : nv.node->children) evaluate(c, nv.prob);
+            nodeEvaluationCount += nv.node->children.size();
+        }
+    }
+
+    std::sort(prediction.rbegin(), prediction.rend());
+}
+
 void PLT::predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) {
+    NodeQuery query{features};
+    predictQuery(prediction, query, args);
+}
+
+void PLT::predictQuery(std::vector<Prediction>& prediction, NodeQuery& query, Args& args) {
+    if (args.treeSearchType == beam) return predictWithBeamSearch(prediction, query, args);
+
     int topK = args.topK;
     Real threshold = args.threshold;
 
@@ -262,28 +368,29 @@ void PLT::predict(std::vector<Prediction>& prediction, SparseVector& features, A
         };
 
     // Predict for root
-    Real rootProb = predictForNode(tree->root, features);
+    Real rootProb = predictForNode(tree->root, query);
     addToQueue(ifAddToQueue, calculateValue, nQueue, tree->root, rootProb);
     ++nodeEvaluationCount;
     ++dataPointCount;
 
-    Prediction p = predictNextLabel(ifAddToQueue, calculateValue, nQueue, features);
+    Prediction p = predictNextLabel(ifAddToQueue, calculateValue, nQueue, query);
     while ((prediction.size() < topK || topK == 0) && p.label != -1) {
         prediction.push_back(p);
-        p = predictNextLabel(ifAddToQueue, calculateValue, nQueue, features);
+        p = predictNextLabel(ifAddToQueue, calculateValue, nQueue, query);
     }
 }
 
 Prediction PLT::predictNextLabel(
     std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue,
-    TopKQueue<TreeNodeValue>& nQueue, SparseVector& features) {
+    TopKQueue<TreeNodeValue>& nQueue, NodeQuery& query) {
     while (!nQueue.empty()) {
         TreeNodeValue nVal = nQueue.top();
         nQueue.pop();
+        Metrics::count(heapPops);
 
         if (!nVal.node->children.empty()) {
             for (const auto& child : nVal.node->children)
-                addToQueue(ifAddToQueue, calculateValue, nQueue, child, nVal.prob * predictForNode(child, features));
+                addToQueue(ifAddToQueue, calculateValue, nQueue, child, nVal.prob * predictForNode(child, query));
             nodeEvaluationCount += nVal.node->children.size();
         }
         if (nVal.node->label >= 0) return {nVal.node->label, nVal.value};
@@ -337,6 +444,10 @@ void PLT::setThresholds(std::vector<Real> th){
     if(!tree) throw std::runtime_error("Tree is not constructed, load or build a tree first");
 
     Model::setThresholds(th);
+    if (th.empty()) { // Prediction without thresholds
+        nodesThr.clear();
+        return;
+    }
     calculateNodesLabels();
     if (tree->size() != nodesThr.size()) nodesThr.resize(tree->size());
     for (auto& n : tree->nodes) setNodeThreshold(n);
@@ -346,6 +457,10 @@ void PLT::setLabelsWeights(std::vector<Real> lw){
     if(!tree) throw std::runtime_error("Tree is not constructed, load or build a tree first");
 
     Model::setLabelsWeights(lw);
+    if (lw.empty()) { // Prediction without labels weights
+        nodesWeights.clear();
+        return;
+    }
     calculateNodesLabels();
     if (tree->size() != nodesWeights.size()) nodesWeights.resize(tree->size());
     for (auto& n : tree->nodes) setNodeWeight(n);
@@ -374,10 +489,11 @@ Real PLT::predictForLabel(Label label, SparseVector& features, Args& args) {
     auto fn = tree->leaves.find(label);
     if(fn == tree->leaves.end()) return 0;
     TreeNode* n = fn->second;
+    NodeQuery query{features};
     Real value = bases[n->index]->predictProbability(features);
     while (n->parent) {
         n = n->parent;
-        value *= predictForNode(n, features);
+        value *= predictForNode(n, query);
         ++nodeEvaluationCount;
     }
 
@@ -399,6 +515,7 @@ void PLT::load(Args& args, std::string infile) {
 
     preload(args, infile);
     bases = loadBases(joinPath(infile, "weights.bin"), args.resume, args.loadAs);
+    findUsedFeatures(bases, args);
 
     assert(bases.size() == tree->nodes.size());
     m = tree->getNumberOfLeaves();
@@ -416,17 +533,29 @@ void PLT::printInfo() {
         Log(COUT) << "  Evaluated estimators / data point: " << static_cast<Real>(nodeEvaluationCount) / dataPointCount << "\n";
 }
 
-void PLT::buildTree(SRMatrix& labels, SRMatrix& features, Args& args, std::string output){
+void PLT::buildTree(IRMatrix& labels, SRMatrix& features, Args& args, std::string output){
+    ProfilerPhase phase("build tree");
     delete tree;
     tree = new LabelTree();
-    tree->buildTreeStructure(labels, features, args);
+
+    // Reuse the tree of the warm start model, so its nodes match the new ones
+    std::string warmTree = joinPath(args.warmStart, "tree.bin");
+    if (!args.warmStart.empty() && args.treeStructure.empty() && std::filesystem::exists(warmTree)) {
+        Log(CERR) << "Loading tree from warm start model ...\n";
+        tree->loadFromFile(warmTree);
+        if (tree->getNumberOfLeaves() < labels.cols()) {
+            Log(CERR) << "Warning: Warm start tree has fewer leaves than labels, building a new one!\n";
+            tree->buildTreeStructure(labels, features, args);
+        }
+    }
+    else tree->buildTreeStructure(labels, features, args);
 
     m = tree->getNumberOfLeaves();
     tree->saveToFile(joinPath(output, "tree.bin"));
     tree->saveTreeStructure(joinPath(output, "tree.txt"));
 }
 
-std::vector<std::vector<std::pair<int, Real>>> PLT::getNodesToUpdate(const SRMatrix& labels){
+std::vector<std::vector<std::pair<int, Real>>> PLT::getNodesToUpdate(const IRMatrix& labels){
     if(!tree) throw std::runtime_error("Tree is not constructed, load or build a tree first");
 
     // Positive and negative nodes
@@ -454,7 +583,7 @@ std::vector<std::vector<std::pair<int, Real>>> PLT::getNodesToUpdate(const SRMat
     return nodesToUpdate;
 }
 
-std::vector<std::vector<std::pair<int, Real>>> PLT::getNodesUpdates(const SRMatrix& labels){
+std::vector<std::vector<std::pair<int, Real>>> PLT::getNodesUpdates(const IRMatrix& labels){
     if(!tree) throw std::runtime_error("Tree is not constructed, load or build a tree first");
 
     // Positive and negative nodes
@@ -495,7 +624,7 @@ std::vector<std::tuple<int, int, int>> PLT::getTreeStructure(){
     else return tree->getTreeStructure();
 }
 
-void BatchPLT::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
+void BatchPLT::train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
     if(!tree) buildTree(labels, features, args, output);
 
     Log(CERR) << "Training tree ...\n";
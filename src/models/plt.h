@@ -25,6 +25,7 @@
 #include "base.h"
 #include "label_tree.h"
 #include "model.h"
+#include "threads.h"
 
 // Additional node information for prediction with thresholds
 struct TreeNodeThrExt {
@@ -38,14 +39,25 @@ struct TreeNodeWeightsExt {
     int label;
 };
 
+// Query of the tree search, nodes are scored by the products of their weights with the features,
+// or with the dense features x and the sparse tail of the query if x is set
+struct NodeQuery {
+    SparseVector& features;
+    const Real* x = nullptr;
+    int dims = 0;
+    Feature* tail = nullptr;
+};
+
 // This is virtual class for all PLT based models: HSM, Batch PLT, Online PLT
 class PLT : virtual public Model {
 public:
     PLT();
+    ~PLT() override;
 
     void predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) override;
     Real predictForLabel(Label label, SparseVector& features, Args& args) override;
     std::vector<std::vector<Prediction>> predictBatch(SRMatrix& features, Args& args) override;
+    std::vector<std::vector<Prediction>> predictDenseBatch(const Real* x, int rows, int dims, Args& args) override;
     std::vector<std::vector<Prediction>> predictWithBeamSearch(SRMatrix& features, Args& args);
 
     void setThresholds(std::vector<Real> th) override;
@@ -56,6 +68,7 @@ public:
     void unload() override;
 
     void printInfo() override;
+    std::vector<Base*>& getBases() override { return bases; };
 
     void setTree(LabelTree*t) { tree = t; };
     LabelTree* getTree() { return tree; };
@@ -63,9 +76,9 @@ public:
     void preload(Args& args, std::string infile) override;
 
     // Helpers for Python PLT Framework
-    void buildTree(SRMatrix& labels, SRMatrix& features, Args& args, std::string output);
-    std::vector<std::vector<std::pair<int, Real>>> getNodesToUpdate(const SRMatrix& labels);
-    std::vector<std::vector<std::pair<int, Real>>> getNodesUpdates(const SRMatrix& labels);
+    void buildTree(IRMatrix& labels, SRMatrix& features, Args& args, std::string output);
+    std::vector<std::vector<std::pair<int, Real>>> getNodesToUpdate(const IRMatrix& labels);
+    std::vector<std::vector<std::pair<int, Real>>> getNodesUpdates(const IRMatrix& labels);
 
     void setTreeStructure(std::vector<std::tuple<int, int, int>> treeStructure, std::string output);
     std::vector<std::tuple<int, int, int>> getTreeStructure();
@@ -85,34 +98,56 @@ protected:
     virtual void assignDataPoints(std::vector<std::vector<Real>>& binLabels,
                                   std::vector<std::vector<Feature*>>& binFeatures,
                                   std::vector<std::vector<Real>>& binWeights,
-                                  SRMatrix& labels, SRMatrix& features, Args& args);
+                                  IRMatrix& labels, SRMatrix& features, Args& args);
 
-    void getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, const SparseVector& labels);
+    void getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, const IndexVector& labels);
     static void addNodesLabelsAndFeatures(std::vector<std::vector<Real>>& binLabels, std::vector<std::vector<Feature*>>& binFeatures,
                                           UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, SparseVector& features);
 
     // Helper methods for prediction
+    void predictQuery(std::vector<Prediction>& prediction, NodeQuery& query, Args& args);
+    // Beam search for a single query, used by predict with beam tree search type
+    void predictWithBeamSearch(std::vector<Prediction>& prediction, NodeQuery& query, Args& args);
     virtual Prediction predictNextLabel(std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue,
-                                        TopKQueue<TreeNodeValue>& nQueue, SparseVector& features);
-
-    virtual inline Real predictForNode(TreeNode* node, SparseVector& features){
-        return bases[node->index]->predictProbability(features);
+                                        TopKQueue<TreeNodeValue>& nQueue, NodeQuery& query);
+
+    virtual inline Real predictForNode(TreeNode* node, NodeQuery& query){
+        if (query.x) {
+            Real value;
+            bases[node->index]->predictValues(&value, query.x, query.dims, &query.tail, 1);
+            return bases[node->index]->probability(value);
+        }
+        return bases[node->index]->predictProbability(query.features);
     }
 
+    // Keeps the nodes of the level that are expanded by the beam search
+    void selectBeam(std::vector<TreeNodeValue>& level, Args& args);
+
+    // HSM and extremeText score the nodes in their own way
+    inline bool hasDenseScoring(){ return type == plt || type == oplt; }
+    std::vector<std::vector<Prediction>> predictDense(SRMatrix* features, const Real* x, int rows, int dims, Args& args);
+    static void predictDenseThread(int threadId, PLT* model, std::vector<std::vector<Prediction>>& predictions,
+                                   SRMatrix* features, const Real* x, int dims, Args& args,
+                                   const int startRow, const int stopRow);
+
     inline void addToQueue(std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue,
                            TopKQueue<TreeNodeValue>& nQueue, TreeNode* node, Real prob){
         Real value = calculateValue(node, prob);
-        if (ifAddToQueue(node, prob)) nQueue.push({node, prob, value}, node->label > -1);
-
+        if (ifAddToQueue(node, prob)) {
+            nQueue.push({node, prob, value}, node->label > -1);
+            Metrics::count(heapPushes);
+        }
     }
 
     // Additional statistics
-    int nodeEvaluationCount; // Number of visited nodes during training prediction (updated/evaluated classifiers)
-    int nodeUpdateCount; // Number of visited nodes during training or prediction
-    int dataPointCount; // Data points count
+    // Updated from the prediction threads, each of them writes to its own shard,
+    // evaluated nodes are also reported by the metrics
+    ShardedCounter nodeEvaluationCount; // Number of visited nodes during training prediction (updated/evaluated classifiers)
+    ShardedCounter nodeUpdateCount; // Number of visited nodes during training or prediction
+    ShardedCounter dataPointCount; // Data points count
 };
 
 class BatchPLT : public PLT {
 public:
-    void train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
+    void train(IRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
 };
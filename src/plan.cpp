@@ -0,0 +1,342 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include "log.h"
+#include "misc.h"
+#include "plan.h"
+#include "read_data.h"
+#include "resources.h"
+
+#include "br.h"
+#include "label_tree.h"
+
+DataStats scanDataStats(Args& args) {
+    if (args.input.empty())
+        throw std::invalid_argument("Empty input path");
+
+    Log(CERR) << "Scanning data from: " << args.input << "\n";
+
+    std::ifstream in;
+    in.open(args.input, std::ios::in | std::ios::binary);
+    if (!in.good()) throw std::invalid_argument("Cannot open input file: " + args.input);
+    in.seekg(0, std::ios::end);
+    double fileSize = in.tellg();
+    in.seekg(0);
+
+    DataStats stats;
+    int hRows = 0, hFeatures = 0, hLabels = 0;
+    int maxFeature = -1, maxLabel = -1;
+    std::vector<IRVPair> lLabels;
+    std::vector<IRVPair> lFeatures;
+
+    auto addRow = [&]() {
+        ++stats.rows;
+        stats.labelsCells += lLabels.size();
+        stats.featuresCells += lFeatures.size() + (args.processData ? 1 : 0); // Bias feature
+        for (auto& l : lLabels) {
+            if (l.index < 0) continue;
+            if (l.index >= stats.labelsFrequencies.size()) stats.labelsFrequencies.resize(l.index + 1, 0);
+            ++stats.labelsFrequencies[l.index];
+            maxLabel = std::max(maxLabel, l.index);
+        }
+        for (auto& f : lFeatures) maxFeature = std::max(maxFeature, f.index);
+    };
+    auto scanned = [&]() { return args.scanRows > 0 && stats.rows >= args.scanRows; };
+
+    bool binary = readBinaryDataHeader(in, hRows, hFeatures, hLabels);
+    if (binary) {
+        while (!scanned() && stats.rows < hRows) {
+            lLabels.clear();
+            lFeatures.clear();
+            readBinaryDataRow(in, lLabels, lFeatures, hLabels, hFeatures);
+            if (!in.good()) throw std::runtime_error("Unexpected end of binary data file: " + args.input);
+            addRow();
+        }
+    } else {
+        std::string line;
+        getline(in, line);
+        auto hTokens = split(line, ' ');
+        if (hTokens.size() == 2 || hTokens.size() == 3) {
+            hRows = std::stoi(hTokens[0]);
+            hFeatures = std::stoi(hTokens[1]);
+            if (hTokens.size() == 3) hLabels = std::stoi(hTokens[2]);
+            getline(in, line);
+        }
+
+        do {
+            if (line.empty()) continue;
+            lLabels.clear();
+            lFeatures.clear();
+            try {
+                readLine(line, lLabels, lFeatures);
+            } catch (const std::exception& e) {
+                continue;
+            }
+            addRow();
+        } while (!scanned() && getline(in, line));
+    }
+
+    // Extrapolate the sample to the whole file
+    double scale = 1;
+    if (binary && stats.rows < hRows) scale = static_cast<double>(hRows) / stats.rows;
+    else if (!binary && in.good() && in.tellg() > 0) scale = fileSize / static_cast<double>(in.tellg());
+    if (stats.rows > 0 && scale > 1) {
+        stats.sampled = true;
+        stats.rows = std::llround(stats.rows * scale);
+        stats.labelsCells = std::llround(stats.labelsCells * scale);
+        stats.featuresCells = std::llround(stats.featuresCells * scale);
+        for (auto& f : stats.labelsFrequencies) f = std::llround(f * scale);
+    }
+
+    // Same number of columns as in the matrices created by readData
+    stats.labels = std::max(maxLabel + 1, hLabels);
+    stats.labelsFrequencies.resize(stats.labels, 0);
+    int features = std::max(maxFeature + 1, hFeatures);
+    if (args.hash) features = args.hash;
+    stats.features = args.processData ? features + 2 : features;
+
+    return stats;
+}
+
+// Estimates for one configuration
+struct PlanEstimate {
+    int threads;
+    int arity;
+    int maxLeaves;
+    int features;
+
+    int bases = 0;
+    int parts = 1;
+    unsigned long long processMem = 0; // Memory of the process itself
+    unsigned long long dataMem = 0;
+    unsigned long long treeMem = 0; // Temporary data of tree building
+    unsigned long long tmpDataMem = 0; // Temporary data of base estimators training (of a single part)
+    unsigned long long baseMem = 0; // Training workspace of base estimators
+    unsigned long long modelMem[3] = {0, 0, 0}; // For each representation type
+    unsigned long long modelFileSize = 0;
+
+    unsigned long long trainMem() const { return processMem + dataMem + std::max(treeMem, tmpDataMem + baseMem); }
+};
+
+// Adds base estimator with estimated number of non-zero weights
+static void addBase(PlanEstimate& e, double positiveCells, double assignedCells, Args& args) {
+    // Pruned weights stay mostly for the features of the positive examples, otherwise of all assigned examples
+    double cells = args.weightsThreshold > 0 ? positiveCells : assignedCells;
+    size_t n0 = std::max<size_t>(1, std::min<double>(e.features, cells));
+    size_t s = e.features;
+    e.modelMem[dense] += sizeof(Base) + Vector::estimateMem(s, n0);
+    e.modelMem[map] += sizeof(Base) + MapVector::estimateMem(s, n0);
+    e.modelMem[sparse] += sizeof(Base) + SparseVector::estimateMem(s, n0);
+    e.modelFileSize += std::min(s * sizeof(Real), n0 * (sizeof(int) + sizeof(Real)));
+    ++e.bases;
+}
+
+static PlanEstimate estimate(const DataStats& stats, Args& args, int threads, int arity, int maxLeaves, int features) {
+    PlanEstimate e;
+    e.threads = threads;
+    e.arity = arity;
+    e.maxLeaves = maxLeaves;
+    e.features = features;
+    e.processMem = static_cast<unsigned long long>(getResources().currentRealMem * 1024);
+
+    Args eArgs = args;
+    eArgs.threads = threads;
+
+    double rows = std::max<long long>(stats.rows, 1);
+    double featuresPerRow = stats.featuresCells / rows;
+    double labelsPerRow = stats.labelsCells / rows;
+    e.dataMem = stats.rows * (sizeof(IndexVector) + sizeof(SparseVector)) + stats.labelsCells * sizeof(int)
+                + stats.featuresCells * sizeof(IRVPair);
+    e.baseMem = BR::estimateBaseMem(features, eArgs);
+
+    if (args.modelType == br || args.modelType == ovr) {
+        unsigned long long tmpDataMem = BR::estimateTmpDataMem(stats.rows, stats.labels, stats.labelsCells, eArgs);
+        e.parts = BR::calculateNumberOfParts(e.dataMem, tmpDataMem, e.baseMem, stats.labels, eArgs);
+        e.tmpDataMem = tmpDataMem / e.parts;
+        for (auto& f : stats.labelsFrequencies) addBase(e, f * featuresPerRow, stats.featuresCells, args);
+        return e;
+    }
+
+    // Tree models, sizes of internal levels from the root
+    int leafGroup = (args.treeType == hierarchicalKmeans || args.treeType == balancedInOrder
+                     || args.treeType == balancedRandom) ? std::max(maxLeaves, 2) : arity;
+    std::vector<double> levels;
+    for (double n = std::ceil(static_cast<double>(stats.labels) / leafGroup); n > 1; n = std::ceil(n / arity))
+        levels.push_back(n);
+    levels.push_back(1);
+    std::reverse(levels.begin(), levels.end());
+
+    // Each data point updates its positive nodes and all their children
+    if (args.modelType == hsm) labelsPerRow = std::min(labelsPerRow, 1.0);
+    double updatesPerRow = 1;
+    for (int d = 0; d < levels.size(); ++d) {
+        double positive = std::min(labelsPerRow, levels[d]);
+        double next = d + 1 < levels.size() ? levels[d + 1] : stats.labels;
+        double children = next / levels[d];
+        updatesPerRow += positive * children;
+
+        // Internal nodes get the data points of the positive parents
+        double parentRows = d ? rows * std::min(labelsPerRow, levels[d - 1]) / levels[d - 1] : rows;
+        double positiveRows = rows * positive / levels[d];
+        for (int i = 0; i < levels[d]; ++i) addBase(e, positiveRows * featuresPerRow, parentRows * featuresPerRow, args);
+    }
+    double leafParentRows = rows * std::min(labelsPerRow, levels.back()) / levels.back();
+    for (auto& f : stats.labelsFrequencies) addBase(e, f * featuresPerRow, leafParentRows * featuresPerRow, args);
+
+    unsigned long long treeNodesMem = e.bases * (sizeof(TreeNode) + sizeof(TreeNode*));
+    for (auto& m : e.modelMem) m += treeNodesMem;
+
+    if (args.modelType == oplt) {
+        // Online model keeps all the base estimators in memory during training, with gradients for AdaGrad
+        e.tmpDataMem = e.modelMem[map] * (args.optimizerType == adagrad ? 2 : 1);
+        return e;
+    }
+
+    e.tmpDataMem = static_cast<unsigned long long>(rows * updatesPerRow * (sizeof(Real) + sizeof(Feature*)) + rows * sizeof(Real));
+    if (args.treeType == hierarchicalKmeans && args.treeStructure.empty()) {
+        // Labels features matrix
+        double cells = std::min(static_cast<double>(stats.labels) * features, stats.labelsCells * featuresPerRow);
+        e.treeMem = stats.labels * sizeof(SparseVector) + static_cast<unsigned long long>(cells * sizeof(IRVPair));
+    }
+
+    return e;
+}
+
+static unsigned long long predictMem(const PlanEstimate& e, RepresentationType loadAs, bool onTheTrot, Args& args) {
+    int models = (args.ensemble > 1 && !onTheTrot) ? args.ensemble : 1;
+    return e.processMem + e.dataMem + models * e.modelMem[loadAs];
+}
+
+static std::string representationName(RepresentationType type) {
+    if (type == dense) return "dense";
+    if (type == sparse) return "sparse";
+    return "map";
+}
+
+static void printEstimate(const PlanEstimate& e, Args& args) {
+    int ensemble = std::max(args.ensemble, 1);
+    Log(COUT) << "  Threads: " << e.threads;
+    if (args.modelType == plt || args.modelType == hsm || args.modelType == oplt)
+        Log(COUT) << ", arity: " << e.arity << ", max leaves: " << e.maxLeaves;
+    Log(COUT) << ", features: " << e.features - 2
+              << "\n    Base estimators: " << e.bases;
+    if (e.parts > 1) Log(COUT) << " in " << e.parts << " parts";
+    Log(COUT) << "\n    Data: " << formatMem(e.dataMem)
+              << "\n    Temporary data: " << formatMem(e.tmpDataMem);
+    if (e.treeMem) Log(COUT) << ", tree building: " << formatMem(e.treeMem);
+    Log(COUT) << "\n    Base estimators workspace: " << formatMem(e.baseMem)
+              << "\n    Peak training memory: " << formatMem(e.trainMem())
+              << "\n    Model file size: " << formatMem(ensemble * e.modelFileSize)
+              << "\n    Model memory: dense: " << formatMem(ensemble * e.modelMem[dense])
+              << ", map: " << formatMem(ensemble * e.modelMem[map])
+              << ", sparse: " << formatMem(ensemble * e.modelMem[sparse]) << "\n";
+}
+
+void planConfiguration(Args& args) {
+    DataStats stats = scanDataStats(args);
+    if (!stats.rows) throw std::invalid_argument("No data points in the input file: " + args.input);
+
+    Log(COUT) << "Data statistics" << (stats.sampled ? " (extrapolated from the first rows)" : "") << ":"
+              << "\n  Data points: " << stats.rows
+              << "\n  Features: " << stats.features - 2
+              << "\n  Labels: " << stats.labels
+              << "\n  Labels / data point: " << static_cast<double>(stats.labelsCells) / stats.rows
+              << "\n  Features / data point: " << static_cast<double>(stats.featuresCells) / stats.rows << "\n";
+
+    if (args.modelType != br && args.modelType != ovr && args.modelType != plt && args.modelType != hsm && args.modelType != oplt)
+        throw std::invalid_argument("Planning is not supported for this model type");
+
+    Log(COUT) << "Estimates for the given configuration (memory limit: " << formatMem(args.memLimit) << "):\n";
+    PlanEstimate current = estimate(stats, args, args.threads, args.arity, args.maxLeaves, stats.features);
+    printEstimate(current, args);
+
+    // Search for the configuration that fits in the memory limit, changes of the model are the last resort,
+    // so try fewer threads first, then smaller tree nodes, then hashing of the features
+    bool tree = args.modelType == plt || args.modelType == hsm || args.modelType == oplt;
+    std::vector<std::pair<int, int>> treeConfigs;
+    if (tree) {
+        for (int ml = args.maxLeaves; ml >= 2; ml /= 2) treeConfigs.emplace_back(args.arity, ml);
+        for (int a = args.arity / 2; a >= 2; a /= 2) treeConfigs.emplace_back(a, std::min(args.maxLeaves, 2 * a));
+    } else treeConfigs.emplace_back(args.arity, args.maxLeaves);
+
+    std::vector<int> featuresConfigs = {stats.features};
+    for (int f = 1 << 30; f >= 1 << 10; f /= 2)
+        if (f + 2 < stats.features) featuresConfigs.push_back(f + 2);
+
+    // Training and prediction with the smallest representation have to fit
+    auto fitsLimit = [&](const PlanEstimate& e) {
+        return e.trainMem() <= args.memLimit && predictMem(e, sparse, args.ensemble > 1, args) <= args.memLimit;
+    };
+    PlanEstimate plan = current;
+    bool fits = fitsLimit(current);
+    for (int fc = 0; fc < featuresConfigs.size() && !fits; ++fc)
+        for (int tc = 0; tc < treeConfigs.size() && !fits; ++tc)
+            for (int t = args.threads; t >= 1 && !fits; t /= 2) {
+                plan = estimate(stats, args, t, treeConfigs[tc].first, treeConfigs[tc].second, featuresConfigs[fc]);
+                fits = fitsLimit(plan);
+            }
+
+    if (!fits) {
+        Log(COUT) << "No configuration fits in the memory limit, the smallest found:\n";
+        printEstimate(plan, args);
+        Log(COUT) << "Prediction memory for the input data: " << formatMem(predictMem(plan, sparse, args.ensemble > 1, args)) << "\n";
+        return;
+    }
+
+    // The fastest representation that fits, dense only if it is not much bigger than the map
+    RepresentationType loadAs = sparse;
+    bool onTheTrot = args.ensOnTheTrot;
+    for (bool trot : {false, true}) {
+        if (trot && args.ensemble <= 1) break;
+        for (auto type : {dense, map, sparse}) {
+            if (type == dense && plan.modelMem[dense] > 2 * plan.modelMem[map]) continue;
+            if (predictMem(plan, type, trot, args) <= args.memLimit) {
+                loadAs = type;
+                onTheTrot = trot;
+                break;
+            }
+        }
+        if (predictMem(plan, loadAs, onTheTrot, args) <= args.memLimit) break;
+    }
+
+    if (plan.threads != current.threads || plan.arity != current.arity || plan.maxLeaves != current.maxLeaves
+        || plan.features != current.features) {
+        Log(COUT) << "Estimates for the recommended configuration:\n";
+        printEstimate(plan, args);
+    }
+
+    Log(COUT) << "Prediction memory for the input data: " << formatMem(predictMem(plan, loadAs, onTheTrot, args)) << "\n";
+
+    std::ostringstream recommended;
+    recommended << "--threads " << plan.threads;
+    if (tree && plan.arity != args.arity) recommended << " --arity " << plan.arity;
+    if (tree && plan.maxLeaves != args.maxLeaves) recommended << " --maxLeaves " << plan.maxLeaves;
+    if (plan.features != stats.features) recommended << " --hash " << plan.features - 2;
+    recommended << " --loadAs " << representationName(loadAs);
+    if (args.ensemble > 1) recommended << " --ensOnTheTrot " << onTheTrot;
+    Log(COUT) << "Recommended configuration:\n  " << recommended.str() << "\n";
+}
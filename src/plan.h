@@ -0,0 +1,46 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "args.h"
+
+// Statistics of the data required to estimate the memory, collected without loading the data
+struct DataStats {
+    long long rows = 0;
+    int features = 0; // Number of features columns, including the shift and bias (like features.cols())
+    int labels = 0;
+    long long labelsCells = 0;
+    long long featuresCells = 0;
+    std::vector<long long> labelsFrequencies;
+    bool sampled = false; // Stats extrapolated from the first rows
+};
+
+// Reads the statistics from the binary data header or from a quick scan of the input,
+// scans only the first args.scanRows rows if set and extrapolates them to the size of the file
+DataStats scanDataStats(Args& args);
+
+// Estimates peak training memory, temporary data size, model size for each representation
+// and prediction memory for the args, then recommends a configuration that fits in args.memLimit
+void planConfiguration(Args& args);
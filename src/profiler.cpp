@@ -0,0 +1,166 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+#include "profiler.h"
+#include "resources.h"
+
+// Number of the slowest base estimators saved in the timeline
+static const int slowestBases = 20;
+static const std::chrono::milliseconds sampleInterval(100);
+
+struct ProfilerPhaseRecord {
+    std::string name;
+    int depth;
+    double start, end; // Wall time from the start of the profiler (s)
+    double startCpu, endCpu; // CPU time of the process (s)
+    double startMem, endMem, peakMem; // Real memory (MB)
+};
+
+struct ProfilerBaseRecord {
+    int index;
+    int rows;
+    double time;
+    std::string optimizer;
+};
+
+static std::mutex profilerMutex;
+static std::chrono::steady_clock::time_point profilerStart;
+static std::vector<ProfilerPhaseRecord> phases;
+static std::vector<int> openPhases;
+static std::vector<std::pair<double, double>> memSamples;
+static std::vector<ProfilerBaseRecord> bases;
+
+static std::thread sampler;
+static std::condition_variable samplerCondition;
+static bool samplerStop = false;
+
+static double elapsed() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - profilerStart).count();
+}
+
+static double currentMem() {
+    return getResources().currentRealMem / 1024;
+}
+
+// Must be called with the lock
+static void sampleMem() {
+    double mem = currentMem();
+    memSamples.emplace_back(elapsed(), mem);
+    for (auto i : openPhases) phases[i].peakMem = std::max(phases[i].peakMem, mem);
+}
+
+// Record hook of the metrics, base estimators are numbered in the order their training finishes
+static void recordBase(MetricTimer timer, double seconds, const MetricRecordInfo& info) {
+    if (timer != baseTrainTime) return;
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    bases.push_back({static_cast<int>(bases.size()), info.rows, seconds, info.detail});
+}
+
+void Profiler::start() {
+    if (!enabled.load(std::memory_order_relaxed) || sampler.joinable()) return;
+
+    profilerStart = std::chrono::steady_clock::now();
+    Metrics::recordHook = recordBase;
+    samplerStop = false;
+    sampler = std::thread([]() {
+        std::unique_lock<std::mutex> lock(profilerMutex);
+        while (!samplerCondition.wait_for(lock, sampleInterval, [] { return samplerStop; })) sampleMem();
+    });
+}
+
+int Profiler::beginPhase(const std::string& name) {
+    auto res = getResources();
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    double mem = res.currentRealMem / 1024;
+    phases.push_back({name, static_cast<int>(openPhases.size()), elapsed(), 0, res.cpuTime, 0, mem, 0, mem});
+    openPhases.push_back(phases.size() - 1);
+    return phases.size() - 1;
+}
+
+void Profiler::endPhase(int index) {
+    auto res = getResources();
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    auto& p = phases[index];
+    p.end = elapsed();
+    p.endCpu = res.cpuTime;
+    p.endMem = res.currentRealMem / 1024;
+    p.peakMem = std::max(p.peakMem, p.endMem);
+    openPhases.erase(std::remove(openPhases.begin(), openPhases.end(), index), openPhases.end());
+}
+
+void Profiler::save(const std::string& outfile) {
+    if (!enabled.load(std::memory_order_relaxed)) return;
+
+    Metrics::recordHook = nullptr;
+    if (sampler.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(profilerMutex);
+            samplerStop = true;
+        }
+        samplerCondition.notify_all();
+        sampler.join();
+    }
+
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    sampleMem();
+
+    std::ofstream out(outfile);
+    if (!out.good()) throw std::invalid_argument("Cannot write profile to " + outfile);
+    out << std::setprecision(6) << "{\n  \"phases\": [";
+    for (int i = 0; i < phases.size(); ++i) {
+        auto& p = phases[i];
+        out << (i ? "," : "") << "\n    {\"name\": \"" << p.name << "\", \"depth\": " << p.depth << ", \"start\": " << p.start
+            << ", \"wall_time\": " << p.end - p.start << ", \"cpu_time\": " << p.endCpu - p.startCpu
+            << ", \"start_mem_mb\": " << p.startMem << ", \"end_mem_mb\": " << p.endMem << ", \"peak_mem_mb\": " << p.peakMem << "}";
+    }
+    // Time of the operations interleaved with the phases
+    out << "\n  ],\n  \"accumulated\": {\"save bases\": " << Metrics::sum(baseSaveTime);
+
+    // Distribution of base estimators training times
+    std::vector<ProfilerBaseRecord> sorted(bases);
+    std::sort(sorted.begin(), sorted.end(), [](const ProfilerBaseRecord& a, const ProfilerBaseRecord& b) { return a.time > b.time; });
+    double total = 0;
+    for (auto& b : sorted) total += b.time;
+    auto percentile = [&](double q) { return sorted.empty() ? 0 : sorted[std::min<size_t>(sorted.size() - 1, (1 - q) * sorted.size())].time; };
+    out << "},\n  \"bases\": {\"count\": " << sorted.size() << ", \"total_time\": " << total
+        << ", \"mean_time\": " << (sorted.empty() ? 0 : total / sorted.size()) << ", \"p50_time\": " << percentile(0.5)
+        << ", \"p90_time\": " << percentile(0.9) << ", \"p99_time\": " << percentile(0.99)
+        << ", \"max_time\": " << (sorted.empty() ? 0 : sorted.front().time) << ",\n    \"slowest\": [";
+    for (int i = 0; i < std::min<int>(slowestBases, sorted.size()); ++i)
+        out << (i ? "," : "") << "\n      {\"index\": " << sorted[i].index << ", \"rows\": " << sorted[i].rows
+            << ", \"time\": " << sorted[i].time << ", \"optimizer\": \"" << sorted[i].optimizer << "\"}";
+    out << "\n    ]\n  },\n  \"memory_mb\": [";
+    for (int i = 0; i < memSamples.size(); ++i)
+        out << (i ? ", " : "") << "[" << memSamples[i].first << ", " << memSamples[i].second << "]";
+    out << "]\n}\n";
+}
@@ -0,0 +1,56 @@
+/*
+ Copyright (c) 2019-2022 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+
+// Profiler of the training phases: wall and CPU time, memory at the start and the end of a phase and its peak,
+// sampled in the background. Training and saving times of base estimators come from the metrics,
+// which are collected while profiling.
+// Results are saved as JSON timeline, the profiler is enabled by --profile.
+
+class Profiler {
+public:
+    static inline std::atomic<bool> enabled{false};
+
+    // Starts the memory sampling
+    static void start();
+    // Stops the memory sampling and saves the timeline
+    static void save(const std::string& outfile);
+
+private:
+    friend class ProfilerPhase;
+    static int beginPhase(const std::string& name);
+    static void endPhase(int index);
+};
+
+// Records the scope as a phase
+class ProfilerPhase {
+public:
+    explicit ProfilerPhase(const std::string& name): index(Profiler::enabled.load(std::memory_order_relaxed) ? Profiler::beginPhase(name) : -1) { }
+    ~ProfilerPhase() { if (index >= 0) Profiler::endPhase(index); }
+
+private:
+    int index;
+};
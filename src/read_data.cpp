@@ -25,22 +25,102 @@
 #include "read_data.h"
 #include "log.h"
 #include "misc.h"
+#include "save_load.h"
+
+static const char binaryDataMagic[8] = {'N', 'X', 'C', 'D', 'A', 'T', 'A', '1'};
+
+void writeBinaryDataHeader(std::ostream& out, int rows, int features, int labels) {
+    out.write(binaryDataMagic, sizeof(binaryDataMagic));
+    saveVar(out, rows);
+    saveVar(out, features);
+    saveVar(out, labels);
+}
+
+static void writeBinaryVector(std::ostream& out, const std::vector<IRVPair>& vec) {
+    int n0 = vec.size();
+    saveVar(out, n0);
+    out.write((char*)vec.data(), n0 * sizeof(IRVPair));
+}
+
+// Appends the pairs to the vector, there can't be more of them than the indices declared in the header
+static void readBinaryVector(std::istream& in, std::vector<IRVPair>& vec, int maxSize) {
+    int n0;
+    loadVar(in, n0);
+    if (!in.good()) return; // Reported by the caller
+    if (n0 < 0 || n0 > maxSize)
+        throw std::runtime_error("Invalid size of the binary data row: " + std::to_string(n0) + ", expected at most " + std::to_string(maxSize));
+    size_t offset = vec.size();
+    vec.resize(offset + n0);
+    in.read((char*)(vec.data() + offset), n0 * sizeof(IRVPair));
+}
+
+void writeBinaryDataRow(std::ostream& out, const std::vector<IRVPair>& lLabels, const std::vector<IRVPair>& lFeatures) {
+    writeBinaryVector(out, lLabels);
+    writeBinaryVector(out, lFeatures);
+}
+
+bool readBinaryDataHeader(std::istream& in, int& rows, int& features, int& labels) {
+    char magic[sizeof(binaryDataMagic)] = {0};
+    in.read(magic, sizeof(magic));
+    bool binary = in.gcount() == sizeof(magic) && std::equal(magic, magic + sizeof(magic), binaryDataMagic);
+    if (!binary) {
+        in.clear();
+        in.seekg(0);
+        return false;
+    }
+    loadVar(in, rows);
+    loadVar(in, features);
+    loadVar(in, labels);
+    return true;
+}
+
+void readBinaryDataRow(std::istream& in, std::vector<IRVPair>& lLabels, std::vector<IRVPair>& lFeatures, int labels, int features) {
+    readBinaryVector(in, lLabels, labels);
+    readBinaryVector(in, lFeatures, features);
+}
 
 
 // Reads train/test data to sparse matrix
-void readData(SRMatrix& labels, SRMatrix& features, Args& args) {
+void readData(IRMatrix& labels, SRMatrix& features, Args& args) {
     if (args.input.empty())
         throw std::invalid_argument("Empty input path");
 
     Log(CERR) << "Loading data from: " << args.input << "\n";
 
     std::ifstream in;
-    in.open(args.input);
+    in.open(args.input, std::ios::in | std::ios::binary);
+    if (!in.good()) throw std::invalid_argument("Cannot open input file: " + args.input);
     std::string line;
 
-    // Check header
     int i = 1; // Line counter
     int hLabels = 0, hFeatures = 0, hRows = 0;
+    std::vector<IRVPair> lLabels;
+    std::vector<IRVPair> lFeatures;
+
+    if (readBinaryDataHeader(in, hRows, hFeatures, hLabels)) {
+        Log(CERR) << "  Binary data, header: rows: " << hRows << ", features: " << hFeatures << ", labels: " << hLabels << "\n";
+
+        for (int r = 0; r < hRows; ++r) {
+            printProgress(r, hRows);
+            lLabels.clear();
+            lFeatures.clear();
+
+            if (args.processData) prepareFeaturesVector(lFeatures, args.bias);
+            readBinaryDataRow(in, lLabels, lFeatures, hLabels, hFeatures);
+            if (!in.good()) throw std::runtime_error("Unexpected end of binary data file: " + args.input);
+            if (args.processData) processFeaturesVector(lFeatures, args.norm, args.hash, args.featuresThreshold, args.featuresMap.get());
+
+            labels.appendRow(lLabels);
+            features.appendRow(lFeatures);
+        }
+
+        in.close();
+        Log(CERR) << "  Loaded: rows: " << labels.rows() << ", features: " << features.cols() - 2
+                  << ", labels: " << labels.cols() << "\n  Data size: " << formatMem(labels.mem() + features.mem()) << "\n";
+        return;
+    }
+
+    // Check header
     getline(in, line);
 
     auto hTokens = split(line, ' ');
@@ -57,8 +137,6 @@ void readData(SRMatrix& labels, SRMatrix& features, Args& args) {
     if (args.hash) hFeatures = args.hash;
 
     // Read data points
-    std::vector<IRVPair> lLabels;
-    std::vector<IRVPair> lFeatures;
     if (!hRows) Log(CERR) << "  ?%\r";
     do {
         if (hRows) printProgress(i, hRows); // If the number of rows is know, print progress
@@ -74,7 +152,7 @@ void readData(SRMatrix& labels, SRMatrix& features, Args& args) {
             continue;
         }
 
-        if(args.processData) processFeaturesVector(lFeatures, args.norm, args.hash, args.featuresThreshold);
+        if(args.processData) processFeaturesVector(lFeatures, args.norm, args.hash, args.featuresThreshold, args.featuresMap.get());
 
         labels.appendRow(lLabels);
         features.appendRow(lFeatures);
@@ -135,14 +213,17 @@ void prepareFeaturesVector(std::vector<IRVPair> &lFeatures, Real bias) {
     lFeatures.emplace_back(1, bias);
 }
 
-void processFeaturesVector(std::vector<IRVPair> &lFeatures, bool norm, size_t hashSize, Real featuresThreshold) {
+void processFeaturesVector(std::vector<IRVPair> &lFeatures, bool norm, size_t hashSize, Real featuresThreshold,
+                           const std::vector<int>* featuresMap) {
     //Shift index by 2 because LibLinear ignore feature 0 and feature 1 is reserved for bias
     //assert(!lFeatures.empty());
     shift(lFeatures.begin() + 1, lFeatures.end(), 2);
 
     // Hash features
     if (hashSize) {
-        UnorderedMap<int, double> lHashed;
+        // Reused between rows read by the same thread
+        static thread_local UnorderedMap<int, double> lHashed;
+        lHashed.clear();
         for (int j = 1; j < lFeatures.size(); ++j)
             lHashed[hash(lFeatures[j].index) % hashSize] += lFeatures[j].value;
 
@@ -156,8 +237,47 @@ void processFeaturesVector(std::vector<IRVPair> &lFeatures, bool norm, size_t ha
     // Apply features threshold
     if (featuresThreshold > 0) thresholdAbs(lFeatures.begin() + 1, lFeatures.end(), featuresThreshold);
 
+    // Renumber features, it is done after the norm, so the values are the same as without reindexing
+    if (featuresMap) {
+        int j = 1;
+        for (int i = 1; i < lFeatures.size(); ++i) {
+            int index = lFeatures[i].index;
+            if (index < static_cast<int>(featuresMap->size()) && (*featuresMap)[index] > 0)
+                lFeatures[j++] = {(*featuresMap)[index], lFeatures[i].value};
+        }
+        lFeatures.resize(j);
+    }
+
     // Check if it requires sorting
     if (!std::is_sorted(lFeatures.begin(), lFeatures.end(), IRVPairIndexComp())) sort(lFeatures.begin(), lFeatures.end(), IRVPairIndexComp());
 }
 
+void reindexFeatures(SRMatrix& features, Args& args) {
+    Log(CERR) << "Reindexing features by frequency ...\n";
+
+    // Count examples with each feature, bias feature keeps its index
+    std::vector<std::pair<int, int>> counts(features.cols());
+    for (int i = 0; i < counts.size(); ++i) counts[i] = {0, i};
+    for (auto& row : features)
+        for (auto& f : row) ++counts[f.index].first;
+
+    std::stable_sort(counts.begin() + 2, counts.end(), [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+        return a.first > b.first;
+    });
+
+    auto featuresMap = std::make_shared<std::vector<int>>(counts.size(), -1);
+    (*featuresMap)[1] = 1;
+    int newIndex = 2;
+    for (int i = 2; i < counts.size() && counts[i].first > 0; ++i) (*featuresMap)[counts[i].second] = newIndex++;
+
+    // Renumber the rows in place
+    for (auto& row : features) {
+        for (auto& f : row) f.index = (*featuresMap)[f.index];
+        std::sort(row.begin(), row.end(), IRVPairIndexComp());
+        row.resize(row.nonZero() ? row.end()[-1].index + 1 : 0);
+    }
+    features.updateCols();
 
+    args.featuresMap = featuresMap;
+    Log(CERR) << "  Features: " << newIndex - 2 << "\n";
+}
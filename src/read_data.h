@@ -30,9 +30,22 @@
 #include "matrix.h"
 
 
-// Libsvm, XMLCRepo and numeric VW file reader
-void readData(SRMatrix& labels, SRMatrix& features, Args& args);
+// Libsvm, XMLCRepo, numeric VW and binary file reader
+void readData(IRMatrix& labels, SRMatrix& features, Args& args);
 void readLine(std::string& line, std::vector<IRVPair>& lLabels, std::vector<IRVPair>& lFeatures);
 
+// Binary data file starts with a header followed by the rows with the same content as the lines of a libsvm file,
+// each row is stored as its labels and features, both as number of pairs followed by raw index-value pairs
+void writeBinaryDataHeader(std::ostream& out, int rows, int features, int labels);
+void writeBinaryDataRow(std::ostream& out, const std::vector<IRVPair>& lLabels, const std::vector<IRVPair>& lFeatures);
+// Returns false and rewinds the stream if it does not start with the binary data header, rows are appended to the vectors
+bool readBinaryDataHeader(std::istream& in, int& rows, int& features, int& labels);
+// Throws if the row has more labels or features than declared in the header
+void readBinaryDataRow(std::istream& in, std::vector<IRVPair>& lLabels, std::vector<IRVPair>& lFeatures, int labels, int features);
+
 void prepareFeaturesVector(std::vector<IRVPair> &lFeatures, Real bias = 1.0);
-void processFeaturesVector(std::vector<IRVPair> &lFeatures, bool norm = true, size_t hashSize = 0, Real featuresThreshold = 0);
+void processFeaturesVector(std::vector<IRVPair> &lFeatures, bool norm = true, size_t hashSize = 0, Real featuresThreshold = 0,
+                           const std::vector<int>* featuresMap = nullptr);
+
+// Renumbers features by descending frequency, the mapping is kept in args
+void reindexFeatures(SRMatrix& features, Args& args);
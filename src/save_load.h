@@ -27,22 +27,22 @@
 class FileHelper {
 public:
     void saveToFile(std::string outfile);
-    virtual void save(std::ofstream& out) = 0;
+    virtual void save(std::ostream& out) = 0;
     void loadFromFile(std::string infile);
-    virtual void load(std::ifstream& in) = 0;
+    virtual void load(std::istream& in) = 0;
 };
 
-template <typename T> inline void saveVar(std::ofstream& out, T& var) { out.write((char*)&var, sizeof(T)); }
+template <typename T> inline void saveVar(std::ostream& out, T& var) { out.write((char*)&var, sizeof(T)); }
 
-template <typename T> inline void loadVar(std::ifstream& in, T& var) { in.read((char*)&var, sizeof(T)); }
+template <typename T> inline void loadVar(std::istream& in, T& var) { in.read((char*)&var, sizeof(T)); }
 
-inline void saveVar(std::ofstream& out, std::string& var) {
+inline void saveVar(std::ostream& out, std::string& var) {
     size_t size = var.size();
     out.write((char*)&size, sizeof(size));
     out.write((char*)&var[0], size);
 }
 
-inline void loadVar(std::ifstream& in, std::string& var) {
+inline void loadVar(std::istream& in, std::string& var) {
     size_t size;
     in.read((char*)&size, sizeof(size));
     var.resize(size);
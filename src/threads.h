@@ -11,8 +11,12 @@
 
 #pragma once
 
+#include <array>
 #include <vector>
 #include <queue>
+#include <deque>
+#include <atomic>
+#include <algorithm>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -102,7 +106,139 @@ inline void ThreadPool::stopAll(){
 }
 
 
-//Simple set of threads
+// Task that is run only once, by one of the workers or by the thread that waits for it
+class PoolTask {
+public:
+    explicit PoolTask(std::function<void()> func): func(std::move(func)), taken(false) {}
+
+    inline bool tryRun(){
+        if(taken.exchange(true)) return false;
+        func();
+        return true;
+    }
+
+private:
+    std::function<void()> func;
+    std::atomic<bool> taken;
+};
+
+
+// Process-wide work-stealing pool of workers shared by all the parallel parts of the library,
+// it's created on the first use and grows to the largest number of concurrent tasks requested by a single call,
+// up to the max size if it's set
+class WorkerPool {
+public:
+    static WorkerPool& getInstance();
+
+    void ensureWorkers(size_t count);
+    void submit(std::shared_ptr<PoolTask> task);
+    inline size_t size() const { return workersCount; }
+
+    // Limits the number of workers, 0 for no limit, the already started workers are kept.
+    // Tasks above the limit are run one after another, by the workers or by the thread waiting for them.
+    inline void setMaxSize(size_t size){ maxSize = size; }
+    inline size_t getMaxSize() const { return maxSize; }
+
+private:
+    WorkerPool(): workersCount(0), maxSize(0), nextQueue(0), pending(0) {}
+
+    static constexpr size_t maxWorkers = 1024;
+
+    struct WorkerQueue {
+        std::mutex mtx;
+        std::deque<std::shared_ptr<PoolTask>> tasks;
+    };
+
+    // Queues are never removed, so they can be accessed without locking the whole pool
+    std::unique_ptr<WorkerQueue> queues[maxWorkers];
+    std::atomic<size_t> workersCount;
+    std::atomic<size_t> maxSize;
+    std::atomic<size_t> nextQueue;
+    std::atomic<size_t> pending;
+
+    std::mutex growMtx;
+    std::mutex idleMtx;
+    std::condition_variable idleCondition;
+
+    static int& currentWorker();
+    bool popTask(size_t id, std::shared_ptr<PoolTask>& task);
+    void workerLoop(size_t id);
+};
+
+inline WorkerPool& WorkerPool::getInstance(){
+    // The pool is never destroyed, joining threads during the static destruction may hang (e.g. on DLL unload)
+    static WorkerPool* pool = new WorkerPool();
+    return *pool;
+}
+
+inline int& WorkerPool::currentWorker(){
+    thread_local int id = -1;
+    return id;
+}
+
+inline void WorkerPool::ensureWorkers(size_t count){
+    std::lock_guard<std::mutex> lock(growMtx);
+    count = std::min(count, maxSize ? std::min<size_t>(maxSize, maxWorkers) : maxWorkers);
+    for(size_t i = workersCount; i < count; ++i){
+        queues[i] = std::make_unique<WorkerQueue>();
+        ++workersCount; // Publish the queue before starting the worker
+        std::thread(&WorkerPool::workerLoop, this, i).detach();
+    }
+}
+
+inline void WorkerPool::submit(std::shared_ptr<PoolTask> task){
+    if(workersCount == 0) ensureWorkers(1);
+
+    // Tasks created by a worker go to its own queue, others are distributed over all the queues
+    int id = currentWorker();
+    size_t q = (id >= 0) ? id : nextQueue++ % workersCount;
+    {
+        std::lock_guard<std::mutex> lock(idleMtx);
+        ++pending;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[q]->mtx);
+        queues[q]->tasks.push_back(std::move(task));
+    }
+    idleCondition.notify_one();
+}
+
+inline bool WorkerPool::popTask(size_t id, std::shared_ptr<PoolTask>& task){
+    // Take the newest task from own queue first, then steal the oldest one from the others
+    size_t count = workersCount;
+    for(size_t i = 0; i < count; ++i){
+        auto& queue = *queues[(id + i) % count];
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        if(queue.tasks.empty()) continue;
+        if(i == 0){
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        --pending;
+        return true;
+    }
+    return false;
+}
+
+inline void WorkerPool::workerLoop(size_t id){
+    currentWorker() = id;
+    for(;;){
+        std::shared_ptr<PoolTask> task;
+        if(popTask(id, task)){
+            task->tryRun();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idleMtx);
+        idleCondition.wait(lock, [this]{ return pending > 0; });
+    }
+}
+
+
+// Set of tasks run in the shared worker pool, the number of added tasks is the parallelism of the call.
+// The thread waiting for the set also runs its tasks that were not started yet.
 class ThreadSet {
 public:
     ThreadSet();
@@ -113,16 +249,23 @@ public:
     void joinAll();
 
 private:
-    std::vector<std::thread> workers;
+    struct State {
+        std::mutex mtx;
+        std::condition_variable condition;
+        size_t remaining = 0;
+    };
+
+    std::vector<std::shared_ptr<PoolTask>> tasks;
+    std::shared_ptr<State> state;
 };
 
-inline ThreadSet::ThreadSet(){ }
+inline ThreadSet::ThreadSet(): state(std::make_shared<State>()) { }
 
 inline ThreadSet::~ThreadSet(){
     joinAll();
 }
 
-// Add new thread to set
+// Add new task to set
 template<class F, class... Args>
 auto ThreadSet::add(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type>{
     using return_type = typename std::result_of<F(Args...)>::type;
@@ -132,12 +275,71 @@ auto ThreadSet::add(F&& f, Args&&... args) -> std::future<typename std::result_o
         );
 
     std::future<return_type> res = task->get_future();
-    workers.push_back(std::thread([task](){ (*task)(); }));
+    {
+        std::lock_guard<std::mutex> lock(state->mtx);
+        ++state->remaining;
+    }
+    auto setState = state;
+    tasks.push_back(std::make_shared<PoolTask>([task, setState](){
+        (*task)();
+        std::lock_guard<std::mutex> lock(setState->mtx);
+        --setState->remaining;
+        setState->condition.notify_all();
+    }));
+
+    // Make sure that all the tasks of the set can run concurrently
+    auto& pool = WorkerPool::getInstance();
+    pool.ensureWorkers(tasks.size());
+    pool.submit(tasks.back());
     return res;
 }
 
 inline void ThreadSet::joinAll(){
-    for(auto &worker: workers)
-        worker.join();
-    workers.clear();
+    for(auto &task: tasks) task->tryRun();
+
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->condition.wait(lock, [this]{ return state->remaining == 0; });
+    tasks.clear();
 }
+
+
+// Counter incremented from many threads, every thread adds to its own cache line
+// and the shards are summed only when the counter is read
+class ShardedCounter {
+public:
+    ShardedCounter() { reset(); }
+
+    inline ShardedCounter& operator+=(long long value){
+        shards[shardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+        return *this;
+    }
+    inline ShardedCounter& operator++(){ return *this += 1; }
+    inline ShardedCounter& operator=(long long value){
+        reset();
+        shards[0].value.store(value, std::memory_order_relaxed);
+        return *this;
+    }
+
+    inline operator long long() const {
+        long long sum = 0;
+        for(auto& s : shards) sum += s.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    inline void reset(){
+        for(auto& s : shards) s.value.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int shardsCount = 32;
+    struct alignas(64) Shard {
+        std::atomic<long long> value;
+    };
+    std::array<Shard, shardsCount> shards;
+
+    static inline int shardIndex(){
+        static std::atomic<int> nextIndex(0);
+        thread_local int index = nextIndex++ % shardsCount;
+        return index;
+    }
+};
@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
 #include "vector.h"
 
 Real AbstractVector::dot(AbstractVector& vec) const {
@@ -69,34 +75,137 @@ void AbstractVector::unitNorm(){
     div(norm);
 }
 
-void AbstractVector::save(std::ofstream& out) {
+// Format byte of saved vector, 0 and 1 are the plain dense and sparse codings
+// Other codings are preceded by the size of their payload, so they can be skipped without decoding
+const uint8_t sparseFormat = 1;
+const uint8_t quantize8Format = 2;
+const uint8_t quantize16Format = 4;
+const uint8_t compressedIndicesFormat = 8;
+
+inline void saveVarint(std::ostream& out, unsigned int v) {
+    while (v >= 0x80) {
+        out.put(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.put(static_cast<char>(v));
+}
+
+inline unsigned int loadVarint(std::istream& in) {
+    unsigned int v = 0;
+    for (int shift = 0;; shift += 7) {
+        int c = in.get();
+        if (c == EOF) throw std::runtime_error("Unexpected end of vector data");
+        v |= static_cast<unsigned int>(c & 0x7f) << shift;
+        if (!(c & 0x80)) break;
+    }
+    return v;
+}
+
+template <typename T> inline void saveQuantized(std::ostream& out, int q) {
+    T v = static_cast<T>(q);
+    saveVar(out, v);
+}
+
+template <typename T> inline Real loadQuantized(std::istream& in, Real scale) {
+    T v;
+    loadVar(in, v);
+    return static_cast<Real>(v) * scale;
+}
+
+void AbstractVector::save(std::ostream& out, const VectorCoding& coding) {
     checkD();
     saveVar(out, s);
-    saveVar(out, n0);
-    bool sparse = sparseMem() < denseMem() || s == 0; // Select more optimal coding
-    saveVar(out, sparse);
-
-    if(sparse) forEachIV([&](const int& i, Real& v) {
-        if(v != 0) {
-            saveVar(out, i);
-            saveVar(out, v);
+    bool sparse = coding.sparse < 0 ? sparseMem() < denseMem() || s == 0 : coding.sparse > 0;
+
+    if (coding.quantizeBits == 0 && !(sparse && coding.compressIndices)) {
+        saveVar(out, n0);
+        uint8_t format = sparse ? sparseFormat : 0;
+        saveVar(out, format);
+
+        if (sparse) forEachIV([&](const int& i, Real& v) {
+            if (v != 0) {
+                saveVar(out, i);
+                saveVar(out, v);
+            }
+        });
+        else {
+            for (int i = 0; i < s; ++i) {
+                Real v = at(i);
+                saveVar(out, v);
+            }
         }
+        return;
+    }
+
+    if (coding.quantizeBits != 0 && coding.quantizeBits != 8 && coding.quantizeBits != 16)
+        throw std::invalid_argument("Unsupported number of quantization bits: " + std::to_string(coding.quantizeBits));
+
+    // Collect values in order of indices, values quantized to 0 are dropped
+    std::vector<IRVPair> values;
+    values.reserve(n0);
+    forEachIV([&](const int& i, Real& v) {
+        if (v != 0) values.push_back({i, v});
     });
-    else {
+    std::sort(values.begin(), values.end(), [](const IRVPair& a, const IRVPair& b) { return a.index < b.index; });
+
+    Real scale = 1;
+    if (coding.quantizeBits) {
+        int qMax = (1 << (coding.quantizeBits - 1)) - 1;
+        Real maxAbs = 0;
+        for (auto& e : values) maxAbs = std::max(maxAbs, std::fabs(e.value));
+        if (maxAbs > 0) scale = maxAbs / qMax;
+        for (auto& e : values) e.value = std::round(e.value / scale);
+        values.erase(std::remove_if(values.begin(), values.end(), [](const IRVPair& e) { return e.value == 0; }),
+                     values.end());
+    }
+    size_t n0ToSave = values.size();
+    saveVar(out, n0ToSave);
+
+    uint8_t format = 0;
+    if (sparse) format |= sparseFormat;
+    if (coding.quantizeBits == 8) format |= quantize8Format;
+    if (coding.quantizeBits == 16) format |= quantize16Format;
+    if (sparse && coding.compressIndices) format |= compressedIndicesFormat;
+    saveVar(out, format);
+
+    std::ostringstream payload;
+    auto saveValue = [&](Real v) {
+        if (coding.quantizeBits == 8) saveQuantized<int8_t>(payload, static_cast<int>(v));
+        else if (coding.quantizeBits == 16) saveQuantized<int16_t>(payload, static_cast<int>(v));
+        else saveVar(payload, v);
+    };
+
+    if (coding.quantizeBits) saveVar(payload, scale);
+    if (sparse) {
+        int prev = 0;
+        for (auto& e : values) {
+            if (coding.compressIndices) saveVarint(payload, static_cast<unsigned int>(e.index - prev));
+            else saveVar(payload, e.index);
+            prev = e.index;
+        }
+        for (auto& e : values) saveValue(e.value);
+    } else {
+        auto e = values.begin();
         for (int i = 0; i < s; ++i) {
-            Real v = at(i);
-            saveVar(out, v);
+            if (e != values.end() && e->index == i) saveValue((e++)->value);
+            else saveValue(0);
         }
     }
+
+    std::string payloadData = payload.str();
+    size_t payloadSize = payloadData.size();
+    saveVar(out, payloadSize);
+    out.write(payloadData.data(), payloadSize);
 }
 
-void AbstractVector::load(std::ifstream& in) {
+void AbstractVector::load(std::istream& in) {
     // Load header
     loadVar(in, s);
     size_t n0ToLoad;
     loadVar(in, n0ToLoad);
-    bool sparse;
-    loadVar(in, sparse);
+    uint8_t format;
+    loadVar(in, format);
+    bool sparse = format & sparseFormat;
 
     // Allocate new vec
     initD(); // Re-init data container
@@ -105,29 +214,65 @@ void AbstractVector::load(std::ifstream& in) {
     // Load and insert data
     int index;
     Real value;
-    if(sparse) {
-        for (int i = 0; i < n0ToLoad; ++i) {
-            loadVar(in, index);
-            loadVar(in, value);
-            insertD(index, value);
+    if (format <= sparseFormat) {
+        if (sparse) {
+            for (int i = 0; i < n0ToLoad; ++i) {
+                loadVar(in, index);
+                loadVar(in, value);
+                insertD(index, value);
+            }
+        } else {
+            for (int i = 0; i < s; ++i) {
+                loadVar(in, value);
+                if (value != 0) insertD(i, value);
+            }
         }
     } else {
-        for (int i = 0; i < s; ++i) {
-            loadVar(in, value);
-            if(value != 0) insertD(i, value);
+        size_t payloadSize;
+        loadVar(in, payloadSize);
+
+        Real scale = 1;
+        if (format & (quantize8Format | quantize16Format)) loadVar(in, scale);
+        auto loadValue = [&]() {
+            if (format & quantize8Format) return loadQuantized<int8_t>(in, scale);
+            if (format & quantize16Format) return loadQuantized<int16_t>(in, scale);
+            Real v;
+            loadVar(in, v);
+            return v;
+        };
+
+        if (sparse) {
+            std::vector<int> indices(n0ToLoad);
+            int prev = 0;
+            for (auto& i : indices) {
+                if (format & compressedIndicesFormat) i = prev + static_cast<int>(loadVarint(in));
+                else loadVar(in, i);
+                prev = i;
+            }
+            for (auto& i : indices) insertD(i, loadValue());
+        } else {
+            for (int i = 0; i < s; ++i) {
+                value = loadValue();
+                if (value != 0) insertD(i, value);
+            }
         }
     }
 
     assert(n0 == n0ToLoad);
 }
 
-void AbstractVector::skipLoad(std::ifstream& in){
+void AbstractVector::skipLoad(std::istream& in){
     size_t s, n0;
-    bool sparse;
+    uint8_t format;
     loadVar(in, s);
     loadVar(in, n0);
-    loadVar(in, sparse);
-    if(sparse) in.seekg(n0 * (sizeof(int) + sizeof(Real)), std::ios::cur);
+    loadVar(in, format);
+    if (format > sparseFormat) {
+        size_t payloadSize;
+        loadVar(in, payloadSize);
+        in.seekg(payloadSize, std::ios::cur);
+    }
+    else if (format == sparseFormat) in.seekg(n0 * (sizeof(int) + sizeof(Real)), std::ios::cur);
     else in.seekg(s * sizeof(Real), std::ios::cur);
 }
 
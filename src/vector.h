@@ -195,6 +195,14 @@ class MapVector;
 class Vector;
 
 
+// On-disk coding of vectors, default coding is readable by the older versions
+struct VectorCoding {
+    int sparse = -1; // -1 selects smaller coding, 0 forces dense, 1 forces sparse
+    int quantizeBits = 0; // 8 or 16 bits per value with one scale per vector, 0 stores full precision
+    bool compressIndices = false; // Delta and variable-length coding of sparse indices
+};
+
+
 // Abstract vector type
 class AbstractVector {
 public:
@@ -246,9 +254,9 @@ public:
     size_t sparseMem() const { return n0 * (sizeof(int) + sizeof(Real)); }
     size_t denseMem() const { return s * sizeof(Real); }
 
-    virtual void save(std::ofstream& out);
-    virtual void load(std::ifstream& in);
-    static void skipLoad(std::ifstream& in);
+    virtual void save(std::ostream& out, const VectorCoding& coding = VectorCoding());
+    virtual void load(std::istream& in);
+    static void skipLoad(std::istream& in);
 
     virtual RepresentationType type() const = 0;
 
@@ -281,6 +289,7 @@ public:
         sorted = true;
     }
     explicit SparseVector(const AbstractVector& vec) {
+        s = vec.size();
         maxN0 = vec.nonZero() + 1;
         d = new IRVPair[maxN0 + 1];
         n0 = 0;
@@ -305,16 +314,24 @@ public:
         n0 = vec.n0;
         maxN0 = vec.maxN0;
         sorted = vec.sorted;
+        owned = vec.owned;
         d = vec.d;
         vec.d = nullptr;
     }
 
-    explicit SparseVector(const std::vector<IRVPair>& vec, bool sorted = true) {
+    explicit SparseVector(const std::vector<IRVPair>& vec, bool sorted = true):
+        SparseVector(vec, sorted, new IRVPair[vec.size() + 1]) {
+        owned = true;
+    }
+
+    // Uses given storage of vec.size() + 1 elements, that is not released by the vector
+    SparseVector(const std::vector<IRVPair>& vec, bool sorted, IRVPair* storage) {
         s = 0;
         this->sorted = true;
+        owned = false;
         n0 = vec.size();
         maxN0 = n0;
-        d = new IRVPair[n0 + 1];
+        d = storage;
         d[n0].index = -1;
         if(n0) {
             std::copy(vec.begin(), vec.end(), d);
@@ -325,12 +342,13 @@ public:
     }
 
     ~SparseVector() override{
-        delete[] d;
+        if(owned) delete[] d;
     }
 
     void initD() override {
-        delete[] d;
+        if(owned) delete[] d;
         d = nullptr;
+        owned = true;
         maxN0 = 0;
         n0 = 0;
         sorted = true;
@@ -341,7 +359,7 @@ public:
         if(i >= s) s = i + 1;
         if(v != 0) {
             if(n0 >= maxN0) reserve(2 * maxN0);
-            if(v < d[n0].value) sorted = false;
+            if(n0 > 0 && i < d[n0 - 1].index) sorted = false;
             d[n0++] = {i, v};
             d[n0].index = -1;
         }
@@ -357,9 +375,10 @@ public:
         this->maxN0 = maxN0;
         if(d != nullptr){
             std::copy(d, d + std::min(this->n0, maxN0), newD);
-            delete[] d;
+            if(owned) delete[] d;
         }
         d = newD;
+        owned = true;
         n0 = std::min(this->n0, maxN0);
         d[n0].index = -1;
     }
@@ -452,7 +471,7 @@ public:
         return sizeof(SparseVector) + n0 * (sizeof(int) + sizeof(Real));
     }
 
-    void load(std::ifstream& in) override {
+    void load(std::istream& in) override {
         AbstractVector::load(in);
         sort();
     }
@@ -482,6 +501,7 @@ public:
 protected:
     size_t maxN0;
     size_t sorted{};
+    bool owned{true}; // false if data is kept in external storage, e.g. arena of a matrix
     IRVPair* d; // data
 };
 
@@ -602,11 +622,11 @@ public:
     explicit Vector(const AbstractVector& vec): AbstractVector(vec) {
         s = vec.size();
         n0 = 0;
-        d = new Real[vec.size()];
-        vec.forEachIV([&](const int& i, Real& v) { d[i] = v; });
+        d = new Real[vec.size()]();
+        vec.forEachIV([&](const int& i, Real& v) { insertD(i, v); });
     }
     ~Vector() override{
-        delete d;
+        delete[] d;
     }
 
     void initD() override {
@@ -695,3 +715,132 @@ public:
 protected:
     Real* d; // data
 };
+
+
+// Sparse binary vector that stores only indices of non-zero elements, used for labels,
+// takes half of the memory of SparseVector.
+// Features are kept as SparseVector even if binary: after normalization their values are the same constant
+// only without the bias, and a dot product of the indices without the multiply was measured 1.4-1.7x faster
+// only for weights that fit in the cache, but 10-25% slower for weights of 100K and more features
+class IndexVector {
+public:
+    IndexVector(): s(0), n0(0) {
+        d = new IndexEntry[1];
+        d[0].index = -1;
+    }
+
+    explicit IndexVector(const std::vector<IRVPair>& vec, bool sorted = true):
+        IndexVector(vec, sorted, new IndexEntry[vec.size() + 1]) {
+        owned = true;
+    }
+
+    // Uses given storage of vec.size() + 1 elements, that is not released by the vector
+    IndexVector(const std::vector<IRVPair>& vec, bool sorted, IndexEntry* storage) {
+        s = 0;
+        n0 = 0;
+        owned = false;
+        d = storage;
+        for (const auto& p : vec)
+            if (p.value != 0) d[n0++].index = p.index;
+        d[n0].index = -1;
+        if (!sorted) std::sort(d, d + n0);
+        if (n0) s = std::max_element(begin(), end())->index + 1;
+    }
+
+    IndexVector(const IndexVector& vec): s(vec.s), n0(vec.n0) {
+        d = new IndexEntry[n0 + 1];
+        std::copy(vec.d, vec.d + n0 + 1, d);
+    }
+
+    IndexVector(IndexVector&& vec) noexcept: s(vec.s), n0(vec.n0), owned(vec.owned), d(vec.d) {
+        vec.d = nullptr;
+        vec.n0 = 0;
+    }
+
+    ~IndexVector() {
+        if (owned) delete[] d;
+    }
+
+    void resize(size_t newS) {
+        s = newS;
+    }
+
+    // Returns index of i-th non-zero element, -1 for i equal to the number of non-zero elements
+    inline int operator[](int i) const { return d[i].index; }
+
+    inline bool contains(int index) const {
+        for (auto p = d; p->index != -1; ++p)
+            if (p->index == index) return true;
+        return false;
+    }
+
+    inline size_t size() const { return s; }
+    inline size_t nonZero() const { return n0; }
+
+    unsigned long long mem() const { return estimateMem(s, n0); }
+    static unsigned long long estimateMem(size_t s, size_t n0){
+        return sizeof(IndexVector) + n0 * sizeof(int);
+    }
+
+    // Uses the same format as AbstractVector::save, so it can be loaded as SparseVector
+    void save(std::ostream& out) {
+        saveVar(out, s);
+        saveVar(out, n0);
+        bool sparse = true;
+        saveVar(out, sparse);
+        Real value = 1;
+        for (auto& e : *this) {
+            saveVar(out, e.index);
+            saveVar(out, value);
+        }
+    }
+
+    void load(std::istream& in) {
+        size_t n0ToLoad;
+        bool sparse;
+        loadVar(in, s);
+        loadVar(in, n0ToLoad);
+        loadVar(in, sparse);
+
+        if (owned) delete[] d;
+        d = new IndexEntry[(sparse ? n0ToLoad : s) + 1];
+        owned = true;
+        n0 = 0;
+        int index;
+        Real value;
+        if (sparse) {
+            for (int i = 0; i < n0ToLoad; ++i) {
+                loadVar(in, index);
+                loadVar(in, value);
+                if (value != 0) d[n0++].index = index;
+            }
+            std::sort(d, d + n0);
+        } else {
+            for (int i = 0; i < s; ++i) {
+                loadVar(in, value);
+                if (value != 0) d[n0++].index = i;
+            }
+        }
+        d[n0].index = -1;
+    }
+
+    IndexEntry* data(){ return d; }
+    IndexEntry* begin(){ return d; }
+    IndexEntry* end(){ return d + n0; }
+
+    const IndexEntry* begin() const { return d; }
+    const IndexEntry* end() const { return d + n0; }
+
+    friend std::ostream& operator<<(std::ostream& os, const IndexVector& vec) {
+        os << "{ ";
+        for (auto& e : vec) os << e.index << " ";
+        os << "}";
+        return os;
+    }
+
+private:
+    size_t s;       // size
+    size_t n0;      // non-zero elements
+    bool owned{true}; // false if data is kept in external storage, e.g. arena of a matrix
+    IndexEntry* d;  // data, terminated by index -1
+};